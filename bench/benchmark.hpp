@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+struct Scenario final {
+    std::string_view        name;
+    std::function< void() > run;
+};
+
+using ScenariosVec = std::vector< Scenario >;
+using Metric       = std::pair< std::string_view, double >;
+using MetricsVec   = std::vector< Metric >;
+
+enum class ReportFormat {
+    // scenario key=value key=value ...
+    eText,
+    // One JSON object per line: {"scenario": ..., "metrics": {...}}.
+    eJsonLines
+};
+
+// Wall time of one call of function divided by count, in nanoseconds.
+template < class Function > double nsPer( std::size_t count, Function && function ) {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const std::chrono::duration< double, std::nano > elapsed =
+    std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast< double >( count );
+}
+
+// Prints one line per measurement in the report format. Every line ends with
+// peak_rss_kb, the peak resident memory of the process so far, so run one
+// scenario per process to attribute it.
+void report( std::string_view scenario, const MetricsVec & metrics );
+void setReportFormat( ReportFormat format );
+
+ScenariosVec renderLoopScenarios();
+ScenariosVec recordScenarios();
+ScenariosVec xcbQueryScenarios();
+ScenariosVec spatialIndexScenarios();
+ScenariosVec rectArrayScenarios();
+ScenariosVec suiteScenarios();
+
+}   // namespace bench
@@ -0,0 +1,140 @@
+#include "benchmark.hpp"
+#include "vulkanrender.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+#include <sys/resource.h>
+
+namespace bench {
+
+namespace {
+ReportFormat reportFormat = ReportFormat::eText;
+
+double peakRssKb() {
+    rusage usage {};
+    getrusage( RUSAGE_SELF, &usage );
+    // Kilobytes on Linux.
+    return static_cast< double >( usage.ru_maxrss );
+}
+
+// Scenario names and metric keys are plain ASCII without quotes.
+void reportJson( std::string_view scenario, const MetricsVec & metrics ) {
+    std::cout << "{\"scenario\":\"" << scenario << "\",\"metrics\":{";
+    for ( std::size_t i = 0; i < metrics.size(); ++i ) {
+        const auto & [ key, value ] = metrics[ i ];
+        std::cout << ( i ? "," : "" ) << '"' << key << "\":";
+        // JSON has no NaN or infinity.
+        if ( std::isfinite( value ) )
+            std::cout << value;
+        else
+            std::cout << "null";
+    }
+    std::cout << "}}" << std::endl;
+}
+}   // namespace
+
+void report( std::string_view scenario, const MetricsVec & metrics ) {
+    auto withMemory = metrics;
+    withMemory.emplace_back( "peak_rss_kb", peakRssKb() );
+
+    if ( reportFormat == ReportFormat::eJsonLines ) {
+        reportJson( scenario, withMemory );
+        return;
+    }
+
+    std::cout << scenario;
+    for ( auto && [ key, value ] : withMemory )
+        std::cout << ' ' << key << '=' << value;
+    std::cout << std::endl;
+}
+
+void setReportFormat( ReportFormat format ) { reportFormat = format; }
+
+namespace {
+// "WIDTHxHEIGHT", nothing when malformed.
+std::optional< vk::Extent2D > parseExtent( std::string_view text ) {
+    vk::Extent2D extent {};
+    const auto   separator = text.find( 'x' );
+    if ( separator == std::string_view::npos )
+        return std::nullopt;
+
+    const auto width  = text.substr( 0, separator );
+    const auto height = text.substr( separator + 1 );
+    if ( std::from_chars( width.data(), width.data() + width.size(), extent.width ).ec !=
+         std::errc {} ||
+         std::from_chars( height.data(), height.data() + height.size(), extent.height )
+         .ec != std::errc {} ||
+         extent.width == 0 || extent.height == 0 )
+        return std::nullopt;
+    return extent;
+}
+}   // namespace
+
+}   // namespace bench
+
+// Usage: vulkan_xcb_bench [--json] [--headless[=WIDTHxHEIGHT]] [scenario-prefix]
+// --json prints JSON lines instead of key=value text. Headless runs render
+// offscreen and need no X server, the scenarios querying X windows still do.
+int main( int argc, char ** argv ) {
+    constexpr std::string_view headlessFlag = "--headless";
+
+    std::string_view filter;
+    for ( int i = 1; i < argc; ++i ) {
+        const std::string_view arg = argv[ i ];
+        if ( arg == "--json" ) {
+            bench::setReportFormat( bench::ReportFormat::eJsonLines );
+            continue;
+        }
+        if ( !arg.starts_with( headlessFlag ) ) {
+            filter = arg;
+            continue;
+        }
+
+        std::optional< vk::Extent2D > extent = vk::Extent2D { .width  = 600,
+                                                              .height = 300 };
+        if ( arg.size() > headlessFlag.size() ) {
+            extent = arg[ headlessFlag.size() ] == '='
+                     ? bench::parseExtent( arg.substr( headlessFlag.size() + 1 ) )
+                     : std::nullopt;
+            if ( !extent ) {
+                std::cerr << "Malformed " << arg << ", expected --headless=WxH"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        core::renderer::VulkanRenderInstance::init()->setHeadless( extent );
+    }
+
+    bench::ScenariosVec scenarios;
+    for ( auto && scenarioSet :
+          { bench::renderLoopScenarios(),
+            bench::recordScenarios(),
+            bench::xcbQueryScenarios(),
+            bench::spatialIndexScenarios(),
+            bench::rectArrayScenarios(),
+            bench::suiteScenarios() } )
+        for ( auto && scenario : scenarioSet )
+            scenarios.push_back( scenario );
+
+    int status = EXIT_SUCCESS;
+    for ( auto && scenario : scenarios ) {
+        if ( !scenario.name.starts_with( filter ) )
+            continue;
+        try {
+            scenario.run();
+        } catch ( const std::exception & e ) {
+            std::cerr << scenario.name << " failed: " << e.what() << std::endl;
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "xcb_wraper/point.hpp"
+#include "xcb_wraper/windowgeometry.hpp"
+
+namespace bench {
+
+using GeometriesVec = std::vector< xcbwraper::WindowGeometry::Info >;
+
+// Windows scattered over a 4K screen, seeded so every run sees the same layout.
+inline GeometriesVec randomWindows( std::size_t count, std::uint32_t seed ) {
+    using xcbwraper::Point;
+    using xcbwraper::WindowGeometry;
+
+    std::mt19937                                   random( seed );
+    std::uniform_int_distribution< std::int16_t >  x( 0, 3840 - 1 ), y( 0, 2160 - 1 );
+    std::uniform_int_distribution< std::uint16_t > size( 32, 512 );
+
+    GeometriesVec windows;
+    windows.reserve( count );
+    for ( std::size_t i = 0; i < count; ++i )
+        windows.push_back(
+        WindowGeometry { WindowGeometry::CreateInfo {
+                         .leftTopPoint = Point { x( random ), y( random ) },
+                         .width        = size( random ),
+                         .height       = size( random ),
+                         .borderWidth  = 0 } }
+        .getInfo() );
+    return windows;
+}
+
+}   // namespace bench
@@ -0,0 +1,78 @@
+#include "benchmark.hpp"
+#include "renderloop.hpp"
+#include "renderrun.hpp"
+#include "vulkanrender.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+
+namespace bench {
+
+namespace {
+using core::renderer::RenderLoopConfig;
+using core::renderer::VulkanGraphicRender;
+
+constexpr std::chrono::seconds recordDuration { 5 };
+
+// threadsCount 0 records every layer inline from the frame recorder, otherwise
+// the layers go to secondary buffers recorded by that many threads.
+void runRecord( std::string_view name,
+                std::size_t      layersCount,
+                std::size_t      threadsCount ) {
+    const auto run = runRender(
+    { .mode = RenderLoopConfig::Mode::eContinuous, .duration = recordDuration },
+    [ layersCount, threadsCount ]( VulkanGraphicRender & renderer ) {
+        if ( threadsCount == 0 )
+            renderer.setFrameRecorder(
+            [ layersCount ]( const VulkanGraphicRender::FrameContext & frame ) {
+                for ( std::size_t layer = 0; layer < layersCount; ++layer )
+                    recordLayerClear( frame.commandBuffer, frame.extent, layer );
+            } );
+        else
+            renderer.setLayerRecorder(
+            layersCount,
+            []( const VulkanGraphicRender::FrameContext & frame, std::size_t layer ) {
+                recordLayerClear( frame.commandBuffer, frame.extent, layer );
+            },
+            threadsCount );
+    } );
+
+    using Us            = std::chrono::duration< double, std::micro >;
+    const auto frames   = static_cast< double >( run.record.frames );
+    const auto recordUs = Us( run.record.recordTime ).count();
+    const auto submitUs = Us( run.record.submitTime ).count();
+
+    auto metrics = renderMetrics( run );
+    metrics.insert( metrics.end(),
+                    { { "layers", static_cast< double >( layersCount ) },
+                      { "threads", static_cast< double >( threadsCount ) },
+                      { "record_us_per_frame", frames ? recordUs / frames : 0.0 },
+                      { "submit_us_per_frame", frames ? submitUs / frames : 0.0 } } );
+    report( name, metrics );
+}
+}   // namespace
+
+ScenariosVec recordScenarios() {
+    return {
+        { "record_submit/0", [] { runRecord( "record_submit/0", 0, 0 ); } },
+        { "record_submit/16", [] { runRecord( "record_submit/16", 16, 0 ); } },
+        { "record_submit/256", [] { runRecord( "record_submit/256", 256, 0 ); } },
+        { "record_submit/4096", [] { runRecord( "record_submit/4096", 4096, 0 ); } },
+        // Threads x layers.
+        { "record_threads/1x256", [] { runRecord( "record_threads/1x256", 256, 1 ); } },
+        { "record_threads/2x256", [] { runRecord( "record_threads/2x256", 256, 2 ); } },
+        { "record_threads/4x256", [] { runRecord( "record_threads/4x256", 256, 4 ); } },
+        { "record_threads/8x256", [] { runRecord( "record_threads/8x256", 256, 8 ); } },
+        { "record_threads/1x4096",
+          [] { runRecord( "record_threads/1x4096", 4096, 1 ); } },
+        { "record_threads/2x4096",
+          [] { runRecord( "record_threads/2x4096", 4096, 2 ); } },
+        { "record_threads/4x4096",
+          [] { runRecord( "record_threads/4x4096", 4096, 4 ); } },
+        { "record_threads/8x4096",
+          [] { runRecord( "record_threads/8x4096", 4096, 8 ); } },
+    };
+}
+
+}   // namespace bench
@@ -0,0 +1,86 @@
+#include "benchmark.hpp"
+#include "randomwindows.hpp"
+#include "xcb_wraper/rectarray.hpp"
+#include "xcb_wraper/winintersection.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+namespace {
+using xcbwraper::IntersectKernel;
+
+bool sameIntersection( const xcbwraper::Intersection & one,
+                       const xcbwraper::Intersection & two ) {
+    return one.isExist == two.isExist && one.leftTopPoint.x == two.leftTopPoint.x &&
+           one.leftTopPoint.y == two.leftTopPoint.y && one.width == two.width &&
+           one.height == two.height;
+}
+
+// Times every kernel against the scalar intersect() loop and counts the pairs
+// where a kernel disagrees with intersect(), any of them fails the scenario.
+void runIntersectBatch( std::size_t rectsCount ) {
+    constexpr std::size_t probesCount = 100;
+
+    const auto windows = randomWindows( rectsCount, 4 );
+    const auto probes  = randomWindows( probesCount, 5 );
+
+    xcbwraper::RectArray rects;
+    rects.reserve( rectsCount );
+    for ( auto && window : windows )
+        rects.push_back( window );
+
+    std::vector< xcbwraper::Intersection > expected( rectsCount * probesCount );
+    const double pairNs = nsPer( rectsCount * probesCount, [ & ] {
+        for ( std::size_t p = 0; p < probesCount; ++p )
+            for ( std::size_t i = 0; i < rectsCount; ++i )
+                expected[ p * rectsCount + i ] =
+                xcbwraper::intersect( probes[ p ], windows[ i ] );
+    } );
+
+    const auto name = "intersect_batch/" + std::to_string( rectsCount );
+    report( name + "/intersect",
+            { { "rects", static_cast< double >( rectsCount ) },
+              { "ns_per_rect", pairNs } } );
+
+    for ( auto [ kernel, kernelName ] :
+          { std::pair { IntersectKernel::eScalar, "scalar" },
+            std::pair { IntersectKernel::eSse2, "sse2" },
+            std::pair { IntersectKernel::eAvx2, "avx2" } } ) {
+        if ( kernel > xcbwraper::bestIntersectKernel() )
+            continue;
+
+        xcbwraper::IntersectionBatch batch;
+        std::size_t                  mismatches = 0;
+        double                       kernelNs   = 0;
+        for ( std::size_t p = 0; p < probesCount; ++p ) {
+            kernelNs += nsPer( rectsCount, [ & ] {
+                xcbwraper::intersectBatch( probes[ p ], rects, batch, kernel );
+            } );
+            for ( std::size_t i = 0; i < rectsCount; ++i )
+                mismatches +=
+                !sameIntersection( batch.at( i ), expected[ p * rectsCount + i ] );
+        }
+
+        report( name + "/" + kernelName,
+                { { "rects", static_cast< double >( rectsCount ) },
+                  { "ns_per_rect", kernelNs / probesCount },
+                  { "mismatches", static_cast< double >( mismatches ) } } );
+        if ( mismatches != 0 )
+            throw std::runtime_error( "The " + std::string( kernelName ) +
+                                      " kernel disagrees with intersect()." );
+    }
+}
+}   // namespace
+
+ScenariosVec rectArrayScenarios() {
+    return {
+        { "intersect_batch/1000", [] { runIntersectBatch( 1000 ); } },
+        { "intersect_batch/10000", [] { runIntersectBatch( 10000 ); } },
+    };
+}
+
+}   // namespace bench
@@ -0,0 +1,67 @@
+#include "benchmark.hpp"
+#include "renderloop.hpp"
+#include "renderrun.hpp"
+#include "xcb_wraper/region.hpp"
+
+#include <chrono>
+#include <string_view>
+
+namespace bench {
+
+namespace {
+using core::renderer::RenderLoopConfig;
+
+constexpr std::chrono::seconds loopDuration { 5 };
+
+void runLoop( std::string_view name, RenderLoopConfig config ) {
+    config.duration = loopDuration;
+    const auto run  = runRender( config );
+
+    const auto partialFrames = static_cast< double >( run.loop.partialFrames );
+    const auto repaintedArea = static_cast< double >( run.loop.repaintedArea );
+
+    auto metrics = renderMetrics( run );
+    metrics.insert( metrics.end(),
+                    { { "events", static_cast< double >( run.loop.handledEvents ) },
+                      { "partial_frames", partialFrames },
+                      { "repaint_area_px_per_partial_frame",
+                        partialFrames ? repaintedArea / partialFrames : 0.0 } } );
+    report( name, metrics );
+}
+
+// A text cursor blinking in the middle of the window, the only thing that
+// changes between frames.
+void blinkCursor( xcbwraper::Region & damage ) {
+    damage.unite( xcbwraper::Region::Box { 300, 140, 302, 160 } );
+}
+}   // namespace
+
+ScenariosVec renderLoopScenarios() {
+    return {
+        { "render_loop/continuous",
+          [] {
+              runLoop( "render_loop/continuous",
+                       { .mode = RenderLoopConfig::Mode::eContinuous } );
+          } },
+        { "render_loop/event_driven_60hz",
+          [] {
+              runLoop( "render_loop/event_driven_60hz",
+                       { .mode       = RenderLoopConfig::Mode::eEventDriven,
+                         .targetRate = 60 } );
+          } },
+        { "render_loop/cursor_blink_partial",
+          [] {
+              runLoop( "render_loop/cursor_blink_partial",
+                       { .mode          = RenderLoopConfig::Mode::eEventDriven,
+                         .targetRate    = 60,
+                         .damageHandler = blinkCursor } );
+          } },
+        { "render_loop/event_driven_idle",
+          [] {
+              runLoop( "render_loop/event_driven_idle",
+                       { .mode = RenderLoopConfig::Mode::eEventDriven } );
+          } },
+    };
+}
+
+}   // namespace bench
@@ -0,0 +1,83 @@
+#include "renderrun.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace bench {
+
+namespace {
+constexpr std::uint32_t layerSize = 32;
+}   // namespace
+
+RenderRun runRender( const core::renderer::RenderLoopConfig & config,
+                     const RendererHook &                     onCreate,
+                     const RendererHook &                     onDestroy ) {
+    using core::renderer::FrameTimer;
+    using core::renderer::VulkanGraphicRender;
+
+    RenderRun run;
+    run.loop = core::renderer::VulkanRenderInstance::init()->run(
+    config, onCreate, [ &run, &onDestroy ]( VulkanGraphicRender & renderer ) {
+        const auto & timer = renderer.frameTimer();
+        run.record         = renderer.recordStats();
+        run.cpuFrame       = timer.cpuPercentiles();
+        run.gpuFrame       = timer.percentiles( FrameTimer::Phase::eGpu );
+        run.counters       = timer.counters();
+        if ( onDestroy )
+            onDestroy( renderer );
+    } );
+    return run;
+}
+
+MetricsVec renderMetrics( const RenderRun & run ) {
+    using Ms = std::chrono::duration< double, std::milli >;
+    using Us = std::chrono::duration< double, std::micro >;
+
+    const auto cpuMs  = Ms( run.loop.cpuTime ).count();
+    const auto wallMs = Ms( run.loop.wallTime ).count();
+    const auto frames = static_cast< double >( run.loop.presentedFrames );
+
+    return { { "frames", frames },
+             { "fps", wallMs ? frames * 1000.0 / wallMs : 0.0 },
+             { "cpu_ms_per_frame", frames ? cpuMs / frames : 0.0 },
+             { "cpu_load", wallMs ? cpuMs / wallMs : 0.0 },
+             { "frame_cpu_p50_us", Us( run.cpuFrame.p50 ).count() },
+             { "frame_cpu_p95_us", Us( run.cpuFrame.p95 ).count() },
+             { "frame_cpu_p99_us", Us( run.cpuFrame.p99 ).count() },
+             { "frame_gpu_p50_us", Us( run.gpuFrame.p50 ).count() },
+             { "frame_gpu_p95_us", Us( run.gpuFrame.p95 ).count() },
+             { "frame_gpu_p99_us", Us( run.gpuFrame.p99 ).count() },
+             { "swapchain_recreations",
+               static_cast< double >( run.counters.swapchainRecreations ) } };
+}
+
+void recordLayerClear( const vk::CommandBuffer & commandBuffer,
+                       const vk::Extent2D &      extent,
+                       std::size_t               layer ) {
+    if ( extent.width <= layerSize || extent.height <= layerSize )
+        return;
+
+    const vk::ClearAttachment layerClear {
+        .aspectMask      = vk::ImageAspectFlagBits::eColor,
+        .colorAttachment = 0,
+        .clearValue      = vk::ClearValue(
+        vk::ClearColorValue( std::array< float, 4 > { 0.2f, 0.4f, 0.8f, 1.0f } ) )
+    };
+
+    const auto x =
+    static_cast< std::int32_t >( layer * 37 % ( extent.width - layerSize ) );
+    const auto y =
+    static_cast< std::int32_t >( layer * 53 % ( extent.height - layerSize ) );
+
+    const vk::ClearRect layerRect {
+        .rect = vk::Rect2D { .offset = vk::Offset2D { .x = x, .y = y },
+                             .extent = vk::Extent2D { .width  = layerSize,
+                                                      .height = layerSize } },
+        .baseArrayLayer = 0,
+        .layerCount     = 1
+    };
+    commandBuffer.clearAttachments( layerClear, layerRect );
+}
+
+}   // namespace bench
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+#include "benchmark.hpp"
+#include "frametimer.hpp"
+#include "renderloop.hpp"
+#include "vulkanrender.hpp"
+
+namespace bench {
+
+// What one run of the render loop measured, read from the renderer right
+// before it is destroyed.
+struct RenderRun final {
+    core::renderer::RenderLoopStats                  loop;
+    core::renderer::VulkanGraphicRender::RecordStats record;
+    core::renderer::FrameTimer::Percentiles          cpuFrame;
+    core::renderer::FrameTimer::Percentiles          gpuFrame;
+    core::renderer::FrameTimer::Counters             counters;
+};
+
+using RendererHook = core::renderer::VulkanRenderInstance::RendererHook;
+
+// Runs the loop on the process wide instance, windowed or headless. onDestroy
+// runs after the statistics were read, to free what onCreate made.
+RenderRun runRender( const core::renderer::RenderLoopConfig & config,
+                     const RendererHook &                     onCreate  = {},
+                     const RendererHook &                     onDestroy = {} );
+
+// Frames, rates, CPU time per frame and the frame time percentiles.
+MetricsVec renderMetrics( const RenderRun & run );
+
+// One 32x32 clear spread over the image per layer, the way a compositor
+// records one draw per window.
+void recordLayerClear( const vk::CommandBuffer & commandBuffer,
+                       const vk::Extent2D &      extent,
+                       std::size_t               layer );
+
+}   // namespace bench
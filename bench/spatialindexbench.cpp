@@ -0,0 +1,72 @@
+#include "benchmark.hpp"
+#include "randomwindows.hpp"
+#include "xcb_wraper/spatialindex.hpp"
+#include "xcb_wraper/windowgeometry.hpp"
+#include "xcb_wraper/winintersection.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace bench {
+
+namespace {
+void runSpatialIndex( std::size_t windowsCount ) {
+    constexpr std::size_t queriesCount = 1000;
+
+    const auto windows = randomWindows( windowsCount, 1 );
+    const auto moved   = randomWindows( windowsCount, 2 );
+    const auto probes  = randomWindows( queriesCount, 3 );
+
+    xcbwraper::SpatialIndex index;
+    std::size_t             checksum = 0;
+
+    const double insertNs = nsPer( windowsCount, [ & ] {
+        for ( std::size_t i = 0; i < windowsCount; ++i )
+            index.insert( i, windows[ i ], i );
+    } );
+    const double updateNs = nsPer( windowsCount, [ & ] {
+        for ( std::size_t i = 0; i < windowsCount; ++i )
+            index.update( i, moved[ i ], i );
+    } );
+    const double queryNs = nsPer( queriesCount, [ & ] {
+        for ( auto && probe : probes )
+            checksum += index.query( probe ).size();
+    } );
+    const double topmostNs = nsPer( queriesCount, [ & ] {
+        for ( auto && probe : probes )
+            checksum += index.topmostAt( probe.leftTopPoint ).value_or( 0 );
+    } );
+    const double occludedNs =
+    nsPer( 1, [ & ] { checksum += index.occluded().size(); } );
+
+    // The same overlap count with one intersect() per pair.
+    const double pairwiseNs = nsPer( 1, [ & ] {
+        for ( std::size_t i = 0; i < windowsCount; ++i )
+            for ( std::size_t j = i + 1; j < windowsCount; ++j )
+                checksum += xcbwraper::intersect( moved[ i ], moved[ j ] ) ? 1 : 0;
+    } );
+
+    const auto name = "spatial_index/" + std::to_string( windowsCount );
+    report( name,
+            { { "windows", static_cast< double >( windowsCount ) },
+              { "insert_ns", insertNs },
+              { "update_ns", updateNs },
+              { "query_ns", queryNs },
+              { "topmost_ns", topmostNs },
+              { "occluded_all_us", occludedNs / 1000.0 },
+              { "pairwise_all_us", pairwiseNs / 1000.0 },
+              { "checksum", static_cast< double >( checksum ) } } );
+}
+}   // namespace
+
+ScenariosVec spatialIndexScenarios() {
+    return {
+        { "spatial_index/10", [] { runSpatialIndex( 10 ); } },
+        { "spatial_index/100", [] { runSpatialIndex( 100 ); } },
+        { "spatial_index/1000", [] { runSpatialIndex( 1000 ); } },
+        { "spatial_index/10000", [] { runSpatialIndex( 10000 ); } },
+    };
+}
+
+}   // namespace bench
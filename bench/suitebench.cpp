@@ -0,0 +1,338 @@
+#include "benchmark.hpp"
+#include "compositor.hpp"
+#include "damagetracker.hpp"
+#include "renderloop.hpp"
+#include "renderrun.hpp"
+#include "windowtreecache.hpp"
+#include "xcb_wraper/region.hpp"
+#include "xcb_wraper/xcbconnect.hpp"
+#include "xcbwindows.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <xcb/xcb.h>
+
+namespace bench {
+
+namespace {
+using core::renderer::RenderLoopConfig;
+using core::renderer::VulkanGraphicRender;
+
+constexpr std::chrono::seconds suiteDuration { 5 };
+constexpr std::size_t          enumerationScans = 50;
+constexpr std::size_t          damageRounds     = 100;
+// Later windows overlap earlier ones from 16 pixels on, the corner stays visible.
+constexpr std::uint16_t damageSize = 16;
+// Composited layers sample a texture of textureSize stretched to layerSize.
+constexpr std::uint32_t textureSize = 64;
+constexpr std::uint16_t layerSize   = 96;
+
+RenderLoopConfig continuousConfig() {
+    return { .mode = RenderLoopConfig::Mode::eContinuous, .duration = suiteDuration };
+}
+
+// Damage covering any image, so every frame repaints everything.
+void damageAll( xcbwraper::Region & damage ) {
+    constexpr auto maxCoord =
+    std::numeric_limits< xcbwraper::Region::CoordType >::max();
+    damage.unite( xcbwraper::Region::Box { 0, 0, maxCoord, maxCoord } );
+}
+
+void runFullClear() {
+    report( "suite/full_clear", renderMetrics( runRender( continuousConfig() ) ) );
+}
+
+void runLayers( std::string_view name, std::size_t layersCount ) {
+    auto metrics = renderMetrics(
+    runRender( continuousConfig(), [ layersCount ]( VulkanGraphicRender & renderer ) {
+        renderer.setFrameRecorder(
+        [ layersCount ]( const VulkanGraphicRender::FrameContext & frame ) {
+            for ( std::size_t layer = 0; layer < layersCount; ++layer )
+                recordLayerClear( frame.commandBuffer, frame.extent, layer );
+        } );
+    } ) );
+    metrics.emplace_back( "layers", static_cast< double >( layersCount ) );
+    report( name, metrics );
+}
+
+// Calls frameAction with the renderer before every frame, which then repaints
+// the whole image.
+template < class FrameAction >
+void runPerFrame( std::string_view name, FrameAction && frameAction ) {
+    VulkanGraphicRender * renderer = nullptr;
+
+    auto config          = continuousConfig();
+    config.damageHandler = [ & ]( xcbwraper::Region & damage ) {
+        if ( renderer )
+            frameAction( *renderer );
+        damageAll( damage );
+    };
+
+    const auto run = runRender(
+    config, [ &renderer ]( VulkanGraphicRender & created ) { renderer = &created; } );
+    report( name, renderMetrics( run ) );
+}
+
+void runResizeStorm() {
+    constexpr std::array< vk::Extent2D, 4 > extents {
+        vk::Extent2D { .width = 600, .height = 300 },
+        vk::Extent2D { .width = 800, .height = 450 },
+        vk::Extent2D { .width = 1024, .height = 576 },
+        vk::Extent2D { .width = 640, .height = 480 }
+    };
+
+    std::size_t next = 0;
+    runPerFrame( "suite/resize_storm", [ & ]( VulkanGraphicRender & renderer ) {
+        renderer.resize( extents[ next ] );
+        next = ( next + 1 ) % extents.size();
+    } );
+}
+
+void runSwapchainRecreation() {
+    runPerFrame( "suite/swapchain_recreation",
+                 []( VulkanGraphicRender & renderer ) { renderer.update(); } );
+}
+
+// Full scans of the top level windows, as a compositor does at startup.
+void runEnumeration( std::string_view name, std::size_t windowsCount ) {
+    auto       shared  = std::make_shared< xcbwraper::XCBConnect >();
+    const auto windows = createWindows( *shared, windowsCount );
+
+    std::size_t cachedWindows = 0;
+    const auto  nsPerScan     = nsPer( enumerationScans, [ & ] {
+        core::composite::WindowTreeCache cache( shared );
+        for ( std::size_t scan = 1; scan < enumerationScans; ++scan )
+            cache.rescan();
+        cachedWindows = cache.size();
+    } );
+
+    destroyWindows( *shared, windows );
+
+    // Other clients' windows are scanned too.
+    report( name,
+            { { "windows", static_cast< double >( windows.size() ) },
+              { "cached_windows", static_cast< double >( cachedWindows ) },
+              { "us_per_scan", nsPerScan / 1000.0 },
+              { "us_per_window",
+                cachedWindows
+                ? nsPerScan / 1000.0 / static_cast< double >( cachedWindows )
+                : 0.0 } } );
+}
+
+// Every round draws a corner of each window and collects the damage, as a
+// compositor does between two frames.
+void runDamage( std::string_view name, std::size_t windowsCount ) {
+    auto               shared  = std::make_shared< xcbwraper::XCBConnect >();
+    xcb_connection_t * connect = *shared;
+    const auto         windows = createWindows( connect, windowsCount );
+
+    core::composite::DamageTracker tracker( connect );
+    for ( auto window : windows ) {
+        tracker.track( window );
+        xcb_map_window( connect, window );
+    }
+
+    const auto gc = xcb_generate_id( connect );
+    xcb_create_gc( connect, gc, windows.front(), 0, nullptr );
+    const xcb_rectangle_t corner { 0, 0, damageSize, damageSize };
+
+    std::uint64_t damagedPixels = 0;
+    const auto    nsPerRound    = nsPer( damageRounds, [ & ] {
+        for ( std::size_t round = 0; round < damageRounds; ++round ) {
+            for ( auto window : windows )
+                xcb_poly_fill_rectangle( connect, window, gc, 1, &corner );
+            // The damage events of the drawing come before the reply.
+            std::free( xcb_get_input_focus_reply(
+            connect, xcb_get_input_focus( connect ), nullptr ) );
+            while ( auto * event = xcb_poll_for_queued_event( connect ) ) {
+                tracker.handleEvent( *event );
+                std::free( event );
+            }
+            for ( auto window : tracker.damaged() )
+                damagedPixels += tracker.damage( window )->area();
+            tracker.clear();
+        }
+    } );
+
+    xcb_free_gc( connect, gc );
+    destroyWindows( connect, windows );
+
+    // The first round also collects whatever mapping the windows damaged.
+    report( name,
+            { { "windows", static_cast< double >( windows.size() ) },
+              { "us_per_round", nsPerRound / 1000.0 },
+              { "damaged_pixels_per_round",
+                static_cast< double >( damagedPixels ) /
+                static_cast< double >( damageRounds ) } } );
+}
+// One texture shared by every layer, as many windows of one size would be.
+struct LayerTexture final {
+    vk::Image                                    image;
+    vk::ImageView                                view;
+    core::renderer::MemoryAllocator::Allocation memory {};
+};
+
+LayerTexture createLayerTexture( VulkanGraphicRender & renderer ) {
+    auto &       allocator = renderer.allocator();
+    const auto & logicDev  = allocator.device();
+
+    LayerTexture texture;
+    texture.image = logicDev.createImage( vk::ImageCreateInfo {
+    .imageType   = vk::ImageType::e2D,
+    .format      = vk::Format::eB8G8R8A8Unorm,
+    .extent =
+    vk::Extent3D { .width = textureSize, .height = textureSize, .depth = 1 },
+    .mipLevels   = 1,
+    .arrayLayers = 1,
+    .samples     = vk::SampleCountFlagBits::e1,
+    .tiling      = vk::ImageTiling::eOptimal,
+    .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+    .sharingMode   = vk::SharingMode::eExclusive,
+    .initialLayout = vk::ImageLayout::eUndefined } );
+    texture.memory =
+    allocator.allocate( texture.image, vk::MemoryPropertyFlagBits::eDeviceLocal );
+    texture.view = logicDev.createImageView( vk::ImageViewCreateInfo {
+    .image    = texture.image,
+    .viewType = vk::ImageViewType::e2D,
+    .format   = vk::Format::eB8G8R8A8Unorm,
+    .subresourceRange =
+    vk::ImageSubresourceRange { .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                .baseMipLevel   = 0,
+                                .levelCount     = 1,
+                                .baseArrayLayer = 0,
+                                .layerCount     = 1 } } );
+
+    // Opaque, a horizontal gradient.
+    std::vector< std::byte > pixels( std::size_t { 4 } * textureSize * textureSize );
+    for ( std::size_t pixel = 0; pixel < textureSize * textureSize; ++pixel ) {
+        const auto shade = static_cast< std::byte >( pixel % textureSize * 4 );
+        pixels[ 4 * pixel ]     = shade;
+        pixels[ 4 * pixel + 1 ] = std::byte { 0x66 };
+        pixels[ 4 * pixel + 2 ] = std::byte { 0x33 };
+        pixels[ 4 * pixel + 3 ] = std::byte { 0xff };
+    }
+    if ( !renderer.uploadImage( VulkanGraphicRender::ImageUpload {
+         .image    = texture.image,
+         .extent   = vk::Extent2D { .width = textureSize, .height = textureSize },
+         .pixels   = pixels.data(),
+         .rowPitch = std::size_t { 4 } * textureSize,
+         .layout   = vk::ImageLayout::eUndefined } ) )
+        throw std::runtime_error( "createLayerTexture(): The staging ring is full." );
+    return texture;
+}
+
+void destroyLayerTexture( VulkanGraphicRender & renderer, const LayerTexture & texture ) {
+    auto &       allocator = renderer.allocator();
+    const auto & logicDev  = allocator.device();
+    // The last frames may still sample the texture.
+    logicDev.waitIdle();
+    logicDev.destroyImageView( texture.view );
+    logicDev.destroyImage( texture.image );
+    allocator.free( texture.memory );
+}
+
+// Spreads the layers over the image like recordLayerClear() does, every fourth
+// one half transparent.
+void placeLayers( core::renderer::Compositor::LayersVec & layers, vk::Extent2D extent ) {
+    using CoordType = xcbwraper::Point::CoordType;
+    if ( extent.width <= layerSize || extent.height <= layerSize )
+        return;
+
+    for ( std::size_t layer = 0; layer < layers.size(); ++layer ) {
+        auto & geometry = layers[ layer ].geometry;
+        geometry.leftTopPoint = xcbwraper::Point {
+            static_cast< CoordType >( layer * 37 % ( extent.width - layerSize ) ),
+            static_cast< CoordType >( layer * 53 % ( extent.height - layerSize ) )
+        };
+        geometry.width         = layerSize;
+        geometry.height        = layerSize;
+        geometry.rightBotPoint = xcbwraper::Point {
+            static_cast< CoordType >( geometry.leftTopPoint.x + layerSize ),
+            static_cast< CoordType >( geometry.leftTopPoint.y + layerSize )
+        };
+        layers[ layer ].opacity = layer % 4 == 3 ? 0.5f : 1.0f;
+    }
+}
+
+// Every frame composites the whole stack with one pipeline, draws and
+// descriptor writes per frame should not grow with the layers.
+void runComposite( std::string_view name, std::size_t layersCount ) {
+    using core::renderer::Compositor;
+
+    LayerTexture          texture;
+    Compositor::LayersVec layers;
+    std::uint64_t         frames = 0;
+    std::uint64_t         draws  = 0;
+    std::uint64_t         culled = 0;
+    std::uint64_t         writes = 0;
+    std::uint32_t         perSet = 0;
+
+    const auto onCreate = [ & ]( VulkanGraphicRender & renderer ) {
+        texture = createLayerTexture( renderer );
+        layers.assign( layersCount, Compositor::Layer { .view = texture.view } );
+        perSet = renderer.compositor().texturesPerSet();
+
+        renderer.setFrameRecorder(
+        [ &, compositor = &renderer.compositor() ](
+        const VulkanGraphicRender::FrameContext & frame ) {
+            placeLayers( layers, frame.extent );
+            compositor->record(
+            frame.commandBuffer, frame.frameSlot, frame.extent, frame.repaint, layers );
+            const auto & stats = compositor->stats();
+            draws += stats.draws;
+            culled += stats.culledLayers;
+            writes += stats.descriptorWrites;
+            ++frames;
+        } );
+    };
+    const auto onDestroy = [ & ]( VulkanGraphicRender & renderer ) {
+        destroyLayerTexture( renderer, texture );
+    };
+
+    auto metrics = renderMetrics( runRender( continuousConfig(), onCreate, onDestroy ) );
+    const auto perFrame = [ frames ]( std::uint64_t total ) {
+        return frames ? static_cast< double >( total ) / static_cast< double >( frames )
+                      : 0.0;
+    };
+    metrics.emplace_back( "layers", static_cast< double >( layersCount ) );
+    metrics.emplace_back( "textures_per_set", static_cast< double >( perSet ) );
+    metrics.emplace_back( "draws_per_frame", perFrame( draws ) );
+    metrics.emplace_back( "culled_layers_per_frame", perFrame( culled ) );
+    metrics.emplace_back( "descriptor_writes_per_frame", perFrame( writes ) );
+    report( name, metrics );
+}
+}   // namespace
+
+ScenariosVec suiteScenarios() {
+    return {
+        { "suite/full_clear", runFullClear },
+        { "suite/layers/1", [] { runLayers( "suite/layers/1", 1 ); } },
+        { "suite/layers/16", [] { runLayers( "suite/layers/16", 16 ); } },
+        { "suite/layers/256", [] { runLayers( "suite/layers/256", 256 ); } },
+        { "suite/layers/1024", [] { runLayers( "suite/layers/1024", 1024 ); } },
+        { "suite/resize_storm", runResizeStorm },
+        { "suite/swapchain_recreation", runSwapchainRecreation },
+        { "suite/enumerate_windows/10",
+          [] { runEnumeration( "suite/enumerate_windows/10", 10 ); } },
+        { "suite/enumerate_windows/100",
+          [] { runEnumeration( "suite/enumerate_windows/100", 100 ); } },
+        { "suite/enumerate_windows/1000",
+          [] { runEnumeration( "suite/enumerate_windows/1000", 1000 ); } },
+        { "suite/damage/10", [] { runDamage( "suite/damage/10", 10 ); } },
+        { "suite/damage/100", [] { runDamage( "suite/damage/100", 100 ); } },
+        { "suite/composite/16", [] { runComposite( "suite/composite/16", 16 ); } },
+        { "suite/composite/256", [] { runComposite( "suite/composite/256", 256 ); } },
+        { "suite/composite/1024",
+          [] { runComposite( "suite/composite/1024", 1024 ); } },
+    };
+}
+
+}   // namespace bench
@@ -0,0 +1,91 @@
+#include "benchmark.hpp"
+#include "xcbwindows.hpp"
+#include "xcb_wraper/windowsnapshot.hpp"
+#include "xcb_wraper/xcbconnect.hpp"
+#include "xcb_wraper/xcbwindowprop.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+namespace bench {
+
+namespace {
+using xcbwraper::WindowIDsVec;
+
+constexpr std::size_t windowsCount = 200;
+
+template < class Query > void runQueries( std::string_view name, Query && query ) {
+    auto       shared  = std::make_shared< xcbwraper::XCBConnect >();
+    const auto windows = createWindows( *shared, windowsCount );
+
+    const auto        start    = std::chrono::steady_clock::now();
+    const std::size_t checksum = query( shared, windows );
+    const auto        elapsed  = std::chrono::steady_clock::now() - start;
+
+    destroyWindows( *shared, windows );
+
+    using Us = std::chrono::duration< double, std::micro >;
+    report( name,
+            { { "windows", static_cast< double >( windows.size() ) },
+              { "us_per_window",
+                std::chrono::duration_cast< Us >( elapsed ).count() /
+                static_cast< double >( windows.size() ) },
+              { "checksum", static_cast< double >( checksum ) } } );
+}
+
+// Geometry and class one window after another, the connection comes from
+// connectionFor().
+template < class ConnectionFactory >
+auto perWindowQuery( ConnectionFactory && connectionFor ) {
+    return [ connectionFor ]( const xcbwraper::XCBConnectShared & shared,
+                              const WindowIDsVec &                windows ) {
+        std::size_t checksum = 0;
+        for ( auto window : windows ) {
+            xcbwraper::XCBWindowProp prop { connectionFor( shared ), window };
+            checksum += prop.Geometry().getInfo().width + prop.Class().size();
+        }
+        return checksum;
+    };
+}
+}   // namespace
+
+ScenariosVec xcbQueryScenarios() {
+    return {
+        { "xcb_query/connection_per_window",
+          [] {
+              runQueries( "xcb_query/connection_per_window",
+                          perWindowQuery( []( const xcbwraper::XCBConnectShared & ) {
+                              return std::make_shared< xcbwraper::XCBConnect >();
+                          } ) );
+          } },
+        { "xcb_query/shared_connection",
+          [] {
+              runQueries( "xcb_query/shared_connection",
+                          perWindowQuery(
+                          []( const xcbwraper::XCBConnectShared & shared ) {
+                              return shared;
+                          } ) );
+          } },
+        { "xcb_query/batched_snapshot",
+          [] {
+              runQueries( "xcb_query/batched_snapshot",
+                          []( const xcbwraper::XCBConnectShared & shared,
+                              const WindowIDsVec &                windows ) {
+                              std::size_t checksum = 0;
+                              for ( auto && snapshot :
+                                    xcbwraper::snapshotWindows( shared, windows ) )
+                                  checksum += snapshot.geometry.width +
+                                              snapshot.windowClass.size();
+                              return checksum;
+                          } );
+          } },
+    };
+}
+
+}   // namespace bench
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+#include "xcb_wraper/xcbwindowprop.hpp"
+
+namespace bench {
+
+// Top level windows with WM_CLASS set, as a window manager would see them.
+inline xcbwraper::WindowIDsVec
+createWindows( xcb_connection_t * connect, std::size_t count ) {
+    constexpr std::string_view wmClass { "bench\0Bench\0", 12 };
+
+    auto screen = xcb_setup_roots_iterator( xcb_get_setup( connect ) ).data;
+
+    xcbwraper::WindowIDsVec windows;
+    for ( std::size_t i = 0; i < count; ++i ) {
+        const auto window = xcb_generate_id( connect );
+        xcb_create_window( connect,
+                           XCB_COPY_FROM_PARENT,
+                           window,
+                           screen->root,
+                           static_cast< std::int16_t >( i % 64 * 16 ),
+                           static_cast< std::int16_t >( i / 64 * 16 ),
+                           64,
+                           64,
+                           0,
+                           XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                           screen->root_visual,
+                           0,
+                           nullptr );
+        xcb_change_property( connect,
+                             XCB_PROP_MODE_REPLACE,
+                             window,
+                             XCB_ATOM_WM_CLASS,
+                             XCB_ATOM_STRING,
+                             8,
+                             wmClass.size(),
+                             wmClass.data() );
+        windows.push_back( window );
+    }
+    xcb_flush( connect );
+    return windows;
+}
+
+inline void destroyWindows( xcb_connection_t *              connect,
+                            const xcbwraper::WindowIDsVec & windows ) {
+    for ( auto window : windows )
+        xcb_destroy_window( connect, window );
+    xcb_flush( connect );
+}
+
+}   // namespace bench
@@ -1,35 +1,70 @@
 #include "composite.hpp"
+#include "xcb_wraper/xcbconnect.hpp"
 #include <cassert>
+#include <cstdlib>
 #include <stdexcept>
 #include <xcb/composite.h>
+#include <xcb/shape.h>
 #include <xcb/xcb.h>
 
 namespace core::composite {
 
-Composite::Composite() {
-    mXcbConnection = xcb_connect( nullptr, nullptr );
+Composite::Composite( xcb_connection_t * xcbConnection ) :
+mXcbConnection( xcbConnection ) {
     assert( mXcbConnection != nullptr );
     auto screen = xcb_setup_roots_iterator( xcb_get_setup( mXcbConnection ) ).data;
     assert( screen != nullptr );
+    mRoot = screen->root;
 
-    auto overlayWindowReply = xcb_composite_get_overlay_window_reply(
-    mXcbConnection,
-    xcb_composite_get_overlay_window( mXcbConnection, screen->root ),
-    nullptr );
-
-    if ( overlayWindowReply || overlayWindowReply->overlay_win != XCB_NONE )
-        mCompositeOverlayWindow = overlayWindowReply->overlay_win;
-    else
-        throw std::runtime_error( "Getting overlay windows is failed." );
-    xcb_disconnect( mXcbConnection );
+    // The server rejects requests of a client that did not negotiate a version.
+    // 0.3 brought the overlay window.
+    const xcbwraper::XCBReply< xcb_composite_query_version_reply_t > version {
+        xcb_composite_query_version_reply(
+        mXcbConnection,
+        xcb_composite_query_version( mXcbConnection, 0, 4 ),
+        nullptr )
+    };
+    if ( !version || ( version->major_version == 0 && version->minor_version < 3 ) )
+        throw std::runtime_error( "Composite 0.3 is not supported." );
 }
 
 Composite::~Composite() {
+    if ( mCompositeOverlayWindow == XCB_NONE )
+        return;
+    xcb_composite_release_overlay_window( mXcbConnection, mRoot );
+    xcb_flush( mXcbConnection );
     mCompositeOverlayWindow = XCB_NONE;
 }
 
-xcb_window_t Composite::getCompositeOverleyWindow() const {
+xcb_window_t Composite::getCompositeOverleyWindow() {
+    if ( mCompositeOverlayWindow != XCB_NONE )
+        return mCompositeOverlayWindow;
+
+    const xcbwraper::XCBReply< xcb_composite_get_overlay_window_reply_t >
+    overlayWindowReply { xcb_composite_get_overlay_window_reply(
+    mXcbConnection,
+    xcb_composite_get_overlay_window( mXcbConnection, mRoot ),
+    nullptr ) };
+
+    if ( !overlayWindowReply || overlayWindowReply->overlay_win == XCB_NONE )
+        throw std::runtime_error( "Getting overlay windows is failed." );
+    mCompositeOverlayWindow = overlayWindowReply->overlay_win;
     return mCompositeOverlayWindow;
 }
 
+void Composite::passOverlayInput() {
+    xcb_shape_rectangles( mXcbConnection,
+                          XCB_SHAPE_SO_SET,
+                          XCB_SHAPE_SK_INPUT,
+                          XCB_CLIP_ORDERING_UNSORTED,
+                          getCompositeOverleyWindow(),
+                          0,
+                          0,
+                          0,
+                          nullptr );
+    xcb_flush( mXcbConnection );
+}
+
+xcb_window_t Composite::root() const { return mRoot; }
+
 }   // namespace core::composite
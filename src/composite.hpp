@@ -7,11 +7,24 @@ namespace core::composite {
 
 class Composite final {
     xcb_connection_t * mXcbConnection;
-    xcb_window_t       mCompositeOverlayWindow;
+    xcb_window_t       mRoot;
+    xcb_window_t       mCompositeOverlayWindow { XCB_NONE };
 
 public:
-    Composite();
+    // The connection is borrowed and must outlive the object. Negotiates the
+    // extension version of the first screen.
+    explicit Composite( xcb_connection_t * xcbConnection );
+    Composite( const Composite & ) = delete;
+    Composite & operator=( const Composite & ) = delete;
+    // Releases the overlay window if it was taken, the server unmaps it with
+    // its last user.
     ~Composite();
-    xcb_window_t getCompositeOverleyWindow() const;
+    // Takes the overlay window on the first call, the server maps it above
+    // every other window then.
+    xcb_window_t getCompositeOverleyWindow();
+    // Empties the input shape of the overlay window, so the pointer reaches
+    // the windows below it while it is presented to.
+    void passOverlayInput();
+    xcb_window_t root() const;
 };
 }   // namespace core::composite
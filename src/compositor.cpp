@@ -0,0 +1,432 @@
+#include "compositor.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace core::renderer {
+
+namespace {
+// SPIR-V built from src/shaders.
+constexpr std::uint32_t vertexCode[] = {
+#include "compositor.vert.inc"
+};
+constexpr std::uint32_t fragmentCode[] = {
+#include "compositor.frag.inc"
+};
+constexpr std::uint32_t nonUniformFragmentCode[] = {
+#include "compositor_nonuniform.frag.inc"
+};
+constexpr std::uint32_t singleFragmentCode[] = {
+#include "compositor_single.frag.inc"
+};
+
+// Four vertices of a triangle strip.
+constexpr std::uint32_t quadVertices = 4;
+// Instance buffers start with room for this many layers.
+constexpr std::size_t minInstances = 64;
+
+template < std::size_t Size >
+[[nodiscard]] vk::ShaderModule createShader( const vk::Device & logicDev,
+                                             const std::uint32_t ( &code )[ Size ] ) {
+    return logicDev.createShaderModule(
+    vk::ShaderModuleCreateInfo { .codeSize = sizeof( code ), .pCode = code } );
+}
+
+[[nodiscard]] vk::Rect2D rectOf( const xcbwraper::Region::Box & box ) {
+    return vk::Rect2D { .offset = vk::Offset2D { .x = box.x1, .y = box.y1 },
+                        .extent = vk::Extent2D {
+                        .width  = static_cast< std::uint32_t >( box.x2 - box.x1 ),
+                        .height = static_cast< std::uint32_t >( box.y2 - box.y1 ) } };
+}
+}   // namespace
+
+Compositor::Compositor( const CreateInfo & createInfo ) :
+mLogicDev( createInfo.logicDev ), mAllocator( *createInfo.allocator ),
+mPipelineCache( createInfo.pipelineCache ) {
+    const auto & gpu = *createInfo.gpu;
+    // Even one draw per layer picks its texture out of the array, without
+    // dynamic indexing the array shrinks to one texture.
+    const bool dynamicIndexing =
+    gpu.device.getFeatures().shaderSampledImageArrayDynamicIndexing == VK_TRUE;
+    mInstanced = dynamicIndexing && createInfo.nonUniformIndexing;
+
+    const auto & limits = gpu.properties.limits;
+    mTexturesPerSet     = dynamicIndexing
+                          ? std::min( { maxTexturesPerSet,
+                                        limits.maxPerStageDescriptorSamplers,
+                                        limits.maxPerStageDescriptorSampledImages,
+                                        limits.maxDescriptorSetSamplers,
+                                        limits.maxDescriptorSetSampledImages } )
+                          : 1;
+
+    mSampler = mLogicDev.createSampler(
+    vk::SamplerCreateInfo { .magFilter    = vk::Filter::eLinear,
+                            .minFilter    = vk::Filter::eLinear,
+                            .mipmapMode   = vk::SamplerMipmapMode::eNearest,
+                            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+                            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+                            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+                            .maxLod       = 0.0f } );
+
+    // The samplers are immutable, frames only write the views.
+    const std::vector< vk::Sampler > samplers( mTexturesPerSet, mSampler );
+    const vk::DescriptorSetLayoutBinding texturesBinding {
+        .binding            = 0,
+        .descriptorType     = vk::DescriptorType::eCombinedImageSampler,
+        .descriptorCount    = mTexturesPerSet,
+        .stageFlags         = vk::ShaderStageFlagBits::eFragment,
+        .pImmutableSamplers = samplers.data()
+    };
+    mSetLayout = mLogicDev.createDescriptorSetLayout( vk::DescriptorSetLayoutCreateInfo {
+    .bindingCount = 1, .pBindings = &texturesBinding } );
+
+    const vk::PushConstantRange targetRange { .stageFlags =
+                                              vk::ShaderStageFlagBits::eVertex,
+                                              .offset = 0,
+                                              .size   = 2 * sizeof( float ) };
+    mPipelineLayout = mLogicDev.createPipelineLayout(
+    vk::PipelineLayoutCreateInfo { .setLayoutCount         = 1,
+                                   .pSetLayouts            = &mSetLayout,
+                                   .pushConstantRangeCount = 1,
+                                   .pPushConstantRanges    = &targetRange } );
+
+    mVertexShader = createShader( mLogicDev, vertexCode );
+    if ( mInstanced )
+        mFragmentShader = createShader( mLogicDev, nonUniformFragmentCode );
+    else if ( dynamicIndexing )
+        mFragmentShader = createShader( mLogicDev, fragmentCode );
+    else
+        mFragmentShader = createShader( mLogicDev, singleFragmentCode );
+    mPipeline = createPipeline( createInfo.renderPass );
+
+    mSlots.resize( createInfo.framesInFlight );
+}
+
+Compositor::~Compositor() {
+    for ( auto && slot : mSlots ) {
+        for ( auto && textureSet : slot.sets )
+            mLogicDev.destroyDescriptorPool( textureSet.pool );
+        if ( slot.capacity != 0 ) {
+            mLogicDev.destroyBuffer( slot.instances );
+            mAllocator.free( slot.memory );
+        }
+    }
+    mLogicDev.destroyPipeline( mPipeline );
+    mLogicDev.destroyShaderModule( mFragmentShader );
+    mLogicDev.destroyShaderModule( mVertexShader );
+    mLogicDev.destroyPipelineLayout( mPipelineLayout );
+    mLogicDev.destroyDescriptorSetLayout( mSetLayout );
+    mLogicDev.destroySampler( mSampler );
+}
+
+vk::Pipeline Compositor::setRenderPass( vk::RenderPass renderPass ) {
+    const auto previous = mPipeline;
+    mPipeline           = createPipeline( renderPass );
+    return previous;
+}
+
+void Compositor::record( const vk::CommandBuffer & commandBuffer,
+                         std::size_t               frameSlot,
+                         vk::Extent2D              extent,
+                         const xcbwraper::Region & repaint,
+                         const LayersVec &         layers ) {
+    cull( repaint, layers );
+    mStats = Stats { .layers       = layers.size(),
+                     .culledLayers = layers.size() - mDrawn.size() };
+    if ( mDrawn.empty() )
+        return;
+
+    // The slot's previous frame is done, its buffer and sets are free.
+    auto & slot = mSlots.at( frameSlot );
+    reserveInstances( slot, mDrawn.size() );
+
+    mInstances.clear();
+    for ( std::size_t layer = 0; layer < mDrawn.size(); ++layer ) {
+        const auto & geometry = mDrawn[ layer ]->geometry;
+        mInstances.push_back(
+        Instance { .x       = static_cast< float >( geometry.leftTopPoint.x ),
+                   .y       = static_cast< float >( geometry.leftTopPoint.y ),
+                   .width   = static_cast< float >( geometry.width ),
+                   .height  = static_cast< float >( geometry.height ),
+                   .opacity = mDrawn[ layer ]->opacity,
+                   .texture = static_cast< std::uint32_t >( layer % mTexturesPerSet ) } );
+    }
+    std::memcpy(
+    slot.memory.mapped, mInstances.data(), mInstances.size() * sizeof( Instance ) );
+
+    const auto setsCount = ( mDrawn.size() + mTexturesPerSet - 1 ) / mTexturesPerSet;
+    while ( slot.sets.size() < setsCount )
+        slot.sets.push_back( createTextureSet() );
+    updateTextureSets( slot, setsCount );
+    mStats.descriptorSets = setsCount;
+
+    const std::array< float, 2 > scale { 2.0f / static_cast< float >( extent.width ),
+                                         2.0f / static_cast< float >( extent.height ) };
+    commandBuffer.bindPipeline( vk::PipelineBindPoint::eGraphics, mPipeline );
+    commandBuffer.bindVertexBuffers( 0, slot.instances, vk::DeviceSize { 0 } );
+    commandBuffer.pushConstants< float >(
+    mPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, scale );
+    commandBuffer.setViewport(
+    0,
+    vk::Viewport { .x        = 0.0f,
+                   .y        = 0.0f,
+                   .width    = static_cast< float >( extent.width ),
+                   .height   = static_cast< float >( extent.height ),
+                   .minDepth = 0.0f,
+                   .maxDepth = 1.0f } );
+
+    // Every pixel is blended once, so the boxes are drawn one by one instead
+    // of the bounding box of the region.
+    for ( std::size_t set = 0; set < setsCount; ++set ) {
+        const auto first = static_cast< std::uint32_t >( set * mTexturesPerSet );
+        const auto count = std::min< std::uint32_t >(
+        mTexturesPerSet, static_cast< std::uint32_t >( mDrawn.size() ) - first );
+
+        commandBuffer.bindDescriptorSets( vk::PipelineBindPoint::eGraphics,
+                                          mPipelineLayout,
+                                          0,
+                                          slot.sets[ set ].set,
+                                          {} );
+        for ( auto && box : repaint.boxes() ) {
+            commandBuffer.setScissor( 0, rectOf( box ) );
+            if ( mInstanced ) {
+                commandBuffer.draw( quadVertices, count, 0, first );
+                ++mStats.draws;
+                continue;
+            }
+            for ( auto layer = first; layer < first + count; ++layer )
+                commandBuffer.draw( quadVertices, 1, 0, layer );
+            mStats.draws += count;
+        }
+    }
+}
+
+void Compositor::forget( vk::ImageView view ) {
+    for ( auto && slot : mSlots )
+        for ( auto && textureSet : slot.sets )
+            std::replace(
+            textureSet.views.begin(), textureSet.views.end(), view, vk::ImageView {} );
+}
+
+std::uint32_t Compositor::texturesPerSet() const { return mTexturesPerSet; }
+
+bool Compositor::instanced() const { return mInstanced; }
+
+const Compositor::Stats & Compositor::stats() const { return mStats; }
+
+vk::Pipeline Compositor::createPipeline( vk::RenderPass renderPass ) const {
+    const vk::SpecializationMapEntry texturesCount { .constantID = 0,
+                                                     .offset     = 0,
+                                                     .size = sizeof( mTexturesPerSet ) };
+    const vk::SpecializationInfo specialization { .mapEntryCount = 1,
+                                                  .pMapEntries   = &texturesCount,
+                                                  .dataSize = sizeof( mTexturesPerSet ),
+                                                  .pData    = &mTexturesPerSet };
+
+    const std::array< vk::PipelineShaderStageCreateInfo, 2 > stages {
+        vk::PipelineShaderStageCreateInfo { .stage  = vk::ShaderStageFlagBits::eVertex,
+                                            .module = mVertexShader,
+                                            .pName  = "main" },
+        vk::PipelineShaderStageCreateInfo { .stage  = vk::ShaderStageFlagBits::eFragment,
+                                            .module = mFragmentShader,
+                                            .pName  = "main",
+                                            .pSpecializationInfo = &specialization }
+    };
+
+    const vk::VertexInputBindingDescription instanceBinding {
+        .binding   = 0,
+        .stride    = sizeof( Instance ),
+        .inputRate = vk::VertexInputRate::eInstance
+    };
+    const std::array< vk::VertexInputAttributeDescription, 3 > attributes {
+        vk::VertexInputAttributeDescription { .location = 0,
+                                              .binding  = 0,
+                                              .format = vk::Format::eR32G32B32A32Sfloat,
+                                              .offset = offsetof( Instance, x ) },
+        vk::VertexInputAttributeDescription { .location = 1,
+                                              .binding  = 0,
+                                              .format   = vk::Format::eR32Sfloat,
+                                              .offset   = offsetof( Instance, opacity ) },
+        vk::VertexInputAttributeDescription { .location = 2,
+                                              .binding  = 0,
+                                              .format   = vk::Format::eR32Uint,
+                                              .offset   = offsetof( Instance, texture ) }
+    };
+    const vk::PipelineVertexInputStateCreateInfo vertexInput {
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions    = &instanceBinding,
+        .vertexAttributeDescriptionCount =
+        static_cast< std::uint32_t >( attributes.size() ),
+        .pVertexAttributeDescriptions = attributes.data()
+    };
+
+    const vk::PipelineInputAssemblyStateCreateInfo inputAssembly {
+        .topology = vk::PrimitiveTopology::eTriangleStrip
+    };
+    // Set per frame and per repaint box.
+    const vk::PipelineViewportStateCreateInfo viewport { .viewportCount = 1,
+                                                         .scissorCount  = 1 };
+    const std::array< vk::DynamicState, 2 > dynamicStates { vk::DynamicState::eViewport,
+                                                            vk::DynamicState::eScissor };
+    const vk::PipelineDynamicStateCreateInfo dynamic {
+        .dynamicStateCount = static_cast< std::uint32_t >( dynamicStates.size() ),
+        .pDynamicStates    = dynamicStates.data()
+    };
+    const vk::PipelineRasterizationStateCreateInfo rasterization {
+        .polygonMode = vk::PolygonMode::eFill,
+        .cullMode    = vk::CullModeFlagBits::eNone,
+        .frontFace   = vk::FrontFace::eCounterClockwise,
+        .lineWidth   = 1.0f
+    };
+    const vk::PipelineMultisampleStateCreateInfo multisample {
+        .rasterizationSamples = vk::SampleCountFlagBits::e1
+    };
+
+    // Premultiplied "over".
+    const vk::PipelineColorBlendAttachmentState blendAttachment {
+        .blendEnable         = VK_TRUE,
+        .srcColorBlendFactor = vk::BlendFactor::eOne,
+        .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+        .colorBlendOp        = vk::BlendOp::eAdd,
+        .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+        .dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+        .alphaBlendOp        = vk::BlendOp::eAdd,
+        .colorWriteMask      = vk::ColorComponentFlagBits::eR |
+                          vk::ColorComponentFlagBits::eG |
+                          vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA
+    };
+    const vk::PipelineColorBlendStateCreateInfo colorBlend {
+        .attachmentCount = 1, .pAttachments = &blendAttachment
+    };
+
+    const vk::GraphicsPipelineCreateInfo pipelineCI {
+        .stageCount          = static_cast< std::uint32_t >( stages.size() ),
+        .pStages             = stages.data(),
+        .pVertexInputState   = &vertexInput,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState      = &viewport,
+        .pRasterizationState = &rasterization,
+        .pMultisampleState   = &multisample,
+        .pColorBlendState    = &colorBlend,
+        .pDynamicState       = &dynamic,
+        .layout              = mPipelineLayout,
+        .renderPass          = renderPass,
+        .subpass             = 0
+    };
+    return mLogicDev.createGraphicsPipeline( mPipelineCache, pipelineCI ).value;
+}
+
+void Compositor::cull( const xcbwraper::Region & repaint, const LayersVec & layers ) {
+    // Top to bottom, a layer shows where no opaque layer above it covers the
+    // repaint region.
+    mDrawn.clear();
+    mCovered.clear();
+    for ( auto layer = layers.rbegin(); layer != layers.rend(); ++layer ) {
+        if ( !layer->view || layer->opacity <= 0.0f )
+            continue;
+
+        const auto box = xcbwraper::Region::boxOf( layer->geometry );
+        mVisible.reset( box );
+        mVisible.intersect( repaint );
+        mVisible.subtract( mCovered );
+        if ( mVisible.isEmpty() )
+            continue;
+
+        mDrawn.push_back( &*layer );
+        if ( layer->opaque && layer->opacity >= 1.0f )
+            mCovered.unite( box );
+    }
+    std::reverse( mDrawn.begin(), mDrawn.end() );
+}
+
+void Compositor::reserveInstances( Slot & slot, std::size_t count ) {
+    if ( count <= slot.capacity )
+        return;
+
+    if ( slot.capacity != 0 ) {
+        mLogicDev.destroyBuffer( slot.instances );
+        mAllocator.free( slot.memory );
+        slot.capacity = 0;
+    }
+
+    const auto capacity = std::bit_ceil( std::max( count, minInstances ) );
+    slot.instances      = mLogicDev.createBuffer(
+    vk::BufferCreateInfo { .size        = capacity * sizeof( Instance ),
+                           .usage       = vk::BufferUsageFlagBits::eVertexBuffer,
+                           .sharingMode = vk::SharingMode::eExclusive } );
+    try {
+        slot.memory = mAllocator.allocate( slot.instances,
+                                           vk::MemoryPropertyFlagBits::eHostVisible |
+                                           vk::MemoryPropertyFlagBits::eHostCoherent,
+                                           vk::MemoryPropertyFlagBits::eDeviceLocal );
+    } catch ( ... ) {
+        mLogicDev.destroyBuffer( slot.instances );
+        throw;
+    }
+    slot.capacity = capacity;
+}
+
+Compositor::TextureSet Compositor::createTextureSet() const {
+    const vk::DescriptorPoolSize poolSize { .type =
+                                            vk::DescriptorType::eCombinedImageSampler,
+                                            .descriptorCount = mTexturesPerSet };
+    TextureSet textureSet { .pool  = mLogicDev.createDescriptorPool(
+                            vk::DescriptorPoolCreateInfo { .maxSets       = 1,
+                                                           .poolSizeCount = 1,
+                                                           .pPoolSizes = &poolSize } ),
+                            .set   = nullptr,
+                            .views = std::vector< vk::ImageView >( mTexturesPerSet ) };
+    textureSet.set =
+    mLogicDev
+    .allocateDescriptorSets( vk::DescriptorSetAllocateInfo {
+    .descriptorPool     = textureSet.pool,
+    .descriptorSetCount = 1,
+    .pSetLayouts        = &mSetLayout } )
+    .front();
+    return textureSet;
+}
+
+void Compositor::updateTextureSets( Slot & slot, std::size_t setsCount ) {
+    // A stack that did not change writes nothing.
+    mImageInfos.clear();
+    mWrites.clear();
+    for ( std::size_t set = 0; set < setsCount; ++set ) {
+        auto &     textureSet = slot.sets[ set ];
+        const auto first      = set * mTexturesPerSet;
+        const auto count =
+        std::min< std::size_t >( mTexturesPerSet, mDrawn.size() - first );
+
+        for ( std::uint32_t element = 0; element < mTexturesPerSet; ++element ) {
+            // The elements past the last layer repeat the first view, every
+            // element of the array has to be valid.
+            const auto view = mDrawn[ first + ( element < count ? element : 0 ) ]->view;
+            if ( textureSet.views[ element ] == view )
+                continue;
+
+            textureSet.views[ element ] = view;
+            mImageInfos.push_back(
+            vk::DescriptorImageInfo { .imageView   = view,
+                                      .imageLayout =
+                                      vk::ImageLayout::eShaderReadOnlyOptimal } );
+            mWrites.push_back( vk::WriteDescriptorSet {
+            .dstSet          = textureSet.set,
+            .dstBinding      = 0,
+            .dstArrayElement = element,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eCombinedImageSampler } );
+        }
+    }
+    mStats.descriptorWrites = mWrites.size();
+    if ( mWrites.empty() )
+        return;
+
+    for ( std::size_t write = 0; write < mWrites.size(); ++write )
+        mWrites[ write ].pImageInfo = &mImageInfos[ write ];
+    mLogicDev.updateDescriptorSets( mWrites, {} );
+}
+
+}   // namespace core::renderer
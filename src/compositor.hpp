@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define VK_USE_PLATFORM_XCB_KHR
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+#include "gpuselector.hpp"
+#include "memoryallocator.hpp"
+#include "xcb_wraper/region.hpp"
+#include "xcb_wraper/windowgeometry.hpp"
+
+namespace core::renderer {
+
+// Draws a stack of textured layers, such as window captures, inside the
+// renderer's render pass. Every layer is one instance of a quad, and the
+// textures of up to texturesPerSet() layers sit in one descriptor set of a
+// sampler array, so a frame records one pipeline bind and, per repaint box,
+// one draw and one set bind per texturesPerSet() layers. Without non-uniform
+// indexing of sampler arrays every layer takes a draw of its own, the sets
+// stay shared, and without dynamic indexing every layer takes a set of its own
+// too. Layers under opaque ones or outside of the repaint region are skipped
+// before anything is recorded. Not thread safe.
+class Compositor final {
+public:
+    struct Layer final {
+        // Premultiplied alpha, readable by fragment shaders while the frame
+        // runs.
+        vk::ImageView view;
+        // Where the texture goes in the target, stretched to the size.
+        xcbwraper::WindowGeometry::Info geometry;
+        float                           opacity { 1.0f };
+        // No translucent pixels, the layer hides what is below it at opacity 1.
+        bool opaque { true };
+    };
+
+    using LayersVec = std::vector< Layer >;
+
+    struct CreateInfo final {
+        vk::Device        logicDev;
+        const GpuInfo *   gpu;
+        MemoryAllocator * allocator;
+        vk::RenderPass    renderPass;
+        // Null for none.
+        vk::PipelineCache pipelineCache;
+        std::size_t       framesInFlight;
+        // The device enabled shaderSampledImageArrayNonUniformIndexing.
+        bool nonUniformIndexing { false };
+    };
+
+    // Of the last record().
+    struct Stats final {
+        std::size_t layers { 0 };
+        // Hidden, transparent or outside of the repaint region.
+        std::size_t culledLayers { 0 };
+        std::size_t draws { 0 };
+        std::size_t descriptorSets { 0 };
+        // Array elements whose view changed since the set was used last.
+        std::size_t descriptorWrites { 0 };
+    };
+
+    static constexpr std::uint32_t maxTexturesPerSet = 256;
+
+    explicit Compositor( const CreateInfo & createInfo );
+    Compositor( const Compositor & ) = delete;
+    Compositor & operator=( const Compositor & ) = delete;
+    // The device must be done with the frames that used the compositor.
+    ~Compositor();
+
+    // Builds the pipeline for another render pass. Returns the previous
+    // pipeline, to destroy once the frames recorded with it are done.
+    [[nodiscard]] vk::Pipeline setRenderPass( vk::RenderPass renderPass );
+
+    // Inside the render pass, once per frame slot and frame: draws the layers,
+    // the bottom one first, into the repaint boxes of the target. The views
+    // must live until the frame is done.
+    void record( const vk::CommandBuffer & commandBuffer,
+                 std::size_t               frameSlot,
+                 vk::Extent2D              extent,
+                 const xcbwraper::Region & repaint,
+                 const LayersVec &         layers );
+
+    // Before a view that layers used is destroyed. The sets skip writing views
+    // they already refer to, and the driver may hand the handle out again.
+    void forget( vk::ImageView view );
+
+    [[nodiscard]] std::uint32_t texturesPerSet() const;
+    // True when one draw covers the layers of a set.
+    [[nodiscard]] bool          instanced() const;
+    [[nodiscard]] const Stats & stats() const;
+
+private:
+    // Vertex data of one layer.
+    struct Instance final {
+        float         x;
+        float         y;
+        float         width;
+        float         height;
+        float         opacity;
+        std::uint32_t texture;
+    };
+
+    struct TextureSet final {
+        vk::DescriptorPool pool;
+        vk::DescriptorSet  set;
+        // What every array element refers to now.
+        std::vector< vk::ImageView > views;
+    };
+
+    // What the frames of one slot use, reused once the slot's fence is waited.
+    struct Slot final {
+        std::vector< TextureSet >   sets;
+        vk::Buffer                  instances;
+        MemoryAllocator::Allocation memory {};
+        std::size_t                 capacity { 0 };
+    };
+
+    [[nodiscard]] vk::Pipeline createPipeline( vk::RenderPass renderPass ) const;
+    // Fills mDrawn with the layers that show in the repaint region.
+    void cull( const xcbwraper::Region & repaint, const LayersVec & layers );
+    void reserveInstances( Slot & slot, std::size_t count );
+    [[nodiscard]] TextureSet createTextureSet() const;
+    // Points the sets at the views of mDrawn, with one update call.
+    void updateTextureSets( Slot & slot, std::size_t setsCount );
+
+    vk::Device        mLogicDev;
+    MemoryAllocator & mAllocator;
+    vk::PipelineCache mPipelineCache;
+    std::uint32_t     mTexturesPerSet;
+    bool              mInstanced;
+
+    vk::Sampler             mSampler;
+    vk::DescriptorSetLayout mSetLayout;
+    vk::PipelineLayout      mPipelineLayout;
+    vk::ShaderModule        mVertexShader;
+    vk::ShaderModule        mFragmentShader;
+    vk::Pipeline            mPipeline;
+
+    std::vector< Slot > mSlots;
+    Stats               mStats;
+
+    // Scratch storage of record().
+    std::vector< const Layer * >           mDrawn;
+    std::vector< Instance >                mInstances;
+    xcbwraper::Region                      mCovered;
+    xcbwraper::Region                      mVisible;
+    std::vector< vk::DescriptorImageInfo > mImageInfos;
+    std::vector< vk::WriteDescriptorSet >  mWrites;
+};
+
+}   // namespace core::renderer
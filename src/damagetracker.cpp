@@ -0,0 +1,120 @@
+#include "damagetracker.hpp"
+#include "xcb_wraper/xcbconnect.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <xcb/damage.h>
+#include <xcb/xproto.h>
+
+namespace core::composite {
+
+namespace {
+using xcbwraper::Region;
+
+Region::Box boxOf( const xcb_rectangle_t & rectangle ) {
+    return Region::Box {
+        rectangle.x,
+        rectangle.y,
+        static_cast< Region::CoordType >( rectangle.x + rectangle.width ),
+        static_cast< Region::CoordType >( rectangle.y + rectangle.height )
+    };
+}
+}   // namespace
+
+DamageTracker::DamageTracker( xcb_connection_t * xcbConnect ) :
+mXcbConnect( xcbConnect ) {
+    assert( mXcbConnect != nullptr );
+
+    const auto * extension = xcb_get_extension_data( mXcbConnect, &xcb_damage_id );
+    if ( !extension || !extension->present )
+        throw std::runtime_error(
+        "DamageTracker::DamageTracker(): DAMAGE is not supported." );
+    mNotifyEvent = extension->first_event + XCB_DAMAGE_NOTIFY;
+
+    // The server rejects requests of a client that did not negotiate a version.
+    const xcbwraper::XCBReply< xcb_damage_query_version_reply_t > version {
+        xcb_damage_query_version_reply(
+        mXcbConnect, xcb_damage_query_version( mXcbConnect, 1, 1 ), nullptr )
+    };
+    if ( !version || ( version->major_version == 1 && version->minor_version < 1 ) )
+        throw std::runtime_error(
+        "DamageTracker::DamageTracker(): DAMAGE 1.1 is not supported." );
+}
+
+DamageTracker::~DamageTracker() {
+    for ( auto && [ id, window ] : mWindows )
+        xcb_damage_destroy( mXcbConnect, window.damage );
+    xcb_flush( mXcbConnect );
+}
+
+void DamageTracker::track( xcb_window_t window ) {
+    if ( mWindows.contains( window ) )
+        return;
+
+    const auto damage = xcb_generate_id( mXcbConnect );
+    xcb_damage_create(
+    mXcbConnect, damage, window, XCB_DAMAGE_REPORT_LEVEL_DELTA_RECTANGLES );
+    mWindows.emplace( window, Window { .damage = damage } );
+}
+
+void DamageTracker::untrack( xcb_window_t window ) {
+    const auto tracked = mWindows.find( window );
+    if ( tracked == mWindows.end() )
+        return;
+
+    xcb_damage_destroy( mXcbConnect, tracked->second.damage );
+    mWindows.erase( tracked );
+    std::erase( mDamaged, window );
+}
+
+bool DamageTracker::handleEvent( const xcb_generic_event_t & event ) {
+    const auto type = event.response_type & ~0x80;
+    if ( type == XCB_DESTROY_NOTIFY ) {
+        const auto & destroyed =
+        reinterpret_cast< const xcb_destroy_notify_event_t & >( event );
+        if ( mWindows.erase( destroyed.window ) )
+            std::erase( mDamaged, destroyed.window );
+        return false;
+    }
+    if ( type != mNotifyEvent )
+        return false;
+
+    const auto & notify = reinterpret_cast< const xcb_damage_notify_event_t & >( event );
+    const auto   tracked = mWindows.find( notify.drawable );
+    if ( tracked == mWindows.end() || tracked->second.damage != notify.damage )
+        return false;
+
+    const auto box = boxOf( notify.area );
+    if ( box.isEmpty() )
+        return false;
+    auto & region = tracked->second.region;
+    if ( region.isEmpty() )
+        mDamaged.push_back( notify.drawable );
+    region.unite( box );
+    return true;
+}
+
+const DamageTracker::WindowsVec & DamageTracker::damaged() const { return mDamaged; }
+
+const xcbwraper::Region * DamageTracker::damage( xcb_window_t window ) const {
+    const auto tracked = mWindows.find( window );
+    return tracked == mWindows.end() ? nullptr : &tracked->second.region;
+}
+
+void DamageTracker::clear() {
+    if ( mDamaged.empty() )
+        return;
+
+    for ( auto id : mDamaged ) {
+        auto & window = mWindows.at( id );
+        xcb_damage_subtract( mXcbConnect, window.damage, XCB_NONE, XCB_NONE );
+        window.region.clear();
+    }
+    mDamaged.clear();
+    xcb_flush( mXcbConnect );
+}
+
+std::size_t DamageTracker::size() const { return mWindows.size(); }
+
+}   // namespace core::composite
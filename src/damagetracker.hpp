@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <xcb/damage.h>
+#include <xcb/xcb.h>
+
+#include "xcb_wraper/region.hpp"
+
+namespace core::composite {
+
+// Collects what the X server reports as drawn into the tracked windows, so a
+// compositor re-uploads and redraws only that. Every window gets a damage
+// object reporting delta rectangles: the server sends an event whenever the
+// window's damage grows, and clear() subtracts it all again without a round
+// trip. A drawing that happens while its window is already damaged arrives
+// after the clear() as a new event, so nothing is lost between frames.
+class DamageTracker final {
+public:
+    using WindowsVec = std::vector< xcb_window_t >;
+
+    // The connection is borrowed and must outlive the object. Throws when the
+    // server has no DAMAGE 1.1.
+    explicit DamageTracker( xcb_connection_t * xcbConnect );
+    DamageTracker( const DamageTracker & ) = delete;
+    DamageTracker & operator=( const DamageTracker & ) = delete;
+    ~DamageTracker();
+
+    void track( xcb_window_t window );
+    void untrack( xcb_window_t window );
+
+    // Accumulates DamageNotify events, and forgets windows on DestroyNotify,
+    // the server drops their damage objects itself. Returns true when the
+    // event damaged a tracked window.
+    bool handleEvent( const xcb_generic_event_t & event );
+
+    // Windows damaged since the last clear(), in the order of their first
+    // damage.
+    [[nodiscard]] const WindowsVec & damaged() const;
+    // In window coordinates, the origin is inside the border. Null when the
+    // window is not tracked.
+    [[nodiscard]] const xcbwraper::Region * damage( xcb_window_t window ) const;
+    // Empties the damage of every window, here and on the server.
+    void clear();
+
+    [[nodiscard]] std::size_t size() const;
+
+private:
+    struct Window final {
+        xcb_damage_damage_t damage;
+        xcbwraper::Region   region {};
+    };
+
+    using WindowsMap = std::unordered_map< xcb_window_t, Window >;
+
+    xcb_connection_t * mXcbConnect;
+    std::uint8_t       mNotifyEvent;
+
+    WindowsMap mWindows;
+    WindowsVec mDamaged;
+};
+
+}   // namespace core::composite
@@ -0,0 +1,177 @@
+#include "frametimer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace core::renderer {
+
+namespace {
+using Us = std::chrono::duration< double, std::micro >;
+
+constexpr std::array< FrameTimer::Phase, FrameTimer::phasesCount > allPhases {
+    FrameTimer::Phase::eAcquire,
+    FrameTimer::Phase::eRecord,
+    FrameTimer::Phase::eSubmit,
+    FrameTimer::Phase::ePresent,
+    FrameTimer::Phase::eGpu
+};
+
+// Nearest rank percentile of the values, reorders them.
+std::chrono::nanoseconds percentileOf( std::vector< std::chrono::nanoseconds > & values,
+                                       double                                   rank ) {
+    const auto index = static_cast< std::size_t >(
+    std::ceil( rank * static_cast< double >( values.size() ) ) );
+    const auto nth = values.begin() + static_cast< std::ptrdiff_t >(
+                     std::clamp< std::size_t >( index, 1, values.size() ) - 1 );
+    std::nth_element( values.begin(), nth, values.end() );
+    return *nth;
+}
+}   // namespace
+
+FrameTimer::FrameTimer( std::size_t windowSize ) : mWindowSize( windowSize ) {
+    if ( mWindowSize == 0 )
+        throw std::runtime_error(
+        "FrameTimer::FrameTimer(): windowSize must be non-zero." );
+    mSamples.reserve( mWindowSize );
+    mScratch.reserve( mWindowSize );
+}
+
+void FrameTimer::add( const Sample & sample ) {
+    if ( mSamples.size() < mWindowSize )
+        mSamples.push_back( sample );
+    else
+        mSamples[ mNext ] = sample;
+    mNext = ( mNext + 1 ) % mWindowSize;
+    ++mFramesCount;
+}
+
+void FrameTimer::clear() {
+    mSamples.clear();
+    mNext        = 0;
+    mFramesCount = 0;
+    mCounters    = {};
+}
+
+FrameTimer::Percentiles FrameTimer::percentiles( Phase phase ) const {
+    mScratch.clear();
+    for ( auto && sample : mSamples )
+        if ( phase != Phase::eGpu || sample.hasGpu )
+            mScratch.push_back( sample[ phase ].duration );
+
+    return scratchPercentiles();
+}
+
+FrameTimer::Percentiles FrameTimer::cpuPercentiles() const {
+    mScratch.clear();
+    for ( auto && sample : mSamples ) {
+        std::chrono::nanoseconds cpuTime { 0 };
+        for ( auto phase : allPhases )
+            if ( phase != Phase::eGpu )
+                cpuTime += sample[ phase ].duration;
+        mScratch.push_back( cpuTime );
+    }
+
+    return scratchPercentiles();
+}
+
+FrameTimer::Percentiles FrameTimer::scratchPercentiles() const {
+    if ( mScratch.empty() )
+        return {};
+    // Each call reorders the scratch further, the ranks stay correct.
+    return Percentiles { .p50 = percentileOf( mScratch, 0.50 ),
+                         .p95 = percentileOf( mScratch, 0.95 ),
+                         .p99 = percentileOf( mScratch, 0.99 ) };
+}
+
+std::vector< FrameTimer::Sample > FrameTimer::samples() const {
+    if ( mSamples.size() < mWindowSize )
+        return mSamples;
+
+    std::vector< Sample > ordered;
+    ordered.reserve( mSamples.size() );
+    ordered.insert( ordered.end(),
+                    mSamples.begin() + static_cast< std::ptrdiff_t >( mNext ),
+                    mSamples.end() );
+    ordered.insert( ordered.end(),
+                    mSamples.begin(),
+                    mSamples.begin() + static_cast< std::ptrdiff_t >( mNext ) );
+    return ordered;
+}
+
+std::uint64_t FrameTimer::framesCount() const { return mFramesCount; }
+
+FrameTimer::Counters & FrameTimer::counters() { return mCounters; }
+
+const FrameTimer::Counters & FrameTimer::counters() const { return mCounters; }
+
+void FrameTimer::writeCsv( std::ostream & out ) const {
+    out << "frame";
+    for ( auto phase : allPhases )
+        out << ',' << nameOf( phase ) << "_us";
+    out << '\n';
+
+    for ( auto && sample : samples() ) {
+        out << sample.frame;
+        for ( auto phase : allPhases ) {
+            out << ',';
+            // An empty cell tells a missing GPU time apart from a zero one.
+            if ( phase != Phase::eGpu || sample.hasGpu )
+                out << Us( sample[ phase ].duration ).count();
+        }
+        out << '\n';
+    }
+}
+
+void FrameTimer::writeChromeTrace( std::ostream & out ) const {
+    const auto ordered = samples();
+    const auto origin  = ordered.empty() ? Clock::time_point {}
+                                         : ordered.front()[ Phase::eAcquire ].begin;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for ( auto && sample : ordered )
+        for ( auto phase : allPhases ) {
+            if ( phase == Phase::eGpu && !sample.hasGpu )
+                continue;
+
+            const auto & span = sample[ phase ];
+            out << ( first ? "" : "," ) << "\n{\"name\":\"" << nameOf( phase )
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << ( phase == Phase::eGpu ? 2 : 1 )
+                << ",\"ts\":" << Us( span.begin - origin ).count()
+                << ",\"dur\":" << Us( span.duration ).count()
+                << ",\"args\":{\"frame\":" << sample.frame << "}}";
+            first = false;
+        }
+    out << "\n]}\n";
+}
+
+void FrameTimer::dump( const std::filesystem::path & path, DumpFormat format ) const {
+    std::ofstream out( path );
+    if ( !out )
+        throw std::runtime_error( "FrameTimer::dump(): cann't open " + path.string() );
+
+    switch ( format ) {
+    case DumpFormat::eCsv: writeCsv( out ); break;
+    case DumpFormat::eChromeTrace: writeChromeTrace( out ); break;
+    }
+
+    if ( !out.flush() )
+        throw std::runtime_error( "FrameTimer::dump(): cann't write " + path.string() );
+}
+
+std::string_view FrameTimer::nameOf( Phase phase ) {
+    switch ( phase ) {
+    case Phase::eAcquire: return "acquire";
+    case Phase::eRecord: return "record";
+    case Phase::eSubmit: return "submit";
+    case Phase::ePresent: return "present";
+    case Phase::eGpu: return "gpu";
+    }
+    return "unknown";
+}
+
+}   // namespace core::renderer
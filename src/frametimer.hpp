@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace core::renderer {
+
+// Keeps the phase timings of the last frames and the percentiles over them.
+// The renderer adds one sample per presented frame once its GPU work is done,
+// so the newest sample lags the presented frame by up to framesInFlight.
+class FrameTimer final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Phase : std::size_t { eAcquire, eRecord, eSubmit, ePresent, eGpu };
+    static constexpr std::size_t phasesCount = 5;
+
+    enum class DumpFormat { eCsv, eChromeTrace };
+
+    struct Span final {
+        Clock::time_point        begin {};
+        std::chrono::nanoseconds duration { 0 };
+    };
+
+    struct Sample final {
+        std::uint64_t                   frame { 0 };
+        std::array< Span, phasesCount > spans {};
+        // The GPU span is missing without timestamp support. Its begin is the
+        // submit time, GPU and CPU clocks are not correlated.
+        bool hasGpu { false };
+
+        Span &       operator[]( Phase phase ) { return spans[ indexOf( phase ) ]; }
+        const Span & operator[]( Phase phase ) const { return spans[ indexOf( phase ) ]; }
+    };
+
+    struct Percentiles final {
+        std::chrono::nanoseconds p50 { 0 };
+        std::chrono::nanoseconds p95 { 0 };
+        std::chrono::nanoseconds p99 { 0 };
+    };
+
+    // Events that are not per frame timings, but explain outliers.
+    struct Counters final {
+        std::uint64_t outOfDate { 0 };
+        std::uint64_t suboptimal { 0 };
+        std::uint64_t swapchainRecreations { 0 };
+    };
+
+    explicit FrameTimer( std::size_t windowSize = 1024 );
+
+    void add( const Sample & sample );
+    void clear();
+
+    // Over the samples in the window, zero when there are none.
+    [[nodiscard]] Percentiles percentiles( Phase phase ) const;
+    // Of the CPU time of whole frames, the sum of the CPU phases.
+    [[nodiscard]] Percentiles cpuPercentiles() const;
+    // The window, oldest sample first.
+    [[nodiscard]] std::vector< Sample > samples() const;
+    [[nodiscard]] std::uint64_t         framesCount() const;
+
+    [[nodiscard]] Counters &       counters();
+    [[nodiscard]] const Counters & counters() const;
+
+    void writeCsv( std::ostream & out ) const;
+    // Chrome trace event format, loads in chrome://tracing and Perfetto.
+    void writeChromeTrace( std::ostream & out ) const;
+    // Writes the window to the file, throws when the file cannot be written.
+    void dump( const std::filesystem::path & path, DumpFormat format ) const;
+
+    [[nodiscard]] static std::string_view nameOf( Phase phase );
+    [[nodiscard]] static constexpr std::size_t indexOf( Phase phase ) {
+        return static_cast< std::size_t >( phase );
+    }
+
+private:
+    [[nodiscard]] Percentiles scratchPercentiles() const;
+
+    std::vector< Sample > mSamples;
+    std::size_t           mWindowSize;
+    std::size_t           mNext { 0 };
+    std::uint64_t         mFramesCount { 0 };
+    Counters              mCounters;
+
+    mutable std::vector< std::chrono::nanoseconds > mScratch;
+};
+
+}   // namespace core::renderer
@@ -0,0 +1,159 @@
+#include "gpuselector.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <stdexcept>
+#include <system_error>
+
+namespace core::renderer {
+
+namespace {
+constexpr vk::DeviceSize gibibyte = vk::DeviceSize { 1 } << 30;
+
+std::int64_t typeScore( vk::PhysicalDeviceType type ) {
+    switch ( type ) {
+    case vk::PhysicalDeviceType::eDiscreteGpu: return 4000;
+    case vk::PhysicalDeviceType::eIntegratedGpu: return 3000;
+    case vk::PhysicalDeviceType::eVirtualGpu: return 2000;
+    case vk::PhysicalDeviceType::eCpu: return 1000;
+    default: return 0;
+    }
+}
+
+// The first family with the flags of want and none of the flags of without.
+std::optional< std::uint32_t > findFamily( const GpuInfo::QueueFamiliesVec & families,
+                                           vk::QueueFlags                     want,
+                                           vk::QueueFlags                     without ) {
+    for ( std::uint32_t family = 0; family < families.size(); ++family )
+        if ( ( families[ family ].queueFlags & want ) == want &&
+             !( families[ family ].queueFlags & without ) )
+            return family;
+    return std::nullopt;
+}
+}   // namespace
+
+GpuInfo GpuInfo::query( const vk::PhysicalDevice & device, std::uint32_t index ) {
+    return GpuInfo { .device        = device,
+                     .index         = index,
+                     .properties    = device.getProperties(),
+                     .memory        = device.getMemoryProperties(),
+                     .queueFamilies = device.getQueueFamilyProperties(),
+                     .extensions    = device.enumerateDeviceExtensionProperties() };
+}
+
+bool GpuInfo::hasExtension( std::string_view name ) const {
+    return std::any_of( extensions.begin(),
+                        extensions.end(),
+                        [ name ]( const vk::ExtensionProperties & extension ) {
+                            return name == extension.extensionName.data();
+                        } );
+}
+
+vk::DeviceSize GpuInfo::deviceLocalMemory() const {
+    vk::DeviceSize size = 0;
+    for ( std::uint32_t i = 0; i < memory.memoryHeapCount; ++i )
+        if ( memory.memoryHeaps[ i ].flags & vk::MemoryHeapFlagBits::eDeviceLocal )
+            size += memory.memoryHeaps[ i ].size;
+    return size;
+}
+
+std::optional< std::uint32_t >
+GpuInfo::graphicsFamily( const vk::SurfaceKHR & surface ) const {
+    for ( std::uint32_t family = 0; family < queueFamilies.size(); ++family )
+        if ( queueFamilies[ family ].queueFlags & vk::QueueFlagBits::eGraphics &&
+             ( !surface || device.getSurfaceSupportKHR( family, surface ) ) )
+            return family;
+    return std::nullopt;
+}
+
+std::optional< std::uint32_t > GpuInfo::transferFamily() const {
+    return findFamily( queueFamilies,
+                       vk::QueueFlagBits::eTransfer,
+                       vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute );
+}
+
+std::optional< std::uint32_t > GpuInfo::computeFamily() const {
+    return findFamily(
+    queueFamilies, vk::QueueFlagBits::eCompute, vk::QueueFlagBits::eGraphics );
+}
+
+std::string_view GpuInfo::name() const { return properties.deviceName.data(); }
+
+GpuSelector::GpuSelector( const vk::Instance & instance ) {
+    const auto devices = instance.enumeratePhysicalDevices();
+    for ( std::uint32_t i = 0; i < devices.size(); ++i )
+        mGpus.push_back( GpuInfo::query( devices[ i ], i ) );
+}
+
+const std::vector< GpuInfo > & GpuSelector::gpus() const { return mGpus; }
+
+const GpuInfo & GpuSelector::select( const Requirements & requirements ) const {
+    std::string_view preferred = requirements.preferred;
+    if ( preferred.empty() )
+        if ( const char * variable = std::getenv( overrideVariable.data() ) )
+            preferred = variable;
+
+    if ( !preferred.empty() ) {
+        const auto * gpu = findPreferred( preferred );
+        if ( !gpu )
+            throw std::runtime_error( "GpuSelector::select(): no GPU matches " +
+                                      std::string( preferred ) + "." );
+        if ( score( *gpu, requirements ) < 0 )
+            throw std::runtime_error( "GpuSelector::select(): " +
+                                      std::string( gpu->name() ) +
+                                      " lacks a required capability." );
+        return *gpu;
+    }
+
+    const GpuInfo * best      = nullptr;
+    std::int64_t    bestScore = -1;
+    for ( auto && gpu : mGpus )
+        // Ties keep the first enumerated device.
+        if ( const auto gpuScore = score( gpu, requirements ); gpuScore > bestScore ) {
+            best      = &gpu;
+            bestScore = gpuScore;
+        }
+
+    if ( !best )
+        throw std::runtime_error( "GpuSelector::select(): no GPU qualifies." );
+    return *best;
+}
+
+std::int64_t GpuSelector::score( const GpuInfo &      gpu,
+                                const Requirements & requirements ) {
+    if ( !gpu.graphicsFamily( requirements.surface ) )
+        return -1;
+    for ( auto && extension : requirements.extensions )
+        if ( !gpu.hasExtension( extension ) )
+            return -1;
+
+    std::int64_t score = typeScore( gpu.properties.deviceType );
+    // Up to 640, less than a step between two device types.
+    score += static_cast< std::int64_t >(
+             std::min< vk::DeviceSize >( gpu.deviceLocalMemory() / gibibyte, 64 ) ) *
+             10;
+
+    // Queues that can run uploads and compute next to the graphics work.
+    if ( gpu.transferFamily() )
+        score += 100;
+    if ( gpu.computeFamily() )
+        score += 100;
+    return score;
+}
+
+const GpuInfo * GpuSelector::findPreferred( std::string_view preferred ) const {
+    std::uint32_t index = 0;
+    const auto [ end, error ] =
+    std::from_chars( preferred.data(), preferred.data() + preferred.size(), index );
+    if ( error == std::errc {} && end == preferred.data() + preferred.size() )
+        return index < mGpus.size() ? &mGpus[ index ] : nullptr;
+
+    const auto gpu =
+    std::find_if( mGpus.begin(), mGpus.end(), [ preferred ]( const GpuInfo & gpu ) {
+        return gpu.name().find( preferred ) != std::string_view::npos;
+    } );
+    return gpu != mGpus.end() ? &*gpu : nullptr;
+}
+
+}   // namespace core::renderer
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define VK_USE_PLATFORM_XCB_KHR
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+namespace core::renderer {
+
+// What the renderer needs to know about a physical device, queried once.
+struct GpuInfo final {
+    using QueueFamiliesVec = std::vector< vk::QueueFamilyProperties >;
+    using ExtensionsVec    = std::vector< vk::ExtensionProperties >;
+
+    vk::PhysicalDevice                 device;
+    std::uint32_t                      index { 0 };
+    vk::PhysicalDeviceProperties       properties;
+    vk::PhysicalDeviceMemoryProperties memory;
+    QueueFamiliesVec                   queueFamilies;
+    ExtensionsVec                      extensions;
+
+    [[nodiscard]] static GpuInfo query( const vk::PhysicalDevice & device,
+                                        std::uint32_t              index = 0 );
+
+    [[nodiscard]] bool           hasExtension( std::string_view name ) const;
+    [[nodiscard]] vk::DeviceSize deviceLocalMemory() const;
+    // The first graphics family that can present to the surface, or the first
+    // graphics family without a surface.
+    [[nodiscard]] std::optional< std::uint32_t >
+    graphicsFamily( const vk::SurfaceKHR & surface = nullptr ) const;
+    // Families that run next to the graphics family: transfer without graphics
+    // and compute, and compute without graphics.
+    [[nodiscard]] std::optional< std::uint32_t > transferFamily() const;
+    [[nodiscard]] std::optional< std::uint32_t > computeFamily() const;
+    [[nodiscard]] std::string_view name() const;
+};
+
+// Picks the device to render on. Every device gets a score from its type, its
+// device local memory, its queue families and its present support; devices
+// missing a required extension, a graphics queue or present support for the
+// surface are never picked. The choice can be forced by index or by a part of
+// the device name, from Requirements::preferred or else from the VULKAN_XCB_GPU
+// environment variable.
+class GpuSelector final {
+public:
+    static constexpr std::string_view overrideVariable = "VULKAN_XCB_GPU";
+
+    struct Requirements final {
+        std::vector< std::string_view > extensions;
+        // Null when no present support is needed.
+        vk::SurfaceKHR surface;
+        // Index or name part, empty to use the environment.
+        std::string preferred;
+    };
+
+    // Enumerates the devices and queries them, once for the selector's life.
+    explicit GpuSelector( const vk::Instance & instance );
+
+    [[nodiscard]] const std::vector< GpuInfo > & gpus() const;
+
+    // Throws when no device qualifies or the override matches none.
+    [[nodiscard]] const GpuInfo & select( const Requirements & requirements ) const;
+
+    // Negative for devices that do not qualify.
+    [[nodiscard]] static std::int64_t score( const GpuInfo &      gpu,
+                                             const Requirements & requirements );
+
+private:
+    [[nodiscard]] const GpuInfo * findPreferred( std::string_view preferred ) const;
+
+    std::vector< GpuInfo > mGpus;
+};
+
+}   // namespace core::renderer
@@ -0,0 +1,306 @@
+#include "memoryallocator.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace core::renderer {
+
+namespace {
+[[nodiscard]] vk::DeviceSize alignUp( vk::DeviceSize value, vk::DeviceSize alignment ) {
+    return alignment > 1 ? ( value + alignment - 1 ) / alignment * alignment : value;
+}
+
+[[nodiscard]] std::uint32_t orderOf( vk::DeviceSize rangeSize ) {
+    return static_cast< std::uint32_t >(
+    std::countr_zero( rangeSize / MemoryAllocator::minRange ) );
+}
+}   // namespace
+
+MemoryAllocator::MemoryAllocator( const CreateInfo & createInfo ) :
+mLogicDev( createInfo.logicDev ), mMemory( createInfo.memory ),
+mMaxAllocations( createInfo.maxAllocations ), mBlockSize( createInfo.blockSize ) {
+    if ( !std::has_single_bit( mBlockSize ) || mBlockSize < minRange )
+        throw std::runtime_error( "MemoryAllocator::MemoryAllocator(): blockSize must "
+                                  "be a power of two of at least minRange." );
+    mTopOrder = orderOf( mBlockSize );
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    for ( auto && pool : mPools )
+        for ( auto && block : pool.blocks )
+            if ( block.memory )
+                mLogicDev.freeMemory( block.memory );
+    for ( auto && memory : mDedicated )
+        mLogicDev.freeMemory( memory );
+}
+
+MemoryAllocator::Allocation MemoryAllocator::allocate( const Request & request ) {
+    const auto & requirements = request.requirements;
+    const auto   type =
+    memoryType( requirements.memoryTypeBits, request.required, request.preferred );
+
+    const auto rangeSize =
+    std::bit_ceil( std::max( { requirements.size, requirements.alignment, minRange } ) );
+
+    if ( rangeSize > mBlockSize ) {
+        Allocation allocation { .size       = requirements.size,
+                                .memoryType = type,
+                                .dedicated  = true };
+        allocation.memory = allocateMemory( type, requirements.size, allocation.mapped );
+        mDedicated.push_back( allocation.memory );
+        mDedicatedBytes += requirements.size;
+        ++mAllocations;
+        mUsedBytes += requirements.size;
+        mRequestedBytes += requirements.size;
+        return allocation;
+    }
+
+    const auto poolIndex = poolOf( type, request.kind );
+    auto &     blocks    = mPools.at( poolIndex ).blocks;
+    const auto order     = orderOf( rangeSize );
+
+    auto take = [ & ]( std::uint32_t blockIndex, vk::DeviceSize offset ) {
+        auto & block = blocks.at( blockIndex );
+        ++block.allocations;
+        ++mAllocations;
+        mUsedBytes += rangeSize;
+        mRequestedBytes += requirements.size;
+        return Allocation { .memory     = block.memory,
+                            .offset     = offset,
+                            .size       = requirements.size,
+                            .mapped     = block.mapped ? block.mapped + offset : nullptr,
+                            .memoryType = type,
+                            .pool       = poolIndex,
+                            .block      = blockIndex,
+                            .order      = order };
+    };
+
+    for ( std::uint32_t i = 0; i < blocks.size(); ++i )
+        if ( blocks[ i ].memory )
+            if ( const auto offset = takeRange( blocks[ i ], order ) )
+                return take( i, *offset );
+
+    Block block;
+    block.memory = allocateMemory( type, mBlockSize, block.mapped );
+    block.freeRanges.resize( mTopOrder + 1 );
+    block.freeRanges.at( mTopOrder ).insert( 0 );
+
+    // A slot emptied by trim(), else a new one.
+    const auto freeSlot = std::find_if(
+    blocks.begin(), blocks.end(), []( const Block & slot ) { return !slot.memory; } );
+    const auto blockIndex = static_cast< std::uint32_t >( freeSlot - blocks.begin() );
+    if ( freeSlot == blocks.end() )
+        blocks.push_back( std::move( block ) );
+    else
+        *freeSlot = std::move( block );
+
+    return take( blockIndex, *takeRange( blocks.at( blockIndex ), order ) );
+}
+
+void MemoryAllocator::free( const Allocation & allocation ) {
+    --mAllocations;
+    mRequestedBytes -= allocation.size;
+
+    if ( allocation.dedicated ) {
+        std::erase( mDedicated, allocation.memory );
+        mDedicatedBytes -= allocation.size;
+        mUsedBytes -= allocation.size;
+        freeMemory( allocation.memory );
+        return;
+    }
+
+    auto & block = mPools.at( allocation.pool ).blocks.at( allocation.block );
+    --block.allocations;
+    mUsedBytes -= minRange << allocation.order;
+
+    // Merges with the free buddy as long as there is one.
+    auto offset = allocation.offset;
+    auto order  = allocation.order;
+    for ( ; order < mTopOrder; ++order ) {
+        const auto buddy = offset ^ ( minRange << order );
+        if ( block.freeRanges.at( order ).erase( buddy ) == 0 )
+            break;
+        offset = std::min( offset, buddy );
+    }
+    block.freeRanges.at( order ).insert( offset );
+}
+
+MemoryAllocator::Allocation
+MemoryAllocator::allocate( const vk::Buffer &      buffer,
+                           vk::MemoryPropertyFlags required,
+                           vk::MemoryPropertyFlags preferred ) {
+    const auto allocation =
+    allocate( Request { .requirements = mLogicDev.getBufferMemoryRequirements( buffer ),
+                        .required     = required,
+                        .preferred    = preferred,
+                        .kind         = Kind::eBuffer } );
+    mLogicDev.bindBufferMemory( buffer, allocation.memory, allocation.offset );
+    return allocation;
+}
+
+MemoryAllocator::Allocation
+MemoryAllocator::allocate( const vk::Image &       image,
+                           vk::MemoryPropertyFlags required,
+                           vk::MemoryPropertyFlags preferred ) {
+    const auto allocation =
+    allocate( Request { .requirements = mLogicDev.getImageMemoryRequirements( image ),
+                        .required     = required,
+                        .preferred    = preferred,
+                        .kind         = Kind::eImage } );
+    mLogicDev.bindImageMemory( image, allocation.memory, allocation.offset );
+    return allocation;
+}
+
+void MemoryAllocator::trim() {
+    // The slots stay, so the blocks of live allocations keep their indices.
+    for ( auto && pool : mPools )
+        for ( auto && block : pool.blocks )
+            if ( block.memory && block.allocations == 0 ) {
+                freeMemory( block.memory );
+                block = Block {};
+            }
+}
+
+MemoryAllocator::Stats MemoryAllocator::stats() const {
+    Stats          stats { .dedicatedAllocations = mDedicated.size(),
+                           .allocations          = mAllocations,
+                           .reservedBytes        = mDedicatedBytes,
+                           .usedBytes            = mUsedBytes,
+                           .requestedBytes       = mRequestedBytes };
+    vk::DeviceSize freeBytes = 0;
+    for ( auto && pool : mPools )
+        for ( auto && block : pool.blocks ) {
+            if ( !block.memory )
+                continue;
+            ++stats.blocks;
+            stats.reservedBytes += mBlockSize;
+            for ( std::uint32_t order = 0; order <= mTopOrder; ++order ) {
+                const auto & ranges = block.freeRanges.at( order );
+                if ( ranges.empty() )
+                    continue;
+                freeBytes += ranges.size() * ( minRange << order );
+                stats.largestFreeRange =
+                std::max( stats.largestFreeRange, minRange << order );
+            }
+        }
+
+    if ( freeBytes != 0 )
+        stats.fragmentation = 1.0 - static_cast< double >( stats.largestFreeRange ) /
+                                    static_cast< double >( freeBytes );
+    return stats;
+}
+
+std::uint32_t MemoryAllocator::memoryType( std::uint32_t           typeBits,
+                                           vk::MemoryPropertyFlags required,
+                                           vk::MemoryPropertyFlags preferred ) const {
+    for ( const auto flags : { required | preferred, required } )
+        for ( std::uint32_t type = 0; type < mMemory.memoryTypeCount; ++type )
+            if ( typeBits & ( std::uint32_t { 1 } << type ) &&
+                 ( mMemory.memoryTypes[ type ].propertyFlags & flags ) == flags )
+                return type;
+
+    throw std::runtime_error( "MemoryAllocator::memoryType(): No memory type with " +
+                              vk::to_string( required ) + "." );
+}
+
+const vk::Device & MemoryAllocator::device() const { return mLogicDev; }
+
+std::uint32_t MemoryAllocator::poolOf( std::uint32_t memoryType, Kind kind ) {
+    const auto pool =
+    std::find_if( mPools.begin(), mPools.end(), [ & ]( const Pool & pool ) {
+        return pool.memoryType == memoryType && pool.kind == kind;
+    } );
+    if ( pool != mPools.end() )
+        return static_cast< std::uint32_t >( pool - mPools.begin() );
+
+    mPools.push_back( Pool { .memoryType = memoryType, .kind = kind, .blocks = {} } );
+    return static_cast< std::uint32_t >( mPools.size() - 1 );
+}
+
+// Splits the smallest free range of at least the order down to the order.
+std::optional< vk::DeviceSize > MemoryAllocator::takeRange( Block &       block,
+                                                            std::uint32_t order ) {
+    for ( auto found = order; found <= mTopOrder; ++found ) {
+        auto & ranges = block.freeRanges.at( found );
+        if ( ranges.empty() )
+            continue;
+
+        const auto offset = *ranges.begin();
+        ranges.erase( ranges.begin() );
+        // The upper halves stay free.
+        while ( found > order ) {
+            --found;
+            block.freeRanges.at( found ).insert( offset + ( minRange << found ) );
+        }
+        return offset;
+    }
+    return std::nullopt;
+}
+
+vk::DeviceMemory MemoryAllocator::allocateMemory( std::uint32_t  memoryType,
+                                                  vk::DeviceSize size,
+                                                  std::byte *&   mapped ) {
+    if ( mDeviceAllocations >= mMaxAllocations )
+        throw std::runtime_error(
+        "MemoryAllocator::allocateMemory(): maxMemoryAllocationCount reached." );
+
+    const auto memory = mLogicDev.allocateMemory(
+    vk::MemoryAllocateInfo { .allocationSize = size, .memoryTypeIndex = memoryType } );
+    ++mDeviceAllocations;
+
+    mapped = nullptr;
+    if ( mMemory.memoryTypes[ memoryType ].propertyFlags &
+         vk::MemoryPropertyFlagBits::eHostVisible )
+        mapped = static_cast< std::byte * >(
+        mLogicDev.mapMemory( memory, 0, VK_WHOLE_SIZE ) );
+    return memory;
+}
+
+// Freeing unmaps the memory too.
+void MemoryAllocator::freeMemory( vk::DeviceMemory memory ) {
+    mLogicDev.freeMemory( memory );
+    --mDeviceAllocations;
+}
+
+LinearArena::LinearArena( MemoryAllocator & allocator, const CreateInfo & createInfo ) :
+mAllocator( allocator ),
+mBlock( allocator.allocate( MemoryAllocator::Request {
+.requirements = vk::MemoryRequirements { .size           = createInfo.size,
+                                         .alignment      = MemoryAllocator::minRange,
+                                         .memoryTypeBits = createInfo.memoryTypeBits },
+.required     = createInfo.required,
+.preferred    = createInfo.preferred } ) ) {}
+
+LinearArena::~LinearArena() { mAllocator.free( mBlock ); }
+
+std::optional< MemoryAllocator::Allocation >
+LinearArena::allocate( const vk::MemoryRequirements & requirements ) {
+    if ( !( requirements.memoryTypeBits & ( std::uint32_t { 1 } << mBlock.memoryType ) ) )
+        throw std::runtime_error(
+        "LinearArena::allocate(): The arena's memory type does not fit." );
+
+    const auto offset = alignUp( mBlock.offset + mUsed, requirements.alignment );
+    if ( offset + requirements.size > mBlock.offset + mBlock.size )
+        return std::nullopt;
+
+    mUsed = offset + requirements.size - mBlock.offset;
+    mPeak = std::max( mPeak, mUsed );
+
+    auto allocation   = mBlock;
+    allocation.offset = offset;
+    allocation.size   = requirements.size;
+    allocation.mapped =
+    mBlock.mapped ? mBlock.mapped + ( offset - mBlock.offset ) : nullptr;
+    return allocation;
+}
+
+void LinearArena::reset() { mUsed = 0; }
+
+vk::DeviceSize LinearArena::usedBytes() const { return mUsed; }
+
+vk::DeviceSize LinearArena::size() const { return mBlock.size; }
+
+vk::DeviceSize LinearArena::peakBytes() const { return mPeak; }
+
+}   // namespace core::renderer
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <set>
+#include <vector>
+
+#define VK_USE_PLATFORM_XCB_KHR
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+namespace core::renderer {
+
+// Sub-allocates device memory out of large blocks, so resources do not each
+// need a vkAllocateMemory(), which drivers cap and make slow. Every memory type
+// gets pools of blocks, one pool for buffers and one for images, which keeps
+// linear and optimal resources on separate blocks and so never closer than
+// bufferImageGranularity. Blocks are split with a buddy scheme: an allocation
+// takes the smallest power of two range that fits its size and alignment, and
+// a freed range merges back with its free buddy. Requests larger than a block
+// get memory of their own. Host visible blocks stay mapped for their life.
+// Not thread safe.
+class MemoryAllocator final {
+public:
+    enum class Kind { eBuffer, eImage };
+
+    struct CreateInfo final {
+        vk::Device                         logicDev;
+        vk::PhysicalDeviceMemoryProperties memory;
+        // Of the device limits, counts the blocks and the dedicated memories.
+        std::uint32_t maxAllocations { std::numeric_limits< std::uint32_t >::max() };
+        // A power of two, and a multiple of minRange.
+        vk::DeviceSize blockSize { vk::DeviceSize { 64 } << 20 };
+    };
+
+    struct Request final {
+        vk::MemoryRequirements  requirements;
+        vk::MemoryPropertyFlags required;
+        // Used when a type of requirements.memoryTypeBits has them too.
+        vk::MemoryPropertyFlags preferred {};
+        Kind                    kind { Kind::eBuffer };
+    };
+
+    // A range of device memory, freed by free() and not by its destruction.
+    struct Allocation final {
+        vk::DeviceMemory memory;
+        vk::DeviceSize   offset { 0 };
+        vk::DeviceSize   size { 0 };
+        // Null when the memory is not host visible.
+        std::byte *   mapped { nullptr };
+        std::uint32_t memoryType { 0 };
+
+        // Where the range came from, for free().
+        std::uint32_t pool { 0 };
+        std::uint32_t block { 0 };
+        std::uint32_t order { 0 };
+        bool          dedicated { false };
+    };
+
+    struct Stats final {
+        std::uint64_t blocks { 0 };
+        std::uint64_t dedicatedAllocations { 0 };
+        std::uint64_t allocations { 0 };
+        // Memory taken from the driver, in blocks and dedicated allocations.
+        vk::DeviceSize reservedBytes { 0 };
+        // Ranges handed out, rounded up to powers of two.
+        vk::DeviceSize usedBytes { 0 };
+        // The sizes asked for, the rest of usedBytes is lost to rounding.
+        vk::DeviceSize requestedBytes { 0 };
+        vk::DeviceSize largestFreeRange { 0 };
+        // 1 - largestFreeRange / free bytes of the blocks, 0 when the free
+        // memory is in one piece.
+        double fragmentation { 0.0 };
+    };
+
+    // Smallest range handed out, and the order 0 of the buddy scheme.
+    static constexpr vk::DeviceSize minRange = 256;
+
+    explicit MemoryAllocator( const CreateInfo & createInfo );
+    MemoryAllocator( const MemoryAllocator & ) = delete;
+    MemoryAllocator & operator=( const MemoryAllocator & ) = delete;
+    // Frees the blocks, allocations still in use become invalid.
+    ~MemoryAllocator();
+
+    // Throws when no memory type qualifies or the driver is out of memory.
+    [[nodiscard]] Allocation allocate( const Request & request );
+    void                     free( const Allocation & allocation );
+
+    // Allocate and bind, images are taken as optimally tiled.
+    [[nodiscard]] Allocation allocate( const vk::Buffer &      buffer,
+                                       vk::MemoryPropertyFlags required,
+                                       vk::MemoryPropertyFlags preferred = {} );
+    [[nodiscard]] Allocation allocate( const vk::Image &       image,
+                                       vk::MemoryPropertyFlags required,
+                                       vk::MemoryPropertyFlags preferred = {} );
+
+    // Gives the blocks without allocations back to the driver.
+    void trim();
+
+    [[nodiscard]] Stats stats() const;
+
+    // A type of typeBits with the required flags, and with the preferred ones
+    // when there is such a type. Throws when there is none.
+    [[nodiscard]] std::uint32_t
+    memoryType( std::uint32_t           typeBits,
+                vk::MemoryPropertyFlags required,
+                vk::MemoryPropertyFlags preferred = {} ) const;
+
+    [[nodiscard]] const vk::Device & device() const;
+
+private:
+    struct Block final {
+        vk::DeviceMemory memory;
+        std::byte *      mapped { nullptr };
+        // Per order, the offsets of the free ranges.
+        std::vector< std::set< vk::DeviceSize > > freeRanges;
+        std::uint64_t                             allocations { 0 };
+    };
+
+    struct Pool final {
+        std::uint32_t        memoryType;
+        Kind                 kind;
+        std::vector< Block > blocks;
+    };
+
+    [[nodiscard]] std::uint32_t poolOf( std::uint32_t memoryType, Kind kind );
+    [[nodiscard]] std::optional< vk::DeviceSize >
+    takeRange( Block & block, std::uint32_t order );
+    [[nodiscard]] vk::DeviceMemory allocateMemory( std::uint32_t  memoryType,
+                                                   vk::DeviceSize size,
+                                                   std::byte *&   mapped );
+    void                           freeMemory( vk::DeviceMemory memory );
+
+    vk::Device                         mLogicDev;
+    vk::PhysicalDeviceMemoryProperties mMemory;
+    std::uint32_t                      mMaxAllocations;
+    vk::DeviceSize                     mBlockSize;
+    // The order of a whole block.
+    std::uint32_t mTopOrder { 0 };
+
+    std::vector< Pool >             mPools;
+    std::vector< vk::DeviceMemory > mDedicated;
+    vk::DeviceSize                  mDedicatedBytes { 0 };
+    std::uint32_t                   mDeviceAllocations { 0 };
+    std::uint64_t                   mAllocations { 0 };
+    vk::DeviceSize                  mUsedBytes { 0 };
+    vk::DeviceSize                  mRequestedBytes { 0 };
+};
+
+// Bump allocates short lived data out of one range of a memory allocator. Its
+// allocations are not freed one by one, the arena is reset as a whole, e.g.
+// once the frame that used the data is done.
+class LinearArena final {
+public:
+    struct CreateInfo final {
+        vk::DeviceSize          size;
+        std::uint32_t           memoryTypeBits { ~std::uint32_t { 0 } };
+        vk::MemoryPropertyFlags required;
+        vk::MemoryPropertyFlags preferred {};
+    };
+
+    LinearArena( MemoryAllocator & allocator, const CreateInfo & createInfo );
+    LinearArena( const LinearArena & ) = delete;
+    LinearArena & operator=( const LinearArena & ) = delete;
+    ~LinearArena();
+
+    // Nullopt when the arena is full. Throws when the arena's memory type is not
+    // in requirements.memoryTypeBits.
+    [[nodiscard]] std::optional< MemoryAllocator::Allocation >
+    allocate( const vk::MemoryRequirements & requirements );
+    void reset();
+
+    [[nodiscard]] vk::DeviceSize usedBytes() const;
+    [[nodiscard]] vk::DeviceSize size() const;
+    // The most the arena held since it was created.
+    [[nodiscard]] vk::DeviceSize peakBytes() const;
+
+private:
+    MemoryAllocator &           mAllocator;
+    MemoryAllocator::Allocation mBlock;
+    vk::DeviceSize              mUsed { 0 };
+    vk::DeviceSize              mPeak { 0 };
+};
+
+}   // namespace core::renderer
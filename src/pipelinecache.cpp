@@ -0,0 +1,185 @@
+#include "pipelinecache.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+namespace core::renderer {
+
+namespace {
+// "VXPC" in the first bytes of the file.
+constexpr std::uint32_t fileMagic   = 0x43505856;
+constexpr std::uint32_t fileVersion = 1;
+// Bigger files are taken for corrupt, real caches stay far below.
+constexpr std::uintmax_t maxDataSize = std::uintmax_t { 256 } << 20;
+// Size of VkPipelineCacheHeaderVersionOne.
+constexpr std::size_t driverHeaderSize = 16 + VK_UUID_SIZE;
+
+[[nodiscard]] std::uint32_t readWord( std::span< const std::byte > data,
+                                      std::size_t                  offset ) {
+    std::uint32_t word = 0;
+    std::memcpy( &word, data.data() + offset, sizeof( word ) );
+    return word;
+}
+}   // namespace
+
+std::filesystem::path PipelineCache::defaultDirectory() {
+    if ( const char * cacheHome = std::getenv( "XDG_CACHE_HOME" );
+         cacheHome && *cacheHome )
+        return std::filesystem::path( cacheHome ) / "vulkan_xcb";
+    if ( const char * home = std::getenv( "HOME" ); home && *home )
+        return std::filesystem::path( home ) / ".cache" / "vulkan_xcb";
+    return {};
+}
+
+PipelineCache::PipelineCache( const CreateInfo & createInfo ) :
+mLogicDev( createInfo.logicDev ) {
+    const auto & properties = createInfo.gpu->properties;
+    mKey                    = Header { .magic         = fileMagic,
+                                       .version       = fileVersion,
+                                       .vendorId      = properties.vendorID,
+                                       .deviceId      = properties.deviceID,
+                                       .driverVersion = properties.driverVersion,
+                                       .uuid          = properties.pipelineCacheUUID };
+
+    if ( !createInfo.directory.empty() ) {
+        std::ostringstream name;
+        name << "pipelines-" << std::hex << std::setfill( '0' ) << std::setw( 4 )
+             << mKey.vendorId << '-' << std::setw( 4 ) << mKey.deviceId << '-'
+             << std::setw( 8 ) << mKey.driverVersion << '-';
+        for ( auto byte : mKey.uuid )
+            name << std::setw( 2 ) << static_cast< unsigned >( byte );
+        name << ".bin";
+        mPath = createInfo.directory / name.str();
+    }
+
+    if ( const auto data = load(); !data.empty() ) {
+        try {
+            mCache         = mLogicDev.createPipelineCache( vk::PipelineCacheCreateInfo {
+            .initialDataSize = data.size(), .pInitialData = data.data() } );
+            mLoaded        = true;
+            mSavedSize     = data.size();
+            mSavedChecksum = checksumOf( data );
+        } catch ( const vk::SystemError & ) {
+            // The driver refused the data, start over with an empty cache.
+        }
+    }
+    if ( !mCache )
+        mCache = mLogicDev.createPipelineCache( vk::PipelineCacheCreateInfo {} );
+}
+
+PipelineCache::~PipelineCache() {
+    try {
+        save();
+    } catch ( ... ) {
+        // Losing the cache only costs the next start its compiles.
+    }
+    mLogicDev.destroyPipelineCache( mCache );
+}
+
+bool PipelineCache::save() {
+    if ( mPath.empty() )
+        return true;
+
+    const auto data     = mLogicDev.getPipelineCacheData( mCache );
+    const auto bytes    = std::as_bytes( std::span( data ) );
+    const auto checksum = checksumOf( bytes );
+    if ( bytes.size() == mSavedSize && checksum == mSavedChecksum )
+        return true;
+
+    auto header     = mKey;
+    header.dataSize = bytes.size();
+    header.checksum = checksum;
+
+    std::error_code error;
+    std::filesystem::create_directories( mPath.parent_path(), error );
+    // Per process, two instances saving at once each rename a whole file.
+    auto temporary = mPath;
+    temporary += ".tmp" + std::to_string( ::getpid() );
+    {
+        std::ofstream out( temporary, std::ios::binary | std::ios::trunc );
+        out.write( reinterpret_cast< const char * >( &header ), sizeof( header ) );
+        out.write( reinterpret_cast< const char * >( bytes.data() ),
+                   static_cast< std::streamsize >( bytes.size() ) );
+        if ( !out.flush() ) {
+            out.close();
+            std::filesystem::remove( temporary, error );
+            return false;
+        }
+    }
+    std::filesystem::rename( temporary, mPath, error );
+    if ( error ) {
+        std::filesystem::remove( temporary, error );
+        return false;
+    }
+
+    mSavedSize     = bytes.size();
+    mSavedChecksum = checksum;
+    return true;
+}
+
+const vk::PipelineCache & PipelineCache::cache() const { return mCache; }
+
+const std::filesystem::path & PipelineCache::path() const { return mPath; }
+
+bool PipelineCache::loaded() const { return mLoaded; }
+
+std::vector< std::byte > PipelineCache::load() const {
+    if ( mPath.empty() )
+        return {};
+
+    // The size is checked before anything is allocated for the data.
+    std::error_code error;
+    const auto      fileSize = std::filesystem::file_size( mPath, error );
+    if ( error || fileSize < sizeof( Header ) ||
+         fileSize - sizeof( Header ) > maxDataSize )
+        return {};
+
+    std::ifstream in( mPath, std::ios::binary );
+    Header        header {};
+    if ( !in.read( reinterpret_cast< char * >( &header ), sizeof( header ) ) )
+        return {};
+    if ( header.magic != mKey.magic || header.version != mKey.version ||
+         header.vendorId != mKey.vendorId || header.deviceId != mKey.deviceId ||
+         header.driverVersion != mKey.driverVersion || header.uuid != mKey.uuid ||
+         header.dataSize != fileSize - sizeof( Header ) )
+        return {};
+
+    std::vector< std::byte > data( header.dataSize );
+    if ( !in.read( reinterpret_cast< char * >( data.data() ),
+                   static_cast< std::streamsize >( data.size() ) ) )
+        return {};
+    if ( checksumOf( data ) != header.checksum || !matchesDevice( data ) )
+        return {};
+    return data;
+}
+
+bool PipelineCache::matchesDevice( std::span< const std::byte > data ) const {
+    if ( data.size() < driverHeaderSize )
+        return false;
+
+    const auto headerSize = readWord( data, 0 );
+    return headerSize >= driverHeaderSize && headerSize <= data.size() &&
+           readWord( data, 4 ) ==
+           static_cast< std::uint32_t >( vk::PipelineCacheHeaderVersion::eOne ) &&
+           readWord( data, 8 ) == mKey.vendorId &&
+           readWord( data, 12 ) == mKey.deviceId &&
+           std::memcmp( data.data() + 16, mKey.uuid.data(), mKey.uuid.size() ) == 0;
+}
+
+std::uint64_t PipelineCache::checksumOf( std::span< const std::byte > data ) {
+    // 64 bit FNV-1a.
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for ( auto byte : data ) {
+        hash ^= static_cast< std::uint64_t >( byte );
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+}   // namespace core::renderer
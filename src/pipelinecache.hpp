@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#define VK_USE_PLATFORM_XCB_KHR
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+#include "gpuselector.hpp"
+
+namespace core::renderer {
+
+// A vk::PipelineCache kept on disk between runs, so pipelines are compiled on
+// the first start only. The file is named after the vendor, device, driver
+// version and pipeline cache UUID of the GPU, and starts with a header of its
+// own that repeats them next to the size and a checksum of the data. A file
+// that does not match, is cut short or fails the checksum or the driver's own
+// header check is ignored, and the next save() replaces it. Saving writes a
+// temporary file and renames it over the old one, so readers never see half
+// of a file. Not thread safe.
+class PipelineCache final {
+public:
+    struct CreateInfo final {
+        vk::Device      logicDev;
+        const GpuInfo * gpu;
+        // Empty keeps the cache in memory only.
+        std::filesystem::path directory;
+    };
+
+    // $XDG_CACHE_HOME/vulkan_xcb, else $HOME/.cache/vulkan_xcb, else empty.
+    [[nodiscard]] static std::filesystem::path defaultDirectory();
+
+    explicit PipelineCache( const CreateInfo & createInfo );
+    PipelineCache( const PipelineCache & ) = delete;
+    PipelineCache & operator=( const PipelineCache & ) = delete;
+    // Saves what was added since the last save().
+    ~PipelineCache();
+
+    // Writes the file when the cache changed since it was loaded or saved.
+    // Returns false when the file cannot be written, the cache stays usable.
+    bool save();
+
+    [[nodiscard]] const vk::PipelineCache & cache() const;
+    // Empty when the cache is not persistent.
+    [[nodiscard]] const std::filesystem::path & path() const;
+    // True when the data of an earlier run was accepted.
+    [[nodiscard]] bool loaded() const;
+
+private:
+    // Precedes the driver's data in the file, without padding.
+    struct Header final {
+        std::uint32_t                  magic;
+        std::uint32_t                  version;
+        std::uint32_t                  vendorId;
+        std::uint32_t                  deviceId;
+        std::uint32_t                  driverVersion;
+        std::array< std::uint8_t, 16 > uuid;
+        std::uint32_t                  reserved { 0 };
+        std::uint64_t                  dataSize { 0 };
+        std::uint64_t                  checksum { 0 };
+    };
+
+    // The file's data when it is valid for the device, else empty.
+    [[nodiscard]] std::vector< std::byte > load() const;
+    // Checks the header the driver puts in front of its data.
+    [[nodiscard]] bool matchesDevice( std::span< const std::byte > data ) const;
+    [[nodiscard]] static std::uint64_t checksumOf( std::span< const std::byte > data );
+
+    vk::Device            mLogicDev;
+    Header                mKey;
+    std::filesystem::path mPath;
+    vk::PipelineCache     mCache;
+    bool                  mLoaded { false };
+
+    // Of the data on disk, to skip saves that would write the same.
+    std::size_t   mSavedSize { 0 };
+    std::uint64_t mSavedChecksum { 0 };
+};
+
+}   // namespace core::renderer
@@ -0,0 +1,82 @@
+#include "queueownership.hpp"
+
+namespace core::renderer {
+
+namespace {
+void recordBarrier( const vk::CommandBuffer &       commandBuffer,
+                    vk::PipelineStageFlags          srcStage,
+                    vk::PipelineStageFlags          dstStage,
+                    const vk::BufferMemoryBarrier & barrier ) {
+    commandBuffer.pipelineBarrier(
+    srcStage, dstStage, vk::DependencyFlags(), {}, { barrier }, {} );
+}
+
+void recordBarrier( const vk::CommandBuffer &      commandBuffer,
+                    vk::PipelineStageFlags         srcStage,
+                    vk::PipelineStageFlags         dstStage,
+                    const vk::ImageMemoryBarrier & barrier ) {
+    commandBuffer.pipelineBarrier(
+    srcStage, dstStage, vk::DependencyFlags(), {}, {}, { barrier } );
+}
+
+template < class Barrier >
+void releaseBarrier( const QueueOwnership &    ownership,
+                     const vk::CommandBuffer & commandBuffer,
+                     Barrier                   barrier ) {
+    if ( !ownership.transfers() ) {
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        recordBarrier( commandBuffer, ownership.srcStage, ownership.dstStage, barrier );
+        return;
+    }
+
+    // The destination access is ignored on the releasing queue.
+    barrier.dstAccessMask       = {};
+    barrier.srcQueueFamilyIndex = ownership.srcFamily;
+    barrier.dstQueueFamilyIndex = ownership.dstFamily;
+    recordBarrier( commandBuffer,
+                   ownership.srcStage,
+                   vk::PipelineStageFlagBits::eBottomOfPipe,
+                   barrier );
+}
+
+template < class Barrier >
+void acquireBarrier( const QueueOwnership &    ownership,
+                     const vk::CommandBuffer & commandBuffer,
+                     Barrier                   barrier ) {
+    if ( !ownership.transfers() )
+        return;
+
+    // The source access is ignored on the acquiring queue, the semaphore
+    // already made the writes available.
+    barrier.srcAccessMask       = {};
+    barrier.srcQueueFamilyIndex = ownership.srcFamily;
+    barrier.dstQueueFamilyIndex = ownership.dstFamily;
+    recordBarrier( commandBuffer,
+                   vk::PipelineStageFlagBits::eTopOfPipe,
+                   ownership.dstStage,
+                   barrier );
+}
+}   // namespace
+
+void QueueOwnership::release( const vk::CommandBuffer &       commandBuffer,
+                              const vk::BufferMemoryBarrier & barrier ) const {
+    releaseBarrier( *this, commandBuffer, barrier );
+}
+
+void QueueOwnership::release( const vk::CommandBuffer &      commandBuffer,
+                              const vk::ImageMemoryBarrier & barrier ) const {
+    releaseBarrier( *this, commandBuffer, barrier );
+}
+
+void QueueOwnership::acquire( const vk::CommandBuffer &       commandBuffer,
+                              const vk::BufferMemoryBarrier & barrier ) const {
+    acquireBarrier( *this, commandBuffer, barrier );
+}
+
+void QueueOwnership::acquire( const vk::CommandBuffer &      commandBuffer,
+                              const vk::ImageMemoryBarrier & barrier ) const {
+    acquireBarrier( *this, commandBuffer, barrier );
+}
+
+}   // namespace core::renderer
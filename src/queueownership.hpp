@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#define VK_USE_PLATFORM_XCB_KHR
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+namespace core::renderer {
+
+// Moves a buffer or an image from the queue family of the work that wrote it to
+// the family of the work that reads it. With different families the barrier is
+// split in two: release() records it on the source queue without the
+// destination access, acquire() records it on the destination queue without the
+// source access, and a semaphore must order the acquire after the release. With
+// the same family nothing changes owner, release() records the whole barrier
+// and acquire() records nothing.
+struct QueueOwnership final {
+    std::uint32_t srcFamily;
+    std::uint32_t dstFamily;
+    // Stages of the writing and of the reading work.
+    vk::PipelineStageFlags srcStage;
+    vk::PipelineStageFlags dstStage;
+
+    [[nodiscard]] bool transfers() const { return srcFamily != dstFamily; }
+
+    // The barriers' queue family indices are overwritten.
+    void release( const vk::CommandBuffer &       commandBuffer,
+                  const vk::BufferMemoryBarrier & barrier ) const;
+    void release( const vk::CommandBuffer &      commandBuffer,
+                  const vk::ImageMemoryBarrier & barrier ) const;
+    void acquire( const vk::CommandBuffer &       commandBuffer,
+                  const vk::BufferMemoryBarrier & barrier ) const;
+    void acquire( const vk::CommandBuffer &      commandBuffer,
+                  const vk::ImageMemoryBarrier & barrier ) const;
+};
+
+}   // namespace core::renderer
@@ -0,0 +1,147 @@
+#include "recordscheduler.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+namespace core::renderer {
+
+namespace {
+// Items of the range workerIndex when itemsCount items are split over
+// workersCount workers as evenly as possible.
+std::pair< std::size_t, std::size_t >
+rangeOf( std::size_t workerIndex, std::size_t workersCount, std::size_t itemsCount ) {
+    return { itemsCount * workerIndex / workersCount,
+             itemsCount * ( workerIndex + 1 ) / workersCount };
+}
+}   // namespace
+
+RecordScheduler::RecordScheduler( const CreateInfo & createInfo ) :
+mLogicDev( createInfo.logicDev ) {
+    if ( createInfo.threadsCount == 0 || createInfo.framesInFlight == 0 )
+        throw std::runtime_error( "RecordScheduler::RecordScheduler(): threadsCount and "
+                                  "framesInFlight must be non-zero." );
+
+    mWorkers.resize( createInfo.threadsCount );
+    try {
+        for ( auto && worker : mWorkers ) {
+            // push_back() must not throw once a pool exists.
+            worker.pools.reserve( createInfo.framesInFlight );
+            for ( std::size_t slot = 0; slot < createInfo.framesInFlight; ++slot ) {
+                // Transient and reset as a whole, like the frame slot pools.
+                worker.pools.push_back(
+                mLogicDev.createCommandPool( vk::CommandPoolCreateInfo {
+                .flags            = vk::CommandPoolCreateFlagBits::eTransient,
+                .queueFamilyIndex = createInfo.queueFamilyIndex } ) );
+                const auto buffers =
+                mLogicDev.allocateCommandBuffers( vk::CommandBufferAllocateInfo {
+                .commandPool        = worker.pools.back(),
+                .level              = vk::CommandBufferLevel::eSecondary,
+                .commandBufferCount = 1 } );
+                worker.buffers.push_back( buffers.front() );
+            }
+        }
+
+        for ( std::size_t i = 0; i < mWorkers.size(); ++i )
+            mWorkers[ i ].thread = std::thread( &RecordScheduler::work, this, i );
+    } catch ( ... ) {
+        // The destructor does not run for a constructor that throws.
+        shutdown();
+        throw;
+    }
+}
+
+RecordScheduler::~RecordScheduler() { shutdown(); }
+
+const std::vector< vk::CommandBuffer > &
+RecordScheduler::record( std::size_t                              slot,
+                         const vk::CommandBufferInheritanceInfo & inheritance,
+                         std::size_t                              itemsCount,
+                         const RangeRecorder &                    recorder ) {
+    {
+        std::unique_lock lock( mMutex );
+        mSlot           = slot;
+        mItemsCount     = itemsCount;
+        mInheritance    = &inheritance;
+        mRecorder       = &recorder;
+        mError          = nullptr;
+        mPendingWorkers = mWorkers.size();
+        ++mGeneration;
+        mWorkReady.notify_all();
+
+        mWorkDone.wait( lock, [ this ] { return mPendingWorkers == 0; } );
+
+        if ( mError )
+            std::rethrow_exception( mError );
+    }
+
+    mRecorded.clear();
+    for ( std::size_t i = 0; i < mWorkers.size(); ++i ) {
+        const auto [ first, last ] = rangeOf( i, mWorkers.size(), itemsCount );
+        if ( first != last )
+            mRecorded.push_back( mWorkers[ i ].buffers.at( slot ) );
+    }
+    return mRecorded;
+}
+
+std::size_t RecordScheduler::threadsCount() const { return mWorkers.size(); }
+
+void RecordScheduler::shutdown() {
+    {
+        std::lock_guard lock( mMutex );
+        mStop = true;
+    }
+    mWorkReady.notify_all();
+
+    for ( auto && worker : mWorkers ) {
+        if ( worker.thread.joinable() )
+            worker.thread.join();
+        for ( auto && pool : worker.pools )
+            mLogicDev.destroyCommandPool( pool );
+    }
+}
+
+void RecordScheduler::work( std::size_t workerIndex ) {
+    std::uint64_t doneGeneration = 0;
+    while ( true ) {
+        {
+            std::unique_lock lock( mMutex );
+            mWorkReady.wait(
+            lock, [ & ] { return mStop || mGeneration != doneGeneration; } );
+            if ( mStop )
+                return;
+            doneGeneration = mGeneration;
+        }
+
+        std::exception_ptr error;
+        try {
+            recordRange( workerIndex );
+        } catch ( ... ) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard lock( mMutex );
+        if ( error && !mError )
+            mError = error;
+        if ( --mPendingWorkers == 0 )
+            mWorkDone.notify_one();
+    }
+}
+
+void RecordScheduler::recordRange( std::size_t workerIndex ) {
+    const auto [ first, last ] = rangeOf( workerIndex, mWorkers.size(), mItemsCount );
+    if ( first == last )
+        return;
+
+    auto & worker = mWorkers[ workerIndex ];
+    mLogicDev.resetCommandPool( worker.pools.at( mSlot ) );
+
+    const auto & buffer = worker.buffers.at( mSlot );
+    buffer.begin( vk::CommandBufferBeginInfo {
+    .flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue |
+             vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+    .pInheritanceInfo = mInheritance } );
+    ( *mRecorder )( buffer, first, last );
+    buffer.end();
+}
+
+}   // namespace core::renderer
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define VK_USE_PLATFORM_XCB_KHR
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+namespace core::renderer {
+
+// Records the items of one frame on a pool of worker threads. Every worker owns
+// one command pool per frame slot and records a secondary command buffer for a
+// contiguous range of the items, the primary buffer executes those buffers in
+// range order, so the result does not depend on which worker finishes first.
+class RecordScheduler final {
+public:
+    struct CreateInfo final {
+        vk::Device    logicDev;
+        std::uint32_t queueFamilyIndex;
+        std::size_t   framesInFlight;
+        std::size_t   threadsCount;
+    };
+
+    // Records the items [first, last) into the secondary buffer. Called from the
+    // worker threads, concurrently for different ranges.
+    using RangeRecorder = std::function< void(
+    const vk::CommandBuffer & commandBuffer, std::size_t first, std::size_t last ) >;
+
+    explicit RecordScheduler( const CreateInfo & createInfo );
+    RecordScheduler( const RecordScheduler & ) = delete;
+    RecordScheduler & operator=( const RecordScheduler & ) = delete;
+    ~RecordScheduler();
+
+    // Resets the worker pools of the slot, so the slot's previous frame must be
+    // done on the GPU. Returns one secondary buffer per non-empty range in range
+    // order, valid until the slot is recorded again. Rethrows the first
+    // exception of a recorder.
+    const std::vector< vk::CommandBuffer > &
+    record( std::size_t                              slot,
+            const vk::CommandBufferInheritanceInfo & inheritance,
+            std::size_t                              itemsCount,
+            const RangeRecorder &                    recorder );
+
+    [[nodiscard]] std::size_t threadsCount() const;
+
+private:
+    struct Worker final {
+        std::vector< vk::CommandPool >   pools;
+        std::vector< vk::CommandBuffer > buffers;
+        std::thread                      thread;
+    };
+
+    // Stops and joins the started workers, destroys the created pools.
+    void shutdown();
+    void work( std::size_t workerIndex );
+    void recordRange( std::size_t workerIndex );
+
+    vk::Device            mLogicDev;
+    std::vector< Worker > mWorkers;
+
+    std::mutex              mMutex;
+    std::condition_variable mWorkReady;
+    std::condition_variable mWorkDone;
+    std::uint64_t           mGeneration { 0 };
+    std::size_t             mPendingWorkers { 0 };
+    bool                    mStop { false };
+
+    // The job of the current generation, only read by the workers.
+    std::size_t                              mSlot { 0 };
+    std::size_t                              mItemsCount { 0 };
+    const vk::CommandBufferInheritanceInfo * mInheritance { nullptr };
+    const RangeRecorder *                    mRecorder { nullptr };
+    std::exception_ptr                       mError;
+
+    std::vector< vk::CommandBuffer > mRecorded;
+};
+
+}   // namespace core::renderer
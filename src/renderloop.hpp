@@ -0,0 +1,224 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+
+#include <poll.h>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+#include "xcb_wraper/region.hpp"
+
+namespace core::renderer {
+
+struct RenderLoopConfig final {
+    enum class Mode {
+        // Redraw on every iteration, the swapchain present mode paces the loop.
+        eContinuous,
+        // Sleep on the X connection until an event or the next tick arrives and
+        // redraw only when something asks for it.
+        eEventDriven
+    };
+
+    // Sees every event of the connection before the loop does, returns true
+    // when the event needs a redraw. WindowTreeCache::handleEvent() fits here.
+    using EventHandler = std::function< bool( const xcb_generic_event_t & ) >;
+    // Adds the pixels that changed since the previous frame to the region.
+    // When set, frames that are due (every iteration in continuous mode, every
+    // tick otherwise) repaint only that damage instead of the whole image.
+    using DamageHandler = std::function< void( xcbwraper::Region & ) >;
+
+    Mode mode = Mode::eContinuous;
+    // Redraws per second without any events, 0 disables the ticks.
+    std::uint32_t targetRate = 0;
+    // The loop stops by itself after this time, 0 means run until quit.
+    std::chrono::nanoseconds duration { 0 };
+    EventHandler             eventHandler {};
+    DamageHandler            damageHandler {};
+};
+
+struct RenderLoopStats final {
+    std::uint64_t            presentedFrames { 0 };
+    std::uint64_t            handledEvents { 0 };
+    // Presented frames that repainted only their damage, and the area of the
+    // regions they repainted as computed on the CPU, not counted on the GPU.
+    std::uint64_t            partialFrames { 0 };
+    std::uint64_t            repaintedArea { 0 };
+    std::chrono::nanoseconds wallTime { 0 };
+    std::chrono::nanoseconds cpuTime { 0 };
+};
+
+template < class Renderer > concept HasDrawMethod = requires( Renderer renderer ) {
+    { renderer.draw() };
+};
+
+template < class Renderer >
+concept HasDamageDrawMethod =
+requires( Renderer renderer, const xcbwraper::Region & damage ) {
+    { renderer.draw( damage ) } -> std::convertible_to< std::uint64_t >;
+};
+
+// Renderers that track window state themselves, like a pending swapchain
+// resize, see every event before the loop does. Returns true on redraw.
+template < class Renderer >
+concept HasEventMethod =
+requires( Renderer renderer, const xcb_generic_event_t & event ) {
+    { renderer.handleEvent( event ) } -> std::convertible_to< bool >;
+};
+
+namespace detail {
+constexpr xcb_keycode_t quitKeycode = 24;
+
+// Returns true when the event invalidates the whole presented image, exposed
+// rectangles are added to damage instead. ConfigureNotify also arrives for the
+// other windows under a root whose SubstructureNotify is selected, resizes of
+// the render window are left to the renderer's handleEvent().
+inline bool handleEvent( const xcb_generic_event_t * event,
+                         xcbwraper::Region &         damage,
+                         bool &                      breakLoop ) {
+    switch ( event->response_type & ~0x80 ) {
+    case XCB_EXPOSE: {
+        using CoordType     = xcbwraper::Region::CoordType;
+        const auto * expose = reinterpret_cast< const xcb_expose_event_t * >( event );
+        damage.unite( xcbwraper::Region::Box {
+        static_cast< CoordType >( expose->x ),
+        static_cast< CoordType >( expose->y ),
+        static_cast< CoordType >( expose->x + expose->width ),
+        static_cast< CoordType >( expose->y + expose->height ) } );
+        return false;
+    }
+    case XCB_KEY_PRESS:
+        if ( reinterpret_cast< const xcb_key_press_event_t * >( event )->detail ==
+             quitKeycode )
+            breakLoop = true;
+        return false;
+    default: return false;
+    }
+}
+
+inline std::chrono::nanoseconds processCpuTime() {
+    timespec ts {};
+    clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &ts );
+    return std::chrono::seconds( ts.tv_sec ) + std::chrono::nanoseconds( ts.tv_nsec );
+}
+}   // namespace detail
+
+// A null xcbConnect runs without events, for headless renderers. Event driven
+// mode then only draws on ticks and stops when there are none.
+template < HasDrawMethod Renderer >
+RenderLoopStats runRenderLoop( Renderer &               renderer,
+                               xcb_connection_t *       xcbConnect,
+                               const RenderLoopConfig & config = {} ) {
+    using Clock = std::chrono::steady_clock;
+
+    RenderLoopStats stats {};
+    const auto      startTime    = Clock::now();
+    const auto      startCpuTime = detail::processCpuTime();
+    const auto      deadline     = startTime + config.duration;
+
+    const Clock::duration tickPeriod =
+    config.targetRate ? std::chrono::duration_cast< Clock::duration >(
+                        std::chrono::seconds( 1 ) ) /
+                        config.targetRate
+                      : Clock::duration::zero();
+    auto nextTick = startTime + tickPeriod;
+
+    const bool        eventDriven = config.mode == RenderLoopConfig::Mode::eEventDriven;
+    bool              needRedraw  = true;
+    xcbwraper::Region damage;
+
+    for ( bool breakLoop = false; !breakLoop; ) {
+        for ( auto event = xcbConnect ? xcb_poll_for_event( xcbConnect ) : nullptr;
+              event != nullptr;
+              event = xcb_poll_for_event( xcbConnect ) ) {
+            if ( config.eventHandler )
+                needRedraw |= config.eventHandler( *event );
+            if constexpr ( HasEventMethod< Renderer > )
+                needRedraw |= renderer.handleEvent( *event );
+            needRedraw |= detail::handleEvent( event, damage, breakLoop );
+            ++stats.handledEvents;
+            std::free( event );
+        }
+
+        if ( breakLoop || ( xcbConnect && xcb_connection_has_error( xcbConnect ) ) )
+            break;
+
+        const auto now = Clock::now();
+        if ( config.duration.count() && now >= deadline )
+            break;
+
+        bool frameDue = !eventDriven;
+        if ( tickPeriod.count() && now >= nextTick ) {
+            frameDue = true;
+            nextTick += tickPeriod;
+            if ( nextTick <= now )
+                nextTick = now + tickPeriod;
+        }
+
+        if ( frameDue ) {
+            if ( config.damageHandler )
+                config.damageHandler( damage );
+            else
+                needRedraw = true;
+        }
+
+        if ( needRedraw || ( !damage.isEmpty() && !HasDamageDrawMethod< Renderer > ) ) {
+            renderer.draw();
+            ++stats.presentedFrames;
+            needRedraw = false;
+            damage.clear();
+            continue;
+        }
+
+        if constexpr ( HasDamageDrawMethod< Renderer > ) {
+            if ( !damage.isEmpty() ) {
+                stats.repaintedArea += renderer.draw( damage );
+                ++stats.presentedFrames;
+                ++stats.partialFrames;
+                damage.clear();
+                continue;
+            }
+        }
+
+        // Continuous mode without damage checks again right away.
+        if ( !eventDriven )
+            continue;
+
+        // Nothing to do until the server talks to us or a timer expires. The
+        // event queue was drained above, so a readable fd means new events.
+        auto wakeUp = Clock::time_point::max();
+        if ( tickPeriod.count() )
+            wakeUp = nextTick;
+        if ( config.duration.count() && deadline < wakeUp )
+            wakeUp = deadline;
+        // Without a connection nothing else could ever wake the loop.
+        if ( !xcbConnect && wakeUp == Clock::time_point::max() )
+            break;
+
+        int timeoutMs = -1;
+        if ( wakeUp != Clock::time_point::max() )
+            timeoutMs = static_cast< int >(
+            std::chrono::ceil< std::chrono::milliseconds >( wakeUp - now ).count() );
+
+        // Requests still buffered would never get the replies or events the
+        // poll waits for. poll() skips a negative fd, which leaves the timeout.
+        if ( xcbConnect )
+            xcb_flush( xcbConnect );
+        pollfd connectionFd {
+            .fd      = xcbConnect ? xcb_get_file_descriptor( xcbConnect ) : -1,
+            .events  = POLLIN,
+            .revents = 0
+        };
+        poll( &connectionFd, 1, timeoutMs );
+    }
+
+    stats.wallTime = Clock::now() - startTime;
+    stats.cpuTime  = detail::processCpuTime() - startCpuTime;
+    return stats;
+}
+
+}   // namespace core::renderer
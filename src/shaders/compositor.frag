@@ -0,0 +1,29 @@
+#version 450
+
+// Built three times: with NON_UNIFORM one draw covers the layers of a whole
+// texture array, without it every layer gets a draw of its own. SINGLE_TEXTURE
+// is for devices that cannot index sampler arrays dynamically, the array has
+// one element and every layer a set of its own.
+#ifdef NON_UNIFORM
+#extension GL_EXT_nonuniform_qualifier : require
+#define TEXTURE( index ) textures[ nonuniformEXT( index ) ]
+#elif defined( SINGLE_TEXTURE )
+#define TEXTURE( index ) textures[ 0 ]
+#else
+#define TEXTURE( index ) textures[ index ]
+#endif
+
+layout( constant_id = 0 ) const uint texturesCount = 1;
+
+layout( set = 0, binding = 0 ) uniform sampler2D textures[ texturesCount ];
+
+layout( location = 0 ) in vec2 inUv;
+layout( location = 1 ) in float inOpacity;
+layout( location = 2 ) flat in uint inTexture;
+
+layout( location = 0 ) out vec4 outColor;
+
+void main() {
+    // Premultiplied alpha, as the X server keeps ARGB windows.
+    outColor = texture( TEXTURE( inTexture ), inUv ) * inOpacity;
+}
@@ -0,0 +1,26 @@
+#version 450
+
+// One layer per instance, drawn as a triangle strip of four vertices.
+layout( location = 0 ) in vec4 inRect;   // x, y, width, height in pixels
+layout( location = 1 ) in float inOpacity;
+layout( location = 2 ) in uint inTexture;
+
+layout( push_constant ) uniform Target {
+    // 2 / extent of the target.
+    vec2 scale;
+}
+target;
+
+layout( location = 0 ) out vec2 outUv;
+layout( location = 1 ) out float outOpacity;
+layout( location = 2 ) flat out uint outTexture;
+
+void main() {
+    const vec2 corner = vec2( gl_VertexIndex & 1, gl_VertexIndex >> 1 );
+
+    outUv       = corner;
+    outOpacity  = inOpacity;
+    outTexture  = inTexture;
+    const vec2 position = inRect.xy + corner * inRect.zw;
+    gl_Position         = vec4( position * target.scale - 1.0, 0.0, 1.0 );
+}
@@ -0,0 +1,85 @@
+#include "stagingring.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace core::renderer {
+
+namespace {
+[[nodiscard]] vk::DeviceSize alignUp( vk::DeviceSize value, vk::DeviceSize alignment ) {
+    return alignment > 1 ? ( value + alignment - 1 ) / alignment * alignment : value;
+}
+}   // namespace
+
+StagingRing::StagingRing( MemoryAllocator & allocator, const CreateInfo & createInfo ) :
+mAllocator( allocator ), mSize( createInfo.size ) {
+    const auto & logicDev = mAllocator.device();
+    mBuffer               = logicDev.createBuffer(
+    vk::BufferCreateInfo { .size        = mSize,
+                           .usage       = vk::BufferUsageFlagBits::eTransferSrc,
+                           .sharingMode = vk::SharingMode::eExclusive } );
+    try {
+        // Coherent, so writes need no flush before the submit.
+        mMemory = mAllocator.allocate( mBuffer,
+                                       vk::MemoryPropertyFlagBits::eHostVisible |
+                                       vk::MemoryPropertyFlagBits::eHostCoherent );
+    } catch ( ... ) {
+        logicDev.destroyBuffer( mBuffer );
+        throw;
+    }
+}
+
+StagingRing::~StagingRing() {
+    mAllocator.device().destroyBuffer( mBuffer );
+    mAllocator.free( mMemory );
+}
+
+std::optional< StagingRing::Span > StagingRing::allocate( vk::DeviceSize size,
+                                                           vk::DeviceSize alignment ) {
+    assert( mSize % std::max< vk::DeviceSize >( alignment, 1 ) == 0 );
+
+    // Idle, the next request starts at the beginning of the buffer, else one
+    // larger than what is left up to the end would never fit.
+    if ( mHead == mTail && mFrames.empty() )
+        mHead = mTail = alignUp( mHead, mSize );
+
+    auto position = alignUp( mHead, alignment );
+    // What is left up to the end of the buffer is skipped.
+    if ( position % mSize + size > mSize )
+        position = alignUp( position, mSize );
+    if ( position + size - mTail > mSize )
+        return std::nullopt;
+
+    mHead = position + size;
+    mPeak = std::max( mPeak, mHead - mTail );
+    return Span { .offset = position % mSize,
+                  .data   = mMemory.mapped + position % mSize };
+}
+
+void StagingRing::endFrame( std::uint64_t serial ) {
+    if ( mFrames.empty() ? mHead != mTail : mHead != mFrames.back().end )
+        mFrames.push_back( Frame { .serial = serial, .end = mHead } );
+}
+
+void StagingRing::release( std::uint64_t completedSerial ) {
+    const auto done =
+    std::find_if( mFrames.begin(), mFrames.end(), [ & ]( const Frame & frame ) {
+        return frame.serial > completedSerial;
+    } );
+    if ( done == mFrames.begin() )
+        return;
+
+    mTail = std::prev( done )->end;
+    mFrames.erase( mFrames.begin(), done );
+}
+
+const vk::Buffer & StagingRing::buffer() const { return mBuffer; }
+
+vk::DeviceSize StagingRing::size() const { return mSize; }
+
+vk::DeviceSize StagingRing::usedBytes() const { return mHead - mTail; }
+
+vk::DeviceSize StagingRing::peakBytes() const { return mPeak; }
+
+}   // namespace core::renderer
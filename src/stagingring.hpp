@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#define VK_USE_PLATFORM_XCB_KHR
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+#include "memoryallocator.hpp"
+
+namespace core::renderer {
+
+// Streams data to the GPU through one host visible buffer, mapped for its
+// whole life and used as a ring. The uploads of a frame are written behind
+// the ones of the previous frame, and their space comes back once the frame's
+// fence says the GPU copied out of it. Nothing is allocated or submitted per
+// upload. Not thread safe.
+class StagingRing final {
+public:
+    struct CreateInfo final {
+        // A multiple of every alignment asked for.
+        vk::DeviceSize size;
+    };
+
+    // Part of the ring, data maps offset of the buffer.
+    struct Span final {
+        vk::DeviceSize offset;
+        std::byte *    data;
+    };
+
+    StagingRing( MemoryAllocator & allocator, const CreateInfo & createInfo );
+    StagingRing( const StagingRing & ) = delete;
+    StagingRing & operator=( const StagingRing & ) = delete;
+    // The device must be done with the frames that used the ring.
+    ~StagingRing();
+
+    // Nullopt while the frames in flight hold too much of the ring, the upload
+    // has to wait for a later frame then. A span never wraps around the end.
+    [[nodiscard]] std::optional< Span > allocate( vk::DeviceSize size,
+                                                  vk::DeviceSize alignment );
+    // The spans allocated since the previous call belong to the frame with the
+    // serial.
+    void endFrame( std::uint64_t serial );
+    // The frames up to completedSerial are done, their spans are free again.
+    void release( std::uint64_t completedSerial );
+
+    [[nodiscard]] const vk::Buffer & buffer() const;
+    [[nodiscard]] vk::DeviceSize     size() const;
+    // Held by the frames in flight and the one being recorded.
+    [[nodiscard]] vk::DeviceSize usedBytes() const;
+    // The most the ring held since it was created.
+    [[nodiscard]] vk::DeviceSize peakBytes() const;
+
+private:
+    struct Frame final {
+        std::uint64_t  serial;
+        vk::DeviceSize end;
+    };
+
+    MemoryAllocator &           mAllocator;
+    vk::Buffer                  mBuffer;
+    MemoryAllocator::Allocation mMemory;
+    vk::DeviceSize              mSize;
+
+    // Positions only grow, the offset in the buffer is position % mSize. The
+    // bytes in [mTail, mHead) are in use.
+    vk::DeviceSize mHead { 0 };
+    vk::DeviceSize mTail { 0 };
+    vk::DeviceSize mPeak { 0 };
+    // From the oldest frame in flight to the newest.
+    std::vector< Frame > mFrames;
+};
+
+}   // namespace core::renderer
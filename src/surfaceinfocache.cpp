@@ -0,0 +1,63 @@
+#include "surfaceinfocache.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace core::renderer {
+
+SurfaceInfoCache::SurfaceInfoCache( const vk::PhysicalDevice & gpu,
+                                    const vk::SurfaceKHR &     surface ) :
+mGpu( gpu ), mSurface( surface ), mFormats( gpu.getSurfaceFormatsKHR( surface ) ),
+mPresentModes( gpu.getSurfacePresentModesKHR( surface ) ) {
+    constexpr vk::SurfaceFormatKHR preferredFormat {
+        .format     = vk::Format::eB8G8R8A8Unorm,
+        .colorSpace = vk::ColorSpaceKHR::eSrgbNonlinear
+    };
+
+    // A single undefined format means the surface takes any format.
+    if ( mFormats.size() == 1 && mFormats.front().format == vk::Format::eUndefined )
+        mFormat = preferredFormat;
+    else if ( std::find( mFormats.begin(), mFormats.end(), preferredFormat ) !=
+              mFormats.end() )
+        mFormat = preferredFormat;
+    else
+        mFormat = mFormats.at( 0 );
+}
+
+const vk::SurfaceCapabilitiesKHR & SurfaceInfoCache::capabilities() {
+    if ( !mExtentValid ) {
+        mCapabilities = mGpu.getSurfaceCapabilitiesKHR( mSurface );
+        mExtentValid  = true;
+    }
+    return mCapabilities;
+}
+
+void SurfaceInfoCache::invalidateExtent() { mExtentValid = false; }
+
+const SurfaceInfoCache::SurfaceFormatsVec & SurfaceInfoCache::formats() const {
+    return mFormats;
+}
+
+const SurfaceInfoCache::PresentModesVec & SurfaceInfoCache::presentModes() const {
+    return mPresentModes;
+}
+
+const vk::SurfaceFormatKHR & SurfaceInfoCache::format() const { return mFormat; }
+
+bool SurfaceInfoCache::supportsPresentMode( vk::PresentModeKHR presentMode ) const {
+    return std::find( mPresentModes.begin(), mPresentModes.end(), presentMode ) !=
+           mPresentModes.end();
+}
+
+void SurfaceInfoCache::print() const {
+    for ( auto && surfaceFormat : mFormats )
+        std::cout << vk::to_string( surfaceFormat.format ) << '\n'
+                  << vk::to_string( surfaceFormat.colorSpace ) << '\n';
+    std::cout << '\n';
+
+    for ( auto && presentMode : mPresentModes )
+        std::cout << vk::to_string( presentMode ) << '\n';
+    std::cout << std::flush;
+}
+
+}   // namespace core::renderer
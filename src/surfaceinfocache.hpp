@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#define VK_USE_PLATFORM_XCB_KHR
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+namespace core::renderer {
+
+// What the surface supports, queried once per surface. Only the capabilities
+// follow a resize: invalidateExtent() makes the next capabilities() call query
+// them again, the formats, present modes and the format chosen from them stay
+// the same for every swapchain of the surface.
+class SurfaceInfoCache final {
+public:
+    using SurfaceFormatsVec = std::vector< vk::SurfaceFormatKHR >;
+    using PresentModesVec   = std::vector< vk::PresentModeKHR >;
+
+    SurfaceInfoCache( const vk::PhysicalDevice & gpu, const vk::SurfaceKHR & surface );
+
+    const vk::SurfaceCapabilitiesKHR & capabilities();
+    void                               invalidateExtent();
+
+    [[nodiscard]] const SurfaceFormatsVec & formats() const;
+    [[nodiscard]] const PresentModesVec &   presentModes() const;
+
+    // B8G8R8A8Unorm with sRGB nonlinear when supported, the first format otherwise.
+    [[nodiscard]] const vk::SurfaceFormatKHR & format() const;
+    [[nodiscard]] bool supportsPresentMode( vk::PresentModeKHR presentMode ) const;
+
+    void print() const;
+
+private:
+    vk::PhysicalDevice mGpu;
+    vk::SurfaceKHR     mSurface;
+
+    vk::SurfaceCapabilitiesKHR mCapabilities;
+    bool                       mExtentValid { false };
+
+    SurfaceFormatsVec    mFormats;
+    PresentModesVec      mPresentModes;
+    vk::SurfaceFormatKHR mFormat;
+};
+
+}   // namespace core::renderer
@@ -1,17 +1,21 @@
 #include "vulkanrender.hpp"
 #include "composite.hpp"
+#include "renderloop.hpp"
 #include "xcb_wraper/xcbconnect.hpp"
 
 #include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <exception>
 #include <iostream>
 #include <limits>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_core.h>
@@ -22,257 +26,204 @@
 namespace core::renderer {
 
 namespace {
+constexpr auto noTimeout = std::numeric_limits< std::uint64_t >::max();
+
+constexpr std::array< float, 4 > clearColor { 0.8f, 0.5f, 0.0f, 0.5f };
+
+struct SwapchainInfo final {
+    vk::SwapchainKHR   swapchain;
+    vk::Format         format;
+    vk::Extent2D       extent;
+    vk::PresentModeKHR presentMode;
+};
+
 [[nodiscard]] std::vector< vk::CommandBuffer >
 commandBuffersInit( const vk::Device &      logicDev,
                     const vk::CommandPool & commandPool,
-                    std::uint32_t           swapchainImagesCount );
+                    std::uint32_t           commandBuffersCount,
+                    vk::CommandBufferLevel  level = vk::CommandBufferLevel::ePrimary );
 
-[[nodiscard]] vk::SwapchainKHR
-swapchainInit( const vk::PhysicalDevice &          gpu,
-               const vk::Device &                  logicDev,
-               const vk::SurfaceKHR &              surface,
-               const VulkanBase::QueueTypeConfig & graphicConf,
-               vk::SwapchainKHR                    oldSwapchain = nullptr );
+[[nodiscard]] SwapchainInfo
+swapchainInit( SurfaceInfoCache &                         surfaceInfo,
+               const vk::Device &                         logicDev,
+               const vk::SurfaceKHR &                     surface,
+               const VulkanBase::QueueTypeConfig &        graphicConf,
+               const VulkanGraphicRender::PresentPolicy & presentPolicy,
+               vk::Extent2D                               fallbackExtent,
+               vk::SwapchainKHR                           oldSwapchain = nullptr );
 
-[[nodiscard]] vk::PhysicalDevice getDiscreteGpu( const vk::Instance & instance );
+[[nodiscard]] vk::PresentModeKHR
+choosePresentMode( const SurfaceInfoCache &                   surfaceInfo,
+                   const VulkanGraphicRender::PresentPolicy & presentPolicy );
 
-[[nodiscard]] QueueFamilyIndex
-getGraphicsQueueFamilyIndex( const vk::PhysicalDevice & gpu );
+[[nodiscard]] std::uint32_t
+chooseImageCount( const vk::SurfaceCapabilitiesKHR &         capabilities,
+                  const VulkanGraphicRender::PresentPolicy & presentPolicy,
+                  vk::PresentModeKHR                         presentMode );
 
-void fillCmdBuffers( QueueFamilyIndex, CommandBuffersVec &, ImageVec & );
+[[nodiscard]] vk::RenderPass renderPassInit( const vk::Device & logicDev,
+                                             vk::Format         format );
+
+[[nodiscard]] vk::Rect2D rectOf( const xcbwraper::Region::Box & box );
+
+[[nodiscard]] vk::DeviceSize alignUp( vk::DeviceSize value, vk::DeviceSize alignment );
 
 std::vector< vk::CommandBuffer >
 commandBuffersInit( const vk::Device &      logicDev,
                     const vk::CommandPool & commandPool,
-                    std::uint32_t           swapchainImagesCount ) {
+                    std::uint32_t           commandBuffersCount,
+                    vk::CommandBufferLevel  level ) {
     auto commandBufferAI = std::make_unique< vk::CommandBufferAllocateInfo >(
     vk::CommandBufferAllocateInfo { .commandPool = commandPool,
-                                    .level       = vk::CommandBufferLevel::ePrimary,
-                                    .commandBufferCount = swapchainImagesCount } );
+                                    .level       = level,
+                                    .commandBufferCount = commandBuffersCount } );
 
     auto commandBuffers = logicDev.allocateCommandBuffers( *commandBufferAI );
 
     return commandBuffers;
 }
 
-vk::SwapchainKHR swapchainInit( const vk::PhysicalDevice &          gpu,
-                                const vk::Device &                  logicDev,
-                                const vk::SurfaceKHR &              surface,
-                                const VulkanBase::QueueTypeConfig & queueConf,
-                                vk::SwapchainKHR                    oldSwapchain ) {
-    auto gpuSurfaceFormats = gpu.getSurfaceFormatsKHR( surface );
-    auto gpuSurfaceFormat  = std::make_unique< vk::SurfaceFormatKHR >();
-    for ( auto && gpuSurfaceFormat : gpuSurfaceFormats )
-        std::cout << vk::to_string( gpuSurfaceFormat.format ) << std::endl
-                  << vk::to_string( gpuSurfaceFormat.colorSpace ) << std::endl;
-
-    std::cout << std::endl;
-
-    if ( gpuSurfaceFormats.size() == 1 &&
-         gpuSurfaceFormats.at( 0 ).format == vk::Format::eUndefined )
-        *gpuSurfaceFormat =
-        vk::SurfaceFormatKHR { .format     = vk::Format::eB8G8R8A8Unorm,
-                               .colorSpace = vk::ColorSpaceKHR::eSrgbNonlinear };
-    else
-        for ( auto && gpuSF : gpuSurfaceFormats ) {
-            if ( gpuSF.format == vk::Format::eB8G8R8A8Unorm &&
-                 gpuSF.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear )
-                *gpuSurfaceFormat = gpuSF;
-        }
-
-    if ( gpuSurfaceFormat->format != vk::Format::eB8G8R8A8Unorm )
-        *gpuSurfaceFormat = gpuSurfaceFormats.at( 0 );
-
-    vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo;
-    for ( auto && pm : gpu.getSurfacePresentModesKHR( surface ) ) {
-        std::cout << vk::to_string( pm ) << std::endl;
-        if ( pm == vk::PresentModeKHR::eMailbox ) {
-            presentMode = pm;
-            break;
-        }
+SwapchainInfo swapchainInit( SurfaceInfoCache &                         surfaceInfo,
+                             const vk::Device &                         logicDev,
+                             const vk::SurfaceKHR &                     surface,
+                             const VulkanBase::QueueTypeConfig &        queueConf,
+                             const VulkanGraphicRender::PresentPolicy & presentPolicy,
+                             vk::Extent2D                               fallbackExtent,
+                             vk::SwapchainKHR                           oldSwapchain ) {
+    const auto & capabilities = surfaceInfo.capabilities();
+    const auto & format       = surfaceInfo.format();
+    const auto   presentMode  = choosePresentMode( surfaceInfo, presentPolicy );
+
+    // A current extent of 0xFFFFFFFF leaves the size to the swapchain, headless
+    // surfaces always do.
+    vk::Extent2D extent = capabilities.currentExtent;
+    if ( extent.width == std::numeric_limits< std::uint32_t >::max() ) {
+        const auto & minExtent = capabilities.minImageExtent;
+        const auto & maxExtent = capabilities.maxImageExtent;
+        extent                 = vk::Extent2D {
+            .width = std::clamp( fallbackExtent.width, minExtent.width, maxExtent.width ),
+            .height =
+            std::clamp( fallbackExtent.height, minExtent.height, maxExtent.height )
+        };
     }
-    std::cout << "Present mode is " << vk::to_string( presentMode ) << std::endl;
 
-    //    std::cout << gpu.getSurfaceCapabilitiesKHR( surface ).currentExtent.height
-    //              << std::endl
-    //              << gpu.getSurfaceCapabilitiesKHR( surface ).currentExtent.width
-    //              << std::endl;
+    // Transfer source lets frames be copied out, e.g. by tests.
+    auto usage =
+    vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst;
+    if ( capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc )
+        usage |= vk::ImageUsageFlagBits::eTransferSrc;
 
     vk::SwapchainCreateInfoKHR swapchainCI {
         //        .flags =
         //        vk::SwapchainCreateFlagBitsKHR::eMutableFormat,
-        .surface       = surface,
-        .minImageCount = std::min< std::uint32_t >(
-        gpu.getSurfaceCapabilitiesKHR( surface ).maxImageCount, 3 ),
-        .imageFormat      = gpuSurfaceFormat->format,
-        .imageColorSpace  = gpuSurfaceFormat->colorSpace,
-        .imageExtent      = gpu.getSurfaceCapabilitiesKHR( surface ).currentExtent,
+        .surface          = surface,
+        .minImageCount = chooseImageCount( capabilities, presentPolicy, presentMode ),
+        .imageFormat      = format.format,
+        .imageColorSpace  = format.colorSpace,
+        .imageExtent      = extent,
         .imageArrayLayers = 1,
-        .imageUsage =
-        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst,
+        .imageUsage = usage,
         .imageSharingMode      = vk::SharingMode::eExclusive,
         .queueFamilyIndexCount = queueConf.queueFamilyIndex,
-        .preTransform = gpu.getSurfaceCapabilitiesKHR( surface ).currentTransform,
-        .presentMode  = presentMode,
-        .clipped      = VK_FALSE,
-        .oldSwapchain = oldSwapchain
+        .preTransform          = capabilities.currentTransform,
+        .presentMode           = presentMode,
+        .clipped               = VK_FALSE,
+        .oldSwapchain          = oldSwapchain
     };
 
-    vk::SwapchainKHR swapchain = logicDev.createSwapchainKHR( swapchainCI );
-    std::cout << std::endl << "Swapchain is created" << std::endl;
-    return swapchain;
+    return SwapchainInfo { .swapchain   = logicDev.createSwapchainKHR( swapchainCI ),
+                           .format      = swapchainCI.imageFormat,
+                           .extent      = swapchainCI.imageExtent,
+                           .presentMode = presentMode };
 }
 
-vk::PhysicalDevice getDiscreteGpu( const vk::Instance & instance ) {
-    const std::vector< vk::PhysicalDevice > gpus = instance.enumeratePhysicalDevices();
-
-    for ( auto && gpu : gpus ) {
-        if ( gpu.getProperties().deviceType == vk::PhysicalDeviceType::eDiscreteGpu )
-            return gpu;
+vk::PresentModeKHR
+choosePresentMode( const SurfaceInfoCache &                   surfaceInfo,
+                   const VulkanGraphicRender::PresentPolicy & presentPolicy ) {
+    using Latency = VulkanGraphicRender::PresentPolicy::Latency;
+
+    if ( presentPolicy.presentMode &&
+         surfaceInfo.supportsPresentMode( *presentPolicy.presentMode ) )
+        return *presentPolicy.presentMode;
+
+    std::vector< vk::PresentModeKHR > preferred;
+    switch ( presentPolicy.latency ) {
+    case Latency::eLowLatency:
+        preferred = { vk::PresentModeKHR::eMailbox };
+        break;
+    case Latency::eThroughput:
+        preferred = { vk::PresentModeKHR::eFifoRelaxed };
+        break;
+    case Latency::ePowerSaving: break;
     }
 
-    throw std::runtime_error( "Not matched discrete GPU" );
-
-    return vk::PhysicalDevice();
+    for ( auto && presentMode : preferred )
+        if ( surfaceInfo.supportsPresentMode( presentMode ) )
+            return presentMode;
+    // The only mode every surface supports.
+    return vk::PresentModeKHR::eFifo;
 }
 
-QueueFamilyIndex getGraphicsQueueFamilyIndex( const vk::PhysicalDevice & gpu ) {
-    const auto queueFamilyProps = gpu.getQueueFamilyProperties();
-
-    for ( QueueFamilyIndex queueFamilyIndex = 0;
-          queueFamilyIndex < queueFamilyProps.size();
-          ++queueFamilyIndex )
-        if ( queueFamilyProps[ queueFamilyIndex ].queueFlags &
-             vk::QueueFlagBits::eGraphics )
-            return queueFamilyIndex;
-
-    throw std::runtime_error( "Not matched graphycs queue family" );
-
-    return QueueFamilyIndex();
+std::uint32_t
+chooseImageCount( const vk::SurfaceCapabilitiesKHR &         capabilities,
+                  const VulkanGraphicRender::PresentPolicy & presentPolicy,
+                  vk::PresentModeKHR                         presentMode ) {
+    using Latency = VulkanGraphicRender::PresentPolicy::Latency;
+
+    std::uint32_t imageCount = capabilities.minImageCount;
+    if ( presentPolicy.latency == Latency::eThroughput )
+        imageCount = presentPolicy.imageCount;
+    // Mailbox needs a spare image to render into while one is shown and another
+    // one waits, otherwise acquire blocks like FIFO.
+    else if ( presentMode == vk::PresentModeKHR::eMailbox )
+        imageCount = capabilities.minImageCount + 1;
+
+    imageCount = std::max( imageCount, capabilities.minImageCount );
+    // maxImageCount 0 means no limit.
+    if ( capabilities.maxImageCount != 0 )
+        imageCount = std::min( imageCount, capabilities.maxImageCount );
+    return imageCount;
 }
 
-void fillCmdBuffers( QueueFamilyIndex    queueFamilyIndex,
-                     CommandBuffersVec & commandBuffers,
-                     ImageVec &          swapchainImages ) {
-    vk::CommandBufferBeginInfo cmdBufferBI {
-        .flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse
+vk::RenderPass renderPassInit( const vk::Device & logicDev, vk::Format format ) {
+    // The previous contents are loaded, only the damaged rectangles get cleared.
+    // The image comes in through an explicit barrier, see recordFrame().
+    const vk::AttachmentDescription colorAttachment {
+        .format         = format,
+        .samples        = vk::SampleCountFlagBits::e1,
+        .loadOp         = vk::AttachmentLoadOp::eLoad,
+        .storeOp        = vk::AttachmentStoreOp::eStore,
+        .stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
+        .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
+        .initialLayout  = vk::ImageLayout::eColorAttachmentOptimal,
+        .finalLayout    = vk::ImageLayout::ePresentSrcKHR
     };
 
-    const vk::ClearColorValue clearColorValue(
-    std::array< float, 4 > { 0.8f, 0.5f, 0.0f, 0.5f } );
-
-    const std::array< const vk::ImageSubresourceRange, 1 > ranges {
-        vk::ImageSubresourceRange { .aspectMask     = vk::ImageAspectFlagBits::eColor,
-                                    .baseMipLevel   = 0,
-                                    .levelCount     = 1,
-                                    .baseArrayLayer = 0,
-                                    .layerCount     = 1 }
+    const vk::AttachmentReference colorReference {
+        .attachment = 0, .layout = vk::ImageLayout::eColorAttachmentOptimal
     };
 
-    auto imageMemoryBarierPresentToClear = std::make_unique< vk::ImageMemoryBarrier >(
-    vk::ImageMemoryBarrier { .srcAccessMask       = vk::AccessFlagBits::eMemoryRead,
-                             .dstAccessMask       = vk::AccessFlagBits::eTransferWrite,
-                             .oldLayout           = vk::ImageLayout::eUndefined,
-                             .newLayout           = vk::ImageLayout::eTransferDstOptimal,
-                             .srcQueueFamilyIndex = queueFamilyIndex,
-                             .dstQueueFamilyIndex = queueFamilyIndex,
-                             .subresourceRange    = ranges.at( 0 ) } );
-
-    auto imageMemoryBarierClearToPresent = std::make_unique< vk::ImageMemoryBarrier >(
-    vk::ImageMemoryBarrier { .srcAccessMask       = vk::AccessFlagBits::eTransferWrite,
-                             .dstAccessMask       = vk::AccessFlagBits::eMemoryWrite,
-                             .oldLayout           = vk::ImageLayout::eTransferDstOptimal,
-                             .newLayout           = vk::ImageLayout::ePresentSrcKHR,
-                             .srcQueueFamilyIndex = queueFamilyIndex,
-                             .dstQueueFamilyIndex = queueFamilyIndex,
-                             .subresourceRange    = ranges.at( 0 ) } );
-
-    for ( std::uint32_t i = 0; i < swapchainImages.size(); ++i ) {
-        imageMemoryBarierClearToPresent->image = swapchainImages.at( i );
-        imageMemoryBarierPresentToClear->image = swapchainImages.at( i );
-
-        commandBuffers.at( i ).begin( cmdBufferBI );
-
-        commandBuffers.at( i ).pipelineBarrier( vk::PipelineStageFlagBits::eTransfer,
-                                                vk::PipelineStageFlagBits::eTransfer,
-                                                vk::DependencyFlags(),
-                                                {},
-                                                {},
-                                                { *imageMemoryBarierPresentToClear } );
-
-        commandBuffers.at( i ).clearColorImage( swapchainImages.at( i ),
-                                                vk::ImageLayout::eTransferDstOptimal,
-                                                clearColorValue,
-                                                ranges );
-
-        commandBuffers.at( i ).pipelineBarrier( vk::PipelineStageFlagBits::eTransfer,
-                                                vk::PipelineStageFlagBits::eBottomOfPipe,
-                                                vk::DependencyFlags(),
-                                                {},
-                                                {},
-                                                { *imageMemoryBarierClearToPresent } );
-
-        commandBuffers.at( i ).end();
-    }
-}
+    const vk::SubpassDescription subpass { .pipelineBindPoint =
+                                           vk::PipelineBindPoint::eGraphics,
+                                           .colorAttachmentCount = 1,
+                                           .pColorAttachments    = &colorReference };
 
-void fillCmdBuffersForPresentComposite
-[[maybe_unused]] ( QueueFamilyIndex    queueFamilyIndex,
-                   CommandBuffersVec & commandBuffers,
-                   ImageVec &          swapchainImages ) {
-    vk::CommandBufferBeginInfo cmdBufferBI {
-        .flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse
-    };
+    return logicDev.createRenderPass( vk::RenderPassCreateInfo {
+    .attachmentCount = 1,
+    .pAttachments    = &colorAttachment,
+    .subpassCount    = 1,
+    .pSubpasses      = &subpass } );
+}
 
-    const std::array< const vk::ImageSubresourceRange, 1 > ranges {
-        vk::ImageSubresourceRange { .aspectMask = vk::ImageAspectFlagBits::eColor |
-                                                  vk::ImageAspectFlagBits::eDepth,
-                                    .baseMipLevel   = 0,
-                                    .levelCount     = 1,
-                                    .baseArrayLayer = 0,
-                                    .layerCount     = 2 }
-    };
+vk::Rect2D rectOf( const xcbwraper::Region::Box & box ) {
+    return vk::Rect2D { .offset = vk::Offset2D { .x = box.x1, .y = box.y1 },
+                        .extent = vk::Extent2D {
+                        .width  = static_cast< std::uint32_t >( box.x2 - box.x1 ),
+                        .height = static_cast< std::uint32_t >( box.y2 - box.y1 ) } };
+}
 
-    auto imageMemoryBarierPresentToClear = std::make_unique< vk::ImageMemoryBarrier >(
-    vk::ImageMemoryBarrier { .srcAccessMask       = vk::AccessFlagBits::eMemoryRead,
-                             .dstAccessMask       = vk::AccessFlagBits::eTransferWrite,
-                             .oldLayout           = vk::ImageLayout::eUndefined,
-                             .newLayout           = vk::ImageLayout::eTransferDstOptimal,
-                             .srcQueueFamilyIndex = queueFamilyIndex,
-                             .dstQueueFamilyIndex = queueFamilyIndex,
-                             .subresourceRange    = ranges.at( 0 ) } );
-
-    auto imageMemoryBarierClearToPresent = std::make_unique< vk::ImageMemoryBarrier >(
-    vk::ImageMemoryBarrier { .srcAccessMask       = vk::AccessFlagBits::eTransferWrite,
-                             .dstAccessMask       = vk::AccessFlagBits::eMemoryWrite,
-                             .oldLayout           = vk::ImageLayout::eTransferDstOptimal,
-                             .newLayout           = vk::ImageLayout::ePresentSrcKHR,
-                             .srcQueueFamilyIndex = queueFamilyIndex,
-                             .dstQueueFamilyIndex = queueFamilyIndex,
-                             .subresourceRange    = ranges.at( 0 ) } );
-
-    for ( std::uint32_t i = 0; i < swapchainImages.size(); ++i ) {
-        imageMemoryBarierClearToPresent->image = swapchainImages.at( i );
-        imageMemoryBarierPresentToClear->image = swapchainImages.at( i );
-
-        commandBuffers.at( i ).begin( cmdBufferBI );
-
-        commandBuffers.at( i ).pipelineBarrier( vk::PipelineStageFlagBits::eTransfer,
-                                                vk::PipelineStageFlagBits::eTransfer,
-                                                vk::DependencyFlags(),
-                                                {},
-                                                {},
-                                                { *imageMemoryBarierPresentToClear } );
-
-        commandBuffers.at( i ).pipelineBarrier( vk::PipelineStageFlagBits::eTransfer,
-                                                vk::PipelineStageFlagBits::eBottomOfPipe,
-                                                vk::DependencyFlags(),
-                                                {},
-                                                {},
-                                                { *imageMemoryBarierClearToPresent } );
-
-        commandBuffers.at( i ).end();
-    }
+vk::DeviceSize alignUp( vk::DeviceSize value, vk::DeviceSize alignment ) {
+    return ( value + alignment - 1 ) / alignment * alignment;
 }
 }   // namespace
 
@@ -284,7 +235,41 @@ mExtansions( info.extansions ) /* swapchainImages( info.swapchain == vk::Swapcha
 queueConf( info.queueConf ) */
 {}
 
-VulkanBase::~VulkanBase() = default;
+VulkanBase::~VulkanBase() {
+    if ( mLogicDev )
+        mLogicDev.destroy();
+}
+
+const vk::Queue & VulkanBase::queue( QueueType type ) const {
+    return mQueues.at( mQueueTypes.at( static_cast< std::size_t >( type ) ) );
+}
+
+QueueFamilyIndex VulkanBase::queueFamily( QueueType type ) const {
+    return mQueueConfigs.at( mQueueTypes.at( static_cast< std::size_t >( type ) ) )
+    .queueFamilyIndex;
+}
+
+bool VulkanBase::dedicatedQueue( QueueType type ) const {
+    return type == QueueType::eGraphics ||
+           mQueueTypes.at( static_cast< std::size_t >( type ) ) != 0;
+}
+
+QueueOwnership VulkanBase::queueOwnership( QueueType              from,
+                                           QueueType              to,
+                                           vk::PipelineStageFlags srcStage,
+                                           vk::PipelineStageFlags dstStage ) const {
+    return QueueOwnership { .srcFamily = queueFamily( from ),
+                            .dstFamily = queueFamily( to ),
+                            .srcStage  = srcStage,
+                            .dstStage  = dstStage };
+}
+
+void VulkanBase::addQueue( QueueType type, QueueFamilyIndex queueFamilyIndex ) {
+    mQueueTypes.at( static_cast< std::size_t >( type ) ) = mQueueConfigs.size();
+    mQueueConfigs.emplace_back(
+    QueueTypeConfig { .queueFamilyIndex = queueFamilyIndex,
+                      .priorities       = QueuesPrioritiesVec { 1.0f } } );
+}
 
 VulkanGraphicRender::VulkanGraphicRender(
 VulkanBase::CreateInfo &&          baseInfo,
@@ -292,32 +277,95 @@ VulkanGraphicRender::CreateInfo && graphicRenderCreateInfo ) :
 VulkanBase( std::move( baseInfo ) ),
 //mXcbConnect(  ),
 //xcbConnect( graphicRenderCreateInfo.xcbConnect ),
-mXcbWindow( graphicRenderCreateInfo.xcbWindow ), mComposite() {
-    {
+mXcbConnect( graphicRenderCreateInfo.xcbConnect ),
+mXcbWindow( graphicRenderCreateInfo.xcbWindow ),
+mFallbackExtent( graphicRenderCreateInfo.fallbackExtent ) {
+    if ( graphicRenderCreateInfo.xcbConnect ) {
+        // Plain windowed runs leave the extension alone.
+        if ( graphicRenderCreateInfo.captureWindows ||
+             graphicRenderCreateInfo.presentToOverlay )
+            mComposite = std::make_unique< composite::Composite >(
+            graphicRenderCreateInfo.xcbConnect );
+        if ( graphicRenderCreateInfo.presentToOverlay ) {
+            mXcbWindow = mComposite->getCompositeOverleyWindow();
+            // The overlay covers the screen, its size follows the root's.
+            const std::uint32_t eventMask = XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+            xcb_change_window_attributes(
+            mXcbConnect, mXcbWindow, XCB_CW_EVENT_MASK, &eventMask );
+            mComposite->passOverlayInput();
+        }
         vk::XcbSurfaceCreateInfoKHR surfaceCI { .connection =
                                                 graphicRenderCreateInfo.xcbConnect,
                                                 .window = mXcbWindow };
         mSurface = mInstance.createXcbSurfaceKHR( surfaceCI );
+    } else
+        mSurface =
+        mInstance.createHeadlessSurfaceEXT( vk::HeadlessSurfaceCreateInfoEXT {} );
+
+    // A device given by the caller is used as is, otherwise the selector picks
+    // one that can present to the surface.
+    if ( mGpu )
+        mGpuInfo = GpuInfo::query( mGpu );
+    else {
+        GpuSelector::Requirements requirements { .surface = mSurface };
+        for ( auto && extension : mExtansions.device )
+            requirements.extensions.emplace_back( extension );
+        mGpuInfo = GpuSelector( mInstance ).select( requirements );
+        mGpu     = mGpuInfo.device;
     }
-
-    mGpu = getDiscreteGpu( mInstance );
-    std::cout << "Discrete GPU is : " << mGpu.getProperties().deviceName << std::endl
+    std::cout << "GPU is : " << mGpuInfo.name() << " ("
+              << vk::to_string( mGpuInfo.properties.deviceType ) << ")" << std::endl
               << std::endl;
 
+    mSurfaceInfo = std::make_unique< SurfaceInfoCache >( mGpu, mSurface );
     printSurfaceExtents();
 
-    mQueueConfigs.emplace_back(
-    QueueTypeConfig { .queueFamilyIndex = getGraphicsQueueFamilyIndex( mGpu ),
-                      .priorities       = QueuesPrioritiesVec { 1.0f } } );
+    const auto graphicsFamily = mGpuInfo.graphicsFamily( mSurface );
+    if ( !graphicsFamily )
+        throw std::runtime_error( "VulkanGraphicRender::VulkanGraphicRender(): No "
+                                  "graphics queue family presents to the surface." );
+    addQueue( QueueType::eGraphics, *graphicsFamily );
+    // Lavapipe and many integrated GPUs have one family for everything, their
+    // transfer and compute work stays on the graphics queue.
+    if ( graphicRenderCreateInfo.dedicatedQueues ) {
+        if ( const auto family = mGpuInfo.transferFamily() )
+            addQueue( QueueType::eTransfer, *family );
+        if ( const auto family = mGpuInfo.computeFamily() )
+            addQueue( QueueType::eCompute, *family );
+    }
+
+    mIncrementalPresent =
+    mGpuInfo.hasExtension( VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME );
+    if ( mIncrementalPresent )
+        mExtansions.device.push_back( VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME );
+    const bool captureWindows = graphicRenderCreateInfo.captureWindows && mXcbConnect;
+    const bool presentToOverlay =
+    graphicRenderCreateInfo.presentToOverlay && mXcbConnect;
+    vk::Bool32 nonUniformIndexing = VK_FALSE;
+    if ( captureWindows )
+        for ( auto && extension : WindowCapture::deviceExtensions( mGpuInfo ) )
+            mExtansions.device.push_back( extension );
     {
         std::vector< vk::DeviceQueueCreateInfo > deviceQueueCreateInfos;
-        deviceQueueCreateInfos.push_back( vk::DeviceQueueCreateInfo {
-        .queueFamilyIndex = mQueueConfigs.at( 0 ).queueFamilyIndex,
-        .queueCount       = 1,
-        .pQueuePriorities = mQueueConfigs.at( 0 ).priorities.data() } );
+        for ( auto && queueConfig : mQueueConfigs )
+            deviceQueueCreateInfos.push_back( vk::DeviceQueueCreateInfo {
+            .queueFamilyIndex = queueConfig.queueFamilyIndex,
+            .queueCount       = 1,
+            .pQueuePriorities = queueConfig.priorities.data() } );
         auto gpuFeatures = mGpu.getFeatures();
+        // Lets the compositor draw every layer of a texture array at once.
+        vk::PhysicalDeviceVulkan12Features vulkan12Features {};
+        if ( mGpuInfo.properties.apiVersion >= VK_API_VERSION_1_2 )
+            nonUniformIndexing =
+            mGpu.getFeatures2< vk::PhysicalDeviceFeatures2,
+                               vk::PhysicalDeviceVulkan12Features >()
+            .get< vk::PhysicalDeviceVulkan12Features >()
+            .shaderSampledImageArrayNonUniformIndexing;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing = nonUniformIndexing;
+        mNonUniformIndexing = nonUniformIndexing == VK_TRUE;
 
         vk::DeviceCreateInfo deviceCreateInfo {
+            .pNext = nonUniformIndexing ? &vulkan12Features : nullptr,
             .queueCreateInfoCount =
             static_cast< std::uint32_t >( deviceQueueCreateInfos.size() ),
             .pQueueCreateInfos = deviceQueueCreateInfos.data(),
@@ -329,128 +377,974 @@ mXcbWindow( graphicRenderCreateInfo.xcbWindow ), mComposite() {
 
         mLogicDev = mGpu.createDevice( deviceCreateInfo );
     }
-    mQueues.push_back( mLogicDev.getQueue( mQueueConfigs.at( 0 ).queueFamilyIndex, 0 ) );
+    for ( auto && queueConfig : mQueueConfigs )
+        mQueues.push_back( mLogicDev.getQueue( queueConfig.queueFamilyIndex, 0 ) );
+    mAllocator = std::make_unique< MemoryAllocator >( MemoryAllocator::CreateInfo {
+    .logicDev       = mLogicDev,
+    .memory         = mGpuInfo.memory,
+    .maxAllocations = mGpuInfo.properties.limits.maxMemoryAllocationCount } );
+    mStaging = std::make_unique< StagingRing >(
+    *mAllocator,
+    StagingRing::CreateInfo { .size = graphicRenderCreateInfo.stagingSize } );
+    mPipelineCache = std::make_unique< PipelineCache >(
+    PipelineCache::CreateInfo { .logicDev  = mLogicDev,
+                                .gpu       = &mGpuInfo,
+                                .directory = graphicRenderCreateInfo.pipelineCacheDir } );
+    // The X server keeps drawing automatically redirected windows itself,
+    // below the overlay.
+    const std::uint8_t redirect = presentToOverlay ? XCB_COMPOSITE_REDIRECT_MANUAL
+                                                   : XCB_COMPOSITE_REDIRECT_AUTOMATIC;
+    if ( captureWindows )
+        mWindowCapture = std::make_unique< WindowCapture >(
+        WindowCapture::CreateInfo { .xcbConnect = mXcbConnect,
+                                    .composite  = mComposite.get(),
+                                    .instance   = mInstance,
+                                    .logicDev   = mLogicDev,
+                                    .gpu        = &mGpuInfo,
+                                    .allocator  = mAllocator.get(),
+                                    .staging    = mStaging.get(),
+                                    .queueFamilyIndex =
+                                    mQueueConfigs.at( 0 ).queueFamilyIndex,
+                                    .redirect       = redirect,
+                                    .destroyingView = [ this ]( vk::ImageView view ) {
+                                        if ( mCompositor )
+                                            mCompositor->forget( view );
+                                    } } );
 
     if ( !mGpu.getSurfaceSupportKHR( mQueueConfigs.at( 0 ).queueFamilyIndex, mSurface ) )
         throw std::runtime_error(
         "VulkanGraphicRender::VulkanGraphicRender(): Surface cann't support familyIndex." );
 
-    mCommandPool = mLogicDev.createCommandPool( vk::CommandPoolCreateInfo {
-    .flags = vk::CommandPoolCreateFlagBits::eTransient |
-             vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
-    .queueFamilyIndex = mQueueConfigs.at( 0 ).queueFamilyIndex } );
+    mSurfaceInfo->print();
+    mPresentPolicy           = graphicRenderCreateInfo.presentPolicy;
+    const auto swapchainInfo = swapchainInit( *mSurfaceInfo,
+                                              mLogicDev,
+                                              mSurface,
+                                              mQueueConfigs.at( 0 ),
+                                              mPresentPolicy,
+                                              mFallbackExtent );
+    std::cout << std::endl << "Swapchain is created" << std::endl;
+    mSwapchain       = swapchainInfo.swapchain;
+    mSwapchainFormat = swapchainInfo.format;
+    mSwapchainExtent = swapchainInfo.extent;
+    mPresentMode     = swapchainInfo.presentMode;
+    std::cout << "Present mode is " << vk::to_string( mPresentMode ) << std::endl;
 
-    mSwapchain = swapchainInit( mGpu, mLogicDev, mSurface, mQueueConfigs.at( 0 ) );
+    mRenderPass = renderPassInit( mLogicDev, mSwapchainFormat );
 
     mSwapchainImages = mLogicDev.getSwapchainImagesKHR( mSwapchain );
+    createImageTargets();
 
-    mCommandBuffers =
-    commandBuffersInit( mLogicDev, mCommandPool, mSwapchainImages.size() );
+    if ( graphicRenderCreateInfo.framesInFlight == 0 )
+        throw std::runtime_error(
+        "VulkanGraphicRender::VulkanGraphicRender(): framesInFlight must be non-zero." );
+
+    for ( std::uint8_t i = 0; i < graphicRenderCreateInfo.framesInFlight; ++i ) {
+        // No eResetCommandBuffer, the pool is only ever reset as a whole.
+        const auto commandPool = mLogicDev.createCommandPool(
+        vk::CommandPoolCreateInfo { .flags = vk::CommandPoolCreateFlagBits::eTransient,
+                                    .queueFamilyIndex =
+                                    mQueueConfigs.at( 0 ).queueFamilyIndex } );
+
+        mFrames.push_back( FrameSync {
+        .imageAvailable = mLogicDev.createSemaphore( {} ),
+        .renderFinished = mLogicDev.createSemaphore( {} ),
+        .inFlight       = mLogicDev.createFence(
+        vk::FenceCreateInfo { .flags = vk::FenceCreateFlagBits::eSignaled } ),
+        .commandPool       = commandPool,
+        .commandBuffer     = commandBuffersInit( mLogicDev, commandPool, 1 ).front(),
+        .baseCommandBuffer = commandBuffersInit(
+        mLogicDev, commandPool, 1, vk::CommandBufferLevel::eSecondary ).front() } );
+
+        for ( auto type : { QueueType::eTransfer, QueueType::eCompute } ) {
+            if ( !dedicatedQueue( type ) )
+                continue;
+            auto & queueSlot =
+            mFrames.back().queues.at( static_cast< std::size_t >( type ) );
+            queueSlot.commandPool =
+            mLogicDev.createCommandPool( vk::CommandPoolCreateInfo {
+            .flags            = vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = queueFamily( type ) } );
+            queueSlot.commandBuffer =
+            commandBuffersInit( mLogicDev, queueSlot.commandPool, 1 ).front();
+            queueSlot.done = mLogicDev.createSemaphore( {} );
+        }
 
-    fillCmdBuffers(
-    mQueueConfigs.at( 0 ).queueFamilyIndex, mCommandBuffers, mSwapchainImages );
+        if ( graphicRenderCreateInfo.frameArenaSize != 0 )
+            mFrames.back().arena = std::make_unique< LinearArena >(
+            *mAllocator,
+            LinearArena::CreateInfo {
+            .size     = graphicRenderCreateInfo.frameArenaSize,
+            .required = vk::MemoryPropertyFlagBits::eHostVisible |
+                        vk::MemoryPropertyFlagBits::eHostCoherent } );
+    }
 
-    mSemaphores.push_back( mLogicDev.createSemaphore( {} ) );
-    mSemaphores.push_back( mLogicDev.createSemaphore( {} ) );
+    mImagesInFlight.assign( mSwapchainImages.size(), vk::Fence() );
+    resetImagesDamage();
+
+    const auto timestampBits =
+    mGpuInfo.queueFamilies.at( mQueueConfigs.at( 0 ).queueFamilyIndex )
+    .timestampValidBits;
+    mTimestampPeriod = mGpuInfo.properties.limits.timestampPeriod;
+    if ( timestampBits != 0 && mTimestampPeriod > 0.0 ) {
+        mTimestampMask =
+        timestampBits >= 64 ? ~std::uint64_t { 0 }
+                            : ( std::uint64_t { 1 } << timestampBits ) - 1;
+        mTimestampPool = mLogicDev.createQueryPool( vk::QueryPoolCreateInfo {
+        .queryType  = vk::QueryType::eTimestamp,
+        .queryCount = static_cast< std::uint32_t >( 2 * mFrames.size() ) } );
+    }
 
-    std::cout << std::endl
-              << "Command buffer count :" << mCommandBuffers.size() << std::endl;
     std::cout << std::endl << "Image count : " << mSwapchainImages.size() << std::endl;
 }
 
-VulkanGraphicRender::~VulkanGraphicRender() = default;
+VulkanGraphicRender::~VulkanGraphicRender() {
+    mLogicDev.waitIdle();
+    mRecordScheduler.reset();
+    mWindowCapture.reset();
+    mCompositor.reset();
+    mPipelineCache.reset();
+
+    for ( auto && frame : mFrames ) {
+        mLogicDev.destroySemaphore( frame.imageAvailable );
+        mLogicDev.destroySemaphore( frame.renderFinished );
+        mLogicDev.destroyFence( frame.inFlight );
+        mLogicDev.destroyCommandPool( frame.commandPool );
+        for ( auto && queueSlot : frame.queues )
+            if ( queueSlot.commandPool ) {
+                mLogicDev.destroySemaphore( queueSlot.done );
+                mLogicDev.destroyCommandPool( queueSlot.commandPool );
+            }
+        frame.arena.reset();
+    }
+    mStaging.reset();
+    mAllocator.reset();
+    if ( mTimestampPool )
+        mLogicDev.destroyQueryPool( mTimestampPool );
+
+    // Everything submitted is done after waitIdle(), the presents are taken
+    // for done as well since the current swapchain goes just the same.
+    mCompletedSerial = mSubmittedSerial;
+    for ( auto && retired : mRetiredSwapchains )
+        retired.presentSerial = mCompletedSerial;
+    releaseRetiredSwapchains();
+
+    destroyImageTargets();
+    mLogicDev.destroyRenderPass( mRenderPass );
+    mLogicDev.destroySwapchainKHR( mSwapchain );
+    mInstance.destroySurfaceKHR( mSurface );
+}
 
 void VulkanGraphicRender::draw() {
-    mLogicDev.waitIdle();
-    const auto asqNextImgIndex = mLogicDev.acquireNextImageKHR(
-    mSwapchain, std::numeric_limits< std::uint64_t >::max(), mSemaphores.at( 0 ) );
+    auto &     frame      = mFrames.at( mCurrentFrame );
+    const auto imageIndex = acquireImage( frame );
+    if ( !imageIndex )
+        return;
+
+    // Every pixel of this image is new, so the other images now miss all of them.
+    for ( auto && imageDamage : mImagesDamage )
+        imageDamage.reset( imageBox() );
+
+    renderFrame( frame, *imageIndex, true, nullptr );
+}
+
+std::uint64_t VulkanGraphicRender::draw( const xcbwraper::Region & damage ) {
+    auto &     frame      = mFrames.at( mCurrentFrame );
+    const auto imageIndex = acquireImage( frame );
+    if ( !imageIndex )
+        return 0;
+
+    mFrameDamage = damage;
+    mFrameDamage.intersect( imageBox() );
+
+    // Each image repaints the damage of every frame presented since it was on
+    // screen, which covers the contents it is behind by.
+    for ( auto && imageDamage : mImagesDamage )
+        imageDamage.unite( mFrameDamage );
+
+    const std::uint64_t repaintedPixels = mImagesDamage.at( *imageIndex ).area();
+    const std::uint64_t imagePixels =
+    static_cast< std::uint64_t >( mSwapchainExtent.width ) * mSwapchainExtent.height;
+
+    // Present regions describe the change against the previously presented
+    // image, that is this frame's damage and not the repainted area.
+    mPresentRects.clear();
+    for ( auto && box : mFrameDamage.boxes() ) {
+        const auto rect = rectOf( box );
+        mPresentRects.push_back(
+        vk::RectLayerKHR { .offset = rect.offset, .extent = rect.extent, .layer = 0 } );
+    }
+
+    const vk::PresentRegionKHR presentRegion {
+        .rectangleCount = static_cast< std::uint32_t >( mPresentRects.size() ),
+        .pRectangles    = mPresentRects.data()
+    };
+    const vk::PresentRegionsKHR presentRegions { .swapchainCount = 1,
+                                                 .pRegions       = &presentRegion };
+
+    renderFrame( frame,
+                 *imageIndex,
+                 repaintedPixels == imagePixels,
+                 mIncrementalPresent ? &presentRegions : nullptr );
+
+    return repaintedPixels;
+}
+
+std::optional< std::uint32_t >
+VulkanGraphicRender::acquireImage( FrameSync & frame ) {
+    const auto acquireStart = FrameTimer::Clock::now();
+
+    // Block only until this slot's previous submission retires, the other
+    // slots keep the GPU busy in the meantime.
+    [[maybe_unused]] auto frameWaitResult =
+    mLogicDev.waitForFences( frame.inFlight, VK_TRUE, noTimeout );
+    mCompletedSerial = std::max( mCompletedSerial, frame.submittedSerial );
+    releaseRetiredSwapchains();
+    collectTiming( frame, mCurrentFrame );
+    if ( frame.arena )
+        frame.arena->reset();
+    mStaging->release( mCompletedSerial );
+
+    if ( mSwapchainDirty )
+        update();
+
+    std::uint32_t imageIndex = 0;
+    try {
+        const auto acquired =
+        mLogicDev.acquireNextImageKHR( mSwapchain, noTimeout, frame.imageAvailable );
+        // The image is still presentable, recreate before the next frame.
+        if ( acquired.result == vk::Result::eSuboptimalKHR ) {
+            mSwapchainDirty = true;
+            ++mFrameTimer.counters().suboptimal;
+        }
+        imageIndex = acquired.value;
+    } catch ( const vk::OutOfDateKHRError & ) {
+        ++mFrameTimer.counters().outOfDate;
+        update();
+        return std::nullopt;
+    }
+
+    // The image may still be used by a frame from another slot when the
+    // swapchain hands images out of order.
+    if ( auto & imageFence = mImagesInFlight.at( imageIndex ); imageFence ) {
+        [[maybe_unused]] auto imageWaitResult =
+        mLogicDev.waitForFences( imageFence, VK_TRUE, noTimeout );
+    }
+    mImagesInFlight.at( imageIndex ) = frame.inFlight;
+
+    mLogicDev.resetFences( frame.inFlight );
+    frame.timing[ FrameTimer::Phase::eAcquire ] = {
+        .begin = acquireStart, .duration = FrameTimer::Clock::now() - acquireStart
+    };
+    return imageIndex;
+}
+
+void VulkanGraphicRender::renderFrame( FrameSync &   frame,
+                                       std::uint32_t imageIndex,
+                                       bool          discard,
+                                       const void *  presentNext ) {
+    using Clock = std::chrono::steady_clock;
+
+    auto & repaint = mImagesDamage.at( imageIndex );
+
+    const auto recordStart = Clock::now();
+    recordFrame( frame, imageIndex, repaint, discard );
+    // Cleared before presenting, a present that finds the swapchain out of date
+    // marks every image as stale again.
+    repaint.clear();
+
+    const auto submitStart = Clock::now();
+    frame.timing[ FrameTimer::Phase::eRecord ] = {
+        .begin = recordStart, .duration = submitStart - recordStart
+    };
+    submitAndPresent( frame, imageIndex, presentNext );
+
+    mRecordStats.recordTime += submitStart - recordStart;
+    mRecordStats.submitTime += Clock::now() - submitStart;
+    ++mRecordStats.frames;
+}
+
+// Clears the repaint boxes of the image and runs the frame recorder. The rest
+// of the image keeps what it showed when it was presented last, unless discard
+// is set, which requires the boxes to cover the whole image.
+void VulkanGraphicRender::recordFrame( FrameSync &               frame,
+                                       std::uint32_t             imageIndex,
+                                       const xcbwraper::Region & repaint,
+                                       bool                      discard ) {
+    // acquireImage() waited for the slot's fence, nothing recorded from the pool
+    // is pending any more.
+    mLogicDev.resetCommandPool( frame.commandPool );
+    // So is the slot's arena, acquireImage() reset it.
+    mRecording = true;
+
+    const auto & commandBuffer = frame.commandBuffer;
+    commandBuffer.begin( vk::CommandBufferBeginInfo {
+    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+
+    const auto firstQuery = static_cast< std::uint32_t >( 2 * mCurrentFrame );
+    if ( mTimestampPool ) {
+        commandBuffer.resetQueryPool( mTimestampPool, firstQuery, 2 );
+        commandBuffer.writeTimestamp(
+        vk::PipelineStageFlagBits::eTopOfPipe, mTimestampPool, firstQuery );
+    }
+
+    recordQueueWork( frame );
+    if ( mWindowCapture )
+        mWindowCapture->recordAcquire(
+        commandBuffer, mSubmittedSerial + 1, mCompletedSerial );
+    recordUploads( commandBuffer );
+    // Everything this frame copies out of the ring was allocated by now.
+    mStaging->endFrame( mSubmittedSerial + 1 );
+
+    const vk::ImageMemoryBarrier presentToAttachment {
+        .srcAccessMask = {},
+        .dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead |
+                         vk::AccessFlagBits::eColorAttachmentWrite,
+        .oldLayout =
+        discard ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR,
+        .newLayout = vk::ImageLayout::eColorAttachmentOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = mSwapchainImages.at( imageIndex ),
+        .subresourceRange =
+        vk::ImageSubresourceRange { .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                    .baseMipLevel   = 0,
+                                    .levelCount     = 1,
+                                    .baseArrayLayer = 0,
+                                    .layerCount     = 1 }
+    };
+
+    // The acquire semaphore is waited at this stage, which orders the
+    // transition after the presentation engine released the image.
+    commandBuffer.pipelineBarrier( vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                   vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                   vk::DependencyFlags(),
+                                   {},
+                                   {},
+                                   { presentToAttachment } );
+
+    const bool layered = mLayerRecorder && mRecordScheduler;
+
+    commandBuffer.beginRenderPass(
+    vk::RenderPassBeginInfo { .renderPass  = mRenderPass,
+                              .framebuffer = mFramebuffers.at( imageIndex ),
+                              .renderArea  = vk::Rect2D { .extent = mSwapchainExtent } },
+    layered ? vk::SubpassContents::eSecondaryCommandBuffers
+            : vk::SubpassContents::eInline );
+
+    if ( !layered )
+        recordRepaint( commandBuffer, imageIndex, repaint );
+    else {
+        const vk::CommandBufferInheritanceInfo inheritance {
+            .renderPass  = mRenderPass,
+            .subpass     = 0,
+            .framebuffer = mFramebuffers.at( imageIndex )
+        };
+
+        // A subpass takes either inline commands or secondary buffers, so the
+        // clears go into a secondary buffer of the slot as well.
+        frame.baseCommandBuffer.begin( vk::CommandBufferBeginInfo {
+        .flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue |
+                 vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+        .pInheritanceInfo = &inheritance } );
+        recordRepaint( frame.baseCommandBuffer, imageIndex, repaint );
+        frame.baseCommandBuffer.end();
+
+        // recordFrame() runs before submitAndPresent() advances the slot.
+        mRecordingImage           = imageIndex;
+        const auto & layerBuffers = mRecordScheduler->record(
+        mCurrentFrame, inheritance, mLayersCount, mLayerRangeRecorder );
+
+        mExecutedBuffers.clear();
+        mExecutedBuffers.push_back( frame.baseCommandBuffer );
+        mExecutedBuffers.insert(
+        mExecutedBuffers.end(), layerBuffers.begin(), layerBuffers.end() );
+        commandBuffer.executeCommands( mExecutedBuffers );
+    }
+
+    commandBuffer.endRenderPass();
+    if ( mWindowCapture )
+        mWindowCapture->recordRelease( commandBuffer );
+    if ( mAfterPassRecorder )
+        mAfterPassRecorder( FrameContext { .commandBuffer = commandBuffer,
+                                           .imageIndex    = imageIndex,
+                                           .image = mSwapchainImages.at( imageIndex ),
+                                           .frameSlot = mCurrentFrame,
+                                           .extent    = mSwapchainExtent,
+                                           .repaint   = repaint } );
+    if ( mTimestampPool )
+        commandBuffer.writeTimestamp(
+        vk::PipelineStageFlagBits::eBottomOfPipe, mTimestampPool, firstQuery + 1 );
+    commandBuffer.end();
+    mRecording = false;
+}
+
+void VulkanGraphicRender::recordUploads( const vk::CommandBuffer & commandBuffer ) {
+    // The barriers and copies of a batch are recorded together. An image that
+    // was uploaded twice starts a new batch, the regions of one copy must not
+    // overlap.
+    for ( std::size_t first = 0; first < mUploads.size(); ) {
+        const auto batch = mUploads.begin() + static_cast< std::ptrdiff_t >( first );
+        auto       last  = batch + 1;
+        while ( last != mUploads.end() &&
+                std::none_of( batch, last, [ & ]( const PendingUpload & upload ) {
+                    return upload.image == last->image;
+                } ) )
+            ++last;
+        first = static_cast< std::size_t >( last - mUploads.begin() );
+
+        mUploadBarriers.clear();
+        for ( auto upload = batch; upload != last; ++upload )
+            mUploadBarriers.push_back( vk::ImageMemoryBarrier {
+            .srcAccessMask       = {},
+            .dstAccessMask       = vk::AccessFlagBits::eTransferWrite,
+            .oldLayout           = upload->layout,
+            .newLayout           = vk::ImageLayout::eTransferDstOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = upload->image,
+            .subresourceRange    = vk::ImageSubresourceRange {
+            .aspectMask     = vk::ImageAspectFlagBits::eColor,
+            .baseMipLevel   = 0,
+            .levelCount     = 1,
+            .baseArrayLayer = 0,
+            .layerCount     = 1 } } );
+        // Earlier frames may still sample the images.
+        commandBuffer.pipelineBarrier( vk::PipelineStageFlagBits::eFragmentShader,
+                                       vk::PipelineStageFlagBits::eTransfer,
+                                       vk::DependencyFlags(),
+                                       {},
+                                       {},
+                                       mUploadBarriers );
+
+        for ( auto upload = batch; upload != last; ++upload )
+            commandBuffer.copyBufferToImage(
+            mStaging->buffer(),
+            upload->image,
+            vk::ImageLayout::eTransferDstOptimal,
+            vk::ArrayProxy< const vk::BufferImageCopy >(
+            static_cast< std::uint32_t >( upload->copiesCount ),
+            mUploadCopies.data() + upload->firstCopy ) );
+
+        for ( auto && barrier : mUploadBarriers ) {
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            barrier.oldLayout     = vk::ImageLayout::eTransferDstOptimal;
+            barrier.newLayout     = vk::ImageLayout::eShaderReadOnlyOptimal;
+        }
+        commandBuffer.pipelineBarrier( vk::PipelineStageFlagBits::eTransfer,
+                                       vk::PipelineStageFlagBits::eFragmentShader,
+                                       vk::DependencyFlags(),
+                                       {},
+                                       {},
+                                       mUploadBarriers );
+    }
+    mUploads.clear();
+    mUploadCopies.clear();
+}
+
+void VulkanGraphicRender::recordQueueWork( FrameSync & frame ) {
+    for ( std::size_t type = 0; type < queueTypesCount; ++type ) {
+        auto & works = mQueueWork.at( type );
+        if ( works.empty() )
+            continue;
+
+        auto & queueSlot = frame.queues.at( type );
+        if ( !queueSlot.commandPool )
+            for ( auto && work : works )
+                work.record( frame.commandBuffer );
+        else {
+            // The slot's fence was waited, and the frame that waited for the
+            // previous work of the slot is done.
+            mLogicDev.resetCommandPool( queueSlot.commandPool );
+            queueSlot.commandBuffer.begin( vk::CommandBufferBeginInfo {
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+            queueSlot.waitStage = {};
+            for ( auto && work : works ) {
+                work.record( queueSlot.commandBuffer );
+                queueSlot.waitStage |= work.waitStage;
+            }
+            queueSlot.commandBuffer.end();
+            queueSlot.pending = true;
+        }
+
+        for ( auto && work : works )
+            if ( work.acquire )
+                work.acquire( frame.commandBuffer );
+        works.clear();
+    }
+}
 
-    //        if (asqNextImgIndex.result == vk::Result::eErrorOutOfDateKHR)
-    //            update();
+void VulkanGraphicRender::recordRepaint( const vk::CommandBuffer & commandBuffer,
+                                         std::uint32_t             imageIndex,
+                                         const xcbwraper::Region & repaint ) {
+    mClearRects.clear();
+    for ( auto && box : repaint.boxes() )
+        mClearRects.push_back(
+        vk::ClearRect { .rect = rectOf( box ), .baseArrayLayer = 0, .layerCount = 1 } );
+
+    if ( !mClearRects.empty() )
+        commandBuffer.clearAttachments(
+        vk::ClearAttachment { .aspectMask      = vk::ImageAspectFlagBits::eColor,
+                              .colorAttachment = 0,
+                              .clearValue =
+                              vk::ClearValue( vk::ClearColorValue( clearColor ) ) },
+        mClearRects );
+
+    if ( mFrameRecorder )
+        mFrameRecorder( FrameContext { .commandBuffer = commandBuffer,
+                                       .imageIndex    = imageIndex,
+                                       .image     = mSwapchainImages.at( imageIndex ),
+                                       .frameSlot = mCurrentFrame,
+                                       .extent        = mSwapchainExtent,
+                                       .repaint       = repaint } );
+}
 
-    //        std::cout << std::endl
-    //                  << "asqNextImgIndex number : " << asqNextImgIndex
-    //                  << std::endl;
+void VulkanGraphicRender::submitAndPresent( FrameSync &   frame,
+                                            std::uint32_t imageIndex,
+                                            const void *  presentNext ) {
+    // The image and the work of the dedicated queues.
+    std::array< vk::Semaphore, queueTypesCount > waitSemaphores { frame.imageAvailable };
+    std::array< vk::PipelineStageFlags, queueTypesCount > waitStages {
+        vk::PipelineStageFlagBits::eColorAttachmentOutput
+    };
+    std::uint32_t waitCount = 1;
 
-    const std::array< const vk::Flags< vk::PipelineStageFlagBits >, 1 >
-    pipelineStageFlags { vk::PipelineStageFlagBits::eTransfer };
+    const auto submitStart = FrameTimer::Clock::now();
+    for ( std::size_t type = 0; type < queueTypesCount; ++type ) {
+        auto & queueSlot = frame.queues.at( type );
+        if ( !queueSlot.pending )
+            continue;
+
+        queue( static_cast< QueueType >( type ) )
+        .submit( vk::SubmitInfo { .commandBufferCount   = 1,
+                                  .pCommandBuffers      = &queueSlot.commandBuffer,
+                                  .signalSemaphoreCount = 1,
+                                  .pSignalSemaphores    = &queueSlot.done } );
+        waitSemaphores.at( waitCount ) = queueSlot.done;
+        waitStages.at( waitCount )     = queueSlot.waitStage;
+        ++waitCount;
+        queueSlot.pending = false;
+    }
 
     const std::array< const vk::SubmitInfo, 1 > subInfo { vk::SubmitInfo {
-    .waitSemaphoreCount   = 1,
-    .pWaitSemaphores      = &mSemaphores.at( 0 ),
-    .pWaitDstStageMask    = pipelineStageFlags.data(),
+    .waitSemaphoreCount   = waitCount,
+    .pWaitSemaphores      = waitSemaphores.data(),
+    .pWaitDstStageMask    = waitStages.data(),
     .commandBufferCount   = 1,
-    .pCommandBuffers      = &mCommandBuffers.at( asqNextImgIndex.value ),
+    .pCommandBuffers      = &frame.commandBuffer,
     .signalSemaphoreCount = 1,
-    .pSignalSemaphores    = &mSemaphores.at( 1 ) } };
+    .pSignalSemaphores    = &frame.renderFinished } };
 
-    mQueues.at( 0 ).submit( subInfo );
-    //       std::cout << "Submit is success" << std::endl;
+    queue( QueueType::eGraphics ).submit( subInfo, frame.inFlight );
+    frame.submittedSerial = ++mSubmittedSerial;
+    const auto presentStart = FrameTimer::Clock::now();
 
-    vk::PresentInfoKHR present { .waitSemaphoreCount = 1,
-                                 .pWaitSemaphores    = &mSemaphores.at( 1 ),
+    vk::PresentInfoKHR present { .pNext              = presentNext,
+                                 .waitSemaphoreCount = 1,
+                                 .pWaitSemaphores    = &frame.renderFinished,
                                  .swapchainCount     = 1,
                                  .pSwapchains        = &mSwapchain,
-                                 .pImageIndices      = &asqNextImgIndex.value };
+                                 .pImageIndices      = &imageIndex };
+
+    mCurrentFrame = ( mCurrentFrame + 1 ) % mFrames.size();
 
     try {
-        [[maybe_unused]] auto result = mQueues.at( 0 ).presentKHR( present );
-    } catch ( const vk::OutOfDateKHRError & e ) {
+        if ( queue( QueueType::eGraphics ).presentKHR( present ) ==
+             vk::Result::eSuboptimalKHR ) {
+            mSwapchainDirty = true;
+            ++mFrameTimer.counters().suboptimal;
+        }
+        // Without VK_EXT_swapchain_maintenance1 nothing signals when a present
+        // is done. Once the next frame, acquired after this first present to
+        // the new swapchain, is done, so are the presents to the old ones.
+        for ( auto && retired : mRetiredSwapchains )
+            if ( !retired.presentSerial )
+                retired.presentSerial = mSubmittedSerial + 1;
+    } catch ( const vk::OutOfDateKHRError & ) {
+        ++mFrameTimer.counters().outOfDate;
         update();
-        std::cout << e.what() << std::endl;
     }
+
+    frame.timing.frame                         = frame.submittedSerial;
+    frame.timing[ FrameTimer::Phase::eSubmit ] = {
+        .begin = submitStart, .duration = presentStart - submitStart
+    };
+    frame.timing[ FrameTimer::Phase::ePresent ] = {
+        .begin = presentStart, .duration = FrameTimer::Clock::now() - presentStart
+    };
+    frame.timingPending = true;
 }
 
 void VulkanGraphicRender::update() {
-    mLogicDev.waitIdle();
+    // Only the extent can change on the same surface.
+    mSurfaceInfo->invalidateExtent();
+    const auto swapchainInfo = swapchainInit( *mSurfaceInfo,
+                                              mLogicDev,
+                                              mSurface,
+                                              mQueueConfigs.at( 0 ),
+                                              mPresentPolicy,
+                                              mFallbackExtent,
+                                              mSwapchain );
+
+    // Frames queued on the old swapchain keep running, its objects are released
+    // by releaseRetiredSwapchains() once those frames are done.
+    RetiredSwapchain retired { .swapchain    = mSwapchain,
+                               .imageViews   = std::move( mImageViews ),
+                               .framebuffers = std::move( mFramebuffers ),
+                               .renderPass   = nullptr,
+                               .compositorPipeline = nullptr,
+                               .lastSerial         = mSubmittedSerial };
+    mImageViews.clear();
+    mFramebuffers.clear();
+
+    if ( swapchainInfo.format != mSwapchainFormat ) {
+        retired.renderPass         = mRenderPass;
+        mRenderPass                = renderPassInit( mLogicDev, swapchainInfo.format );
+        if ( mCompositor ) {
+            retired.compositorPipeline = mCompositor->setRenderPass( mRenderPass );
+            mPipelineCache->save();
+        }
+    }
+    mRetiredSwapchains.push_back( std::move( retired ) );
 
-    mSwapchain =
-    swapchainInit( mGpu, mLogicDev, mSurface, mQueueConfigs.at( 0 ), mSwapchain );
+    mSwapchain       = swapchainInfo.swapchain;
+    mSwapchainFormat = swapchainInfo.format;
+    mSwapchainExtent = swapchainInfo.extent;
+    mPresentMode     = swapchainInfo.presentMode;
+    mSwapchainDirty  = false;
+    ++mFrameTimer.counters().swapchainRecreations;
 
+    // The image count may differ from the old swapchain, every per image
+    // vector is sized again.
     mSwapchainImages = mLogicDev.getSwapchainImagesKHR( mSwapchain );
+    mImagesInFlight.assign( mSwapchainImages.size(), vk::Fence() );
+    createImageTargets();
+    resetImagesDamage();
+}
 
-    for ( auto cmdBuffer : mCommandBuffers )
-        cmdBuffer.reset();
+void VulkanGraphicRender::releaseRetiredSwapchains() {
+    for ( auto && retired : mRetiredSwapchains ) {
+        if ( retired.lastSerial > mCompletedSerial )
+            continue;
+
+        for ( auto && framebuffer : retired.framebuffers )
+            mLogicDev.destroyFramebuffer( framebuffer );
+        for ( auto && imageView : retired.imageViews )
+            mLogicDev.destroyImageView( imageView );
+        retired.framebuffers.clear();
+        retired.imageViews.clear();
+        if ( retired.renderPass ) {
+            mLogicDev.destroyPipeline( retired.compositorPipeline );
+            mLogicDev.destroyRenderPass( retired.renderPass );
+            retired.renderPass = nullptr;
+        }
+    }
 
-    fillCmdBuffers(
-    mQueueConfigs.at( 0 ).queueFamilyIndex, mCommandBuffers, mSwapchainImages );
+    // The present serial comes after the last serial, the rest is gone by now.
+    std::erase_if( mRetiredSwapchains, [ this ]( const RetiredSwapchain & retired ) {
+        if ( !retired.presentSerial || *retired.presentSerial > mCompletedSerial )
+            return false;
+        mLogicDev.destroySwapchainKHR( retired.swapchain );
+        return true;
+    } );
 }
 
-void VulkanGraphicRender::printSurfaceExtents() const {
-    std::cout << mGpu.getSurfaceCapabilitiesKHR( mSurface ).currentExtent.width << "X"
-              << mGpu.getSurfaceCapabilitiesKHR( mSurface ).currentExtent.height
-              << std::endl
-              << std::endl;
+bool VulkanGraphicRender::handleEvent( const xcb_generic_event_t & event ) {
+    // The capture follows other windows, the rest only concerns the own one.
+    const bool captureChanged = mWindowCapture && mWindowCapture->handleEvent( event );
+    if ( ( event.response_type & ~0x80 ) != XCB_CONFIGURE_NOTIFY )
+        return captureChanged;
+
+    const auto & configure =
+    reinterpret_cast< const xcb_configure_notify_event_t & >( event );
+    if ( configure.window != mXcbWindow ||
+         ( configure.width == mSwapchainExtent.width &&
+           configure.height == mSwapchainExtent.height ) )
+        return captureChanged;
+
+    mSwapchainDirty = true;
+    return true;
 }
 
-namespace {
+void VulkanGraphicRender::resize( vk::Extent2D extent ) {
+    if ( !mXcbConnect ) {
+        mFallbackExtent = extent;
+        mSwapchainDirty = true;
+        return;
+    }
 
-template < class Renderer > concept HasDrawMethod = requires( Renderer renderer ) {
-    { renderer.draw() };
-};
+    const std::uint32_t size[] = { extent.width, extent.height };
+    xcb_configure_window(
+    mXcbConnect, mXcbWindow, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, size );
+    xcb_flush( mXcbConnect );
+}
 
-template < HasDrawMethod Renderer >
-void runRenderLoop( Renderer renderer, xcbwraper::XCBConnect xcbConnect ) {
-    for ( bool breakLoop = false; !breakLoop; ) {
-        renderer.draw();
-        auto event =
-        xcb_poll_for_event( static_cast< xcb_connection_t * >( xcbConnect ) );
-        if ( !event )
-            continue;
-        //for ( auto event = xcb_poll_for_event( xcbConnect ); event != nullptr;
-        //      event      = xcb_poll_for_event( xcbConnect ) ) {
-        switch ( event->response_type & ~0x80 ) {
-            //case XCB_EXPOSE: renderer.draw(); break;
-
-        case XCB_KEY_PRESS:
-            if ( reinterpret_cast< xcb_key_press_event_t * >( event )->detail == 24 ) {
-                breakLoop = true;
-            }
+void VulkanGraphicRender::setPresentPolicy( const PresentPolicy & presentPolicy ) {
+    mPresentPolicy  = presentPolicy;
+    mSwapchainDirty = true;
+}
+
+const VulkanGraphicRender::PresentPolicy & VulkanGraphicRender::presentPolicy() const {
+    return mPresentPolicy;
+}
+
+vk::PresentModeKHR VulkanGraphicRender::presentMode() const { return mPresentMode; }
+
+bool VulkanGraphicRender::incrementalPresent() const { return mIncrementalPresent; }
+
+void VulkanGraphicRender::setFrameRecorder( FrameRecorder recorder ) {
+    mFrameRecorder = std::move( recorder );
+}
+
+void VulkanGraphicRender::setAfterPassRecorder( FrameRecorder recorder ) {
+    mAfterPassRecorder = std::move( recorder );
+}
+
+void VulkanGraphicRender::scheduleQueueWork( QueueType type, QueueWork work ) {
+    mQueueWork.at( static_cast< std::size_t >( type ) ).push_back( std::move( work ) );
+}
+
+MemoryAllocator & VulkanGraphicRender::allocator() { return *mAllocator; }
+
+bool VulkanGraphicRender::uploadImage( const ImageUpload & upload ) {
+    using CoordType = xcbwraper::Region::CoordType;
+    mUploadDamage.reset( xcbwraper::Region::Box {
+    0,
+    0,
+    static_cast< CoordType >( upload.extent.width ),
+    static_cast< CoordType >( upload.extent.height ) } );
+    if ( upload.damage )
+        mUploadDamage.intersect( *upload.damage );
+    if ( mUploadDamage.isEmpty() )
+        return true;
+
+    // Copy offsets are multiples of the texel size and of 4, with a power of two
+    // texel size the larger of both. Every box starts at the next such offset
+    // behind the previous one.
+    const auto alignment = std::max< vk::DeviceSize >( upload.bytesPerPixel, 4 );
+    auto       boxSize   = [ & ]( const xcbwraper::Region::Box & box ) {
+        return vk::DeviceSize { upload.bytesPerPixel } *
+               static_cast< std::uint32_t >( box.x2 - box.x1 ) *
+               static_cast< std::uint32_t >( box.y2 - box.y1 );
+    };
+    vk::DeviceSize size = 0;
+    for ( auto && box : mUploadDamage.boxes() )
+        size = alignUp( size, alignment ) + boxSize( box );
+
+    const auto span = mStaging->allocate( size, alignment );
+    if ( !span )
+        return false;
+
+    const auto     firstCopy = mUploadCopies.size();
+    vk::DeviceSize offset    = 0;
+    for ( auto && box : mUploadDamage.boxes() ) {
+        const auto   width   = static_cast< std::uint32_t >( box.x2 - box.x1 );
+        const auto   height  = static_cast< std::uint32_t >( box.y2 - box.y1 );
+        const auto   rowSize = std::size_t { upload.bytesPerPixel } * width;
+        const auto * source  = upload.pixels +
+                              static_cast< std::size_t >( box.y1 ) * upload.rowPitch +
+                              static_cast< std::size_t >( box.x1 ) * upload.bytesPerPixel;
+        offset = alignUp( offset, alignment );
+        for ( std::uint32_t row = 0; row < height; ++row )
+            std::memcpy( span->data + offset + row * rowSize,
+                         source + row * upload.rowPitch,
+                         rowSize );
+
+        mUploadCopies.push_back( vk::BufferImageCopy {
+        .bufferOffset      = span->offset + offset,
+        .bufferRowLength   = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource  = vk::ImageSubresourceLayers {
+        .aspectMask     = vk::ImageAspectFlagBits::eColor,
+        .mipLevel       = 0,
+        .baseArrayLayer = 0,
+        .layerCount     = 1 },
+        .imageOffset = vk::Offset3D { .x = box.x1, .y = box.y1, .z = 0 },
+        .imageExtent = vk::Extent3D { .width = width, .height = height, .depth = 1 } } );
+        offset += rowSize * height;
+    }
+    // An image uploaded before in this frame is where that upload leaves it, the
+    // caller's layout would discard the earlier pixels.
+    const bool pending =
+    std::any_of( mUploads.begin(), mUploads.end(), [ & ]( const PendingUpload & other ) {
+        return other.image == upload.image;
+    } );
+    mUploads.push_back(
+    PendingUpload { .image       = upload.image,
+                    .layout      = pending ? vk::ImageLayout::eShaderReadOnlyOptimal
+                                           : upload.layout,
+                    .firstCopy   = firstCopy,
+                    .copiesCount = mUploadCopies.size() - firstCopy } );
+    return true;
+}
+
+const StagingRing & VulkanGraphicRender::stagingRing() const { return *mStaging; }
+
+LinearArena * VulkanGraphicRender::frameArena() {
+    // Between frames the slot's arena may still be read by the GPU, and the
+    // next acquireImage() resets it.
+    assert( mRecording && "frameArena() is called outside of the recorders" );
+    return mRecording ? mFrames.at( mCurrentFrame ).arena.get() : nullptr;
+}
+
+WindowCapture * VulkanGraphicRender::windowCapture() { return mWindowCapture.get(); }
+
+Compositor & VulkanGraphicRender::compositor() {
+    if ( !mCompositor ) {
+        mCompositor = std::make_unique< Compositor >(
+        Compositor::CreateInfo { .logicDev           = mLogicDev,
+                                 .gpu                = &mGpuInfo,
+                                 .allocator          = mAllocator.get(),
+                                 .renderPass         = mRenderPass,
+                                 .pipelineCache      = mPipelineCache->cache(),
+                                 .framesInFlight     = mFrames.size(),
+                                 .nonUniformIndexing = mNonUniformIndexing } );
+        // The next start finds the pipelines even if this run does not end well.
+        mPipelineCache->save();
+    }
+    return *mCompositor;
+}
+
+PipelineCache & VulkanGraphicRender::pipelineCache() { return *mPipelineCache; }
+
+const VulkanGraphicRender::RecordStats & VulkanGraphicRender::recordStats() const {
+    return mRecordStats;
+}
+
+FrameTimer & VulkanGraphicRender::frameTimer() { return mFrameTimer; }
+
+const FrameTimer & VulkanGraphicRender::frameTimer() const { return mFrameTimer; }
+
+bool VulkanGraphicRender::gpuTimestamps() const { return bool( mTimestampPool ); }
+
+void VulkanGraphicRender::collectTiming( FrameSync & frame, std::size_t slot ) {
+    if ( !frame.timingPending )
+        return;
+    frame.timingPending = false;
+
+    auto & sample = frame.timing;
+    sample.hasGpu = false;
+    if ( mTimestampPool ) {
+        std::array< std::uint64_t, 2 > timestamps {};
+        // The fence is signaled, so the queries are available and nothing waits.
+        const auto result =
+        mLogicDev.getQueryPoolResults( mTimestampPool,
+                                       static_cast< std::uint32_t >( 2 * slot ),
+                                       2,
+                                       sizeof( timestamps ),
+                                       timestamps.data(),
+                                       sizeof( std::uint64_t ),
+                                       vk::QueryResultFlagBits::e64 );
+        if ( result == vk::Result::eSuccess ) {
+            const auto ticks = ( timestamps[ 1 ] - timestamps[ 0 ] ) & mTimestampMask;
+            sample[ FrameTimer::Phase::eGpu ] = {
+                .begin    = sample[ FrameTimer::Phase::eSubmit ].begin,
+                .duration = std::chrono::nanoseconds( static_cast< std::int64_t >(
+                static_cast< double >( ticks ) * mTimestampPeriod ) )
+            };
+            sample.hasGpu = true;
         }
-        delete event;
     }
+    mFrameTimer.add( sample );
+}
+
+void VulkanGraphicRender::setLayerRecorder( std::size_t   layersCount,
+                                            LayerRecorder recorder,
+                                            std::size_t   threadsCount ) {
+    if ( !recorder ) {
+        if ( mRecordScheduler ) {
+            // The worker pools may still own buffers of frames in flight.
+            mLogicDev.waitIdle();
+            mRecordScheduler.reset();
+        }
+        mLayersCount        = 0;
+        mLayerRecorder      = {};
+        mLayerRangeRecorder = {};
+        return;
+    }
+    if ( threadsCount == 0 )
+        throw std::runtime_error( "VulkanGraphicRender::setLayerRecorder(): "
+                                  "threadsCount must be non-zero." );
+
+    if ( !mRecordScheduler || mRecordScheduler->threadsCount() != threadsCount ) {
+        mLogicDev.waitIdle();
+        mRecordScheduler.reset();
+        mRecordScheduler = std::make_unique< RecordScheduler >(
+        RecordScheduler::CreateInfo { .logicDev = mLogicDev,
+                                      .queueFamilyIndex =
+                                      mQueueConfigs.at( 0 ).queueFamilyIndex,
+                                      .framesInFlight = mFrames.size(),
+                                      .threadsCount   = threadsCount } );
+    }
+
+    mLayersCount   = layersCount;
+    mLayerRecorder = std::move( recorder );
+
+    // Built once, the per frame state is read from the members.
+    mLayerRangeRecorder = [ this ]( const vk::CommandBuffer & commandBuffer,
+                                    std::size_t               first,
+                                    std::size_t               last ) {
+        const FrameContext context { .commandBuffer = commandBuffer,
+                                     .imageIndex    = mRecordingImage,
+                                     .image = mSwapchainImages.at( mRecordingImage ),
+                                     .frameSlot = mCurrentFrame,
+                                     .extent        = mSwapchainExtent,
+                                     .repaint = mImagesDamage.at( mRecordingImage ) };
+        for ( auto layer = first; layer < last; ++layer )
+            mLayerRecorder( context, layer );
+    };
+}
+
+void VulkanGraphicRender::createImageTargets() {
+    for ( auto && image : mSwapchainImages ) {
+        const auto imageView = mLogicDev.createImageView( vk::ImageViewCreateInfo {
+        .image    = image,
+        .viewType = vk::ImageViewType::e2D,
+        .format   = mSwapchainFormat,
+        .subresourceRange =
+        vk::ImageSubresourceRange { .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                    .baseMipLevel   = 0,
+                                    .levelCount     = 1,
+                                    .baseArrayLayer = 0,
+                                    .layerCount     = 1 } } );
+        mImageViews.push_back( imageView );
+
+        mFramebuffers.push_back( mLogicDev.createFramebuffer(
+        vk::FramebufferCreateInfo { .renderPass      = mRenderPass,
+                                    .attachmentCount = 1,
+                                    .pAttachments    = &imageView,
+                                    .width           = mSwapchainExtent.width,
+                                    .height          = mSwapchainExtent.height,
+                                    .layers          = 1 } ) );
+    }
+}
+
+void VulkanGraphicRender::destroyImageTargets() {
+    for ( auto && framebuffer : mFramebuffers )
+        mLogicDev.destroyFramebuffer( framebuffer );
+    for ( auto && imageView : mImageViews )
+        mLogicDev.destroyImageView( imageView );
+    mFramebuffers.clear();
+    mImageViews.clear();
+}
+
+void VulkanGraphicRender::resetImagesDamage() {
+    mImagesDamage.assign( mSwapchainImages.size(), xcbwraper::Region( imageBox() ) );
+}
+
+xcbwraper::Region::Box VulkanGraphicRender::imageBox() const {
+    using CoordType = xcbwraper::Region::CoordType;
+    return xcbwraper::Region::Box { 0,
+                                    0,
+                                    static_cast< CoordType >( mSwapchainExtent.width ),
+                                    static_cast< CoordType >( mSwapchainExtent.height ) };
+}
+
+void VulkanGraphicRender::printSurfaceExtents() {
+    const auto & extent = mSurfaceInfo->capabilities().currentExtent;
+    std::cout << extent.width << "X" << extent.height << std::endl << std::endl;
 }
-}   // namespace
 
 VulkanRenderInstance::Shared VulkanRenderInstance::init() {
     if ( !mInstance )
@@ -469,14 +1363,37 @@ mXcbConnect( std::make_shared< xcbwraper::XCBConnect >() ) {
 
 VulkanRenderInstance::~VulkanRenderInstance() = default;
 
-void VulkanRenderInstance::run() const {
+VulkanRenderInstance::XcbConnectShared VulkanRenderInstance::xcbConnect() const {
+    return mXcbConnect;
+}
+
+void VulkanRenderInstance::setHeadless( std::optional< vk::Extent2D > extent ) {
+    mHeadlessExtent = extent;
+}
+
+bool VulkanRenderInstance::headless() const { return mHeadlessExtent.has_value(); }
+
+RenderLoopStats VulkanRenderInstance::run( const RenderLoopConfig & loopConfig,
+                                           const RendererHook &     onCreate,
+                                           const RendererHook &     onDestroy ) const {
+    if ( mHeadlessExtent )
+        return runRenderer(
+        VulkanGraphicRender::CreateInfo { .xcbConnect     = nullptr,
+                                          .xcbWindow      = XCB_NONE,
+                                          .fallbackExtent = *mHeadlessExtent },
+        { VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME },
+        loopConfig,
+        onCreate,
+        onDestroy );
+
     auto screen = xcb_setup_roots_iterator(
                   xcb_get_setup( static_cast< xcb_connection_t * >( *mXcbConnect ) ) )
                   .data;
     assert( screen != nullptr && "xcb_setup_roots_iterator return nullptr" );
 
     std::uint32_t winValList[] = {
-        /*XCB_EVENT_MASK_EXPOSURE |*/ XCB_EVENT_MASK_KEY_PRESS
+        XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY |
+        XCB_EVENT_MASK_KEY_PRESS
     };
 
     //    auto overlayReply = xcb_composite_get_overlay_window_reply(
@@ -510,15 +1427,34 @@ void VulkanRenderInstance::run() const {
 
     xcb_flush( static_cast< xcb_connection_t * >( *mXcbConnect ) );
 
+    const auto loopStats = runRenderer(
+    VulkanGraphicRender::CreateInfo { .xcbConnect = *mXcbConnect, .xcbWindow = window },
+    { VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_XCB_SURFACE_EXTENSION_NAME },
+    loopConfig,
+    onCreate,
+    onDestroy );
+
+    xcb_destroy_window( static_cast< xcb_connection_t * >( *mXcbConnect ), window );
+    xcb_flush( static_cast< xcb_connection_t * >( *mXcbConnect ) );
+
+    return loopStats;
+}
+
+RenderLoopStats
+VulkanRenderInstance::runRenderer( VulkanGraphicRender::CreateInfo && renderCreateInfo,
+                                   ExtensionsVec &&                   instanceExtensions,
+                                   const RenderLoopConfig &           loopConfig,
+                                   const RendererHook &               onCreate,
+                                   const RendererHook &               onDestroy ) const {
     auto appInfo = std::make_unique< vk::ApplicationInfo >(
     vk::ApplicationInfo { .pApplicationName   = "vulkan_xcb",
                           .applicationVersion = VK_MAKE_VERSION( 0, 0, 1 ),
                           .pEngineName        = "vulkan_xcb_engine",
                           .engineVersion      = VK_MAKE_VERSION( 0, 0, 1 ),
-                          .apiVersion         = VK_API_VERSION_1_0 } );
+                          .apiVersion         = VK_API_VERSION_1_2 } );
 
     core::renderer::VulkanBase::Extensions extensions {
-        .instance = { VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_XCB_SURFACE_EXTENSION_NAME },
+        .instance = std::move( instanceExtensions ),
         .device   = { VK_KHR_SWAPCHAIN_EXTENSION_NAME }
     };
     vk::Instance vulkanXCBInstance = vk::createInstance( vk::InstanceCreateInfo {
@@ -526,19 +1462,29 @@ void VulkanRenderInstance::run() const {
     .enabledExtensionCount   = static_cast< std::uint32_t >( extensions.instance.size() ),
     .ppEnabledExtensionNames = extensions.instance.data() } );
 
-    auto gpu = core::renderer::getDiscreteGpu( vulkanXCBInstance );
+    // No device, the renderer selects one once its surface exists.
     core::renderer::VulkanBase::CreateInfo vulkanBaseCI { .instance   = vulkanXCBInstance,
-                                                          .physDev    = gpu,
                                                           .extansions = extensions };
-    core::renderer::VulkanGraphicRender::CreateInfo vulkanRenderCI {
-        .xcbConnect = *mXcbConnect, .xcbWindow = window
-    };
+    auto * const xcbConnect = renderCreateInfo.xcbConnect;
 
-    core::renderer::VulkanGraphicRender renderer( std::move( vulkanBaseCI ),
-                                                  std::move( vulkanRenderCI ) );
-    runRenderLoop< VulkanGraphicRender >( renderer, *mXcbConnect );
+    // The renderer destroys its device, the instance is this call's. Runs of
+    // one process must not pile up instances.
+    RenderLoopStats loopStats;
+    try {
+        core::renderer::VulkanGraphicRender renderer( std::move( vulkanBaseCI ),
+                                                      std::move( renderCreateInfo ) );
+        if ( onCreate )
+            onCreate( renderer );
+        loopStats =
+        runRenderLoop< VulkanGraphicRender >( renderer, xcbConnect, loopConfig );
+        if ( onDestroy )
+            onDestroy( renderer );
+    } catch ( ... ) {
+        vulkanXCBInstance.destroy();
+        throw;
+    }
+    vulkanXCBInstance.destroy();
 
-    xcb_destroy_window( static_cast< xcb_connection_t * >( *mXcbConnect ), window );
-    xcb_flush( static_cast< xcb_connection_t * >( *mXcbConnect ) );
+    return loopStats;
 }
 }   // namespace core::renderer
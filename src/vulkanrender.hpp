@@ -1,6 +1,13 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 
 #include <vulkan/vulkan_core.h>
@@ -14,6 +21,18 @@
 #include <vulkan/vulkan.hpp>
 
 #include "composite.hpp"
+#include "compositor.hpp"
+#include "frametimer.hpp"
+#include "gpuselector.hpp"
+#include "memoryallocator.hpp"
+#include "pipelinecache.hpp"
+#include "queueownership.hpp"
+#include "recordscheduler.hpp"
+#include "renderloop.hpp"
+#include "stagingring.hpp"
+#include "surfaceinfocache.hpp"
+#include "windowcapture.hpp"
+#include "xcb_wraper/region.hpp"
 #include "xcb_wraper/xcbconnect.hpp"
 
 namespace core::renderer {
@@ -22,7 +41,11 @@ using ExtensionsVec          = std::vector< const char * >;
 using DeviceQueueCreateInfos = std::vector< vk::DeviceQueueCreateInfo >;
 using QueueFamilyIndex       = std::uint32_t;
 using SemaphoresVec          = std::vector< vk::Semaphore >;
+using FencesVec              = std::vector< vk::Fence >;
 using ImageVec               = std::vector< vk::Image >;
+using ImageViewsVec          = std::vector< vk::ImageView >;
+using FramebuffersVec        = std::vector< vk::Framebuffer >;
+using RegionsVec             = std::vector< xcbwraper::Region >;
 using QueuesVec              = std::vector< vk::Queue >;
 using QueuesPriority         = float;
 using QueuesPrioritiesVec    = std::vector< QueuesPriority >;
@@ -30,6 +53,11 @@ using CommandBuffersVec      = std::vector< vk::CommandBuffer >;
 
 class VulkanBase {
 public:
+    // What a queue is used for. Types without a family of their own run on the
+    // graphics queue.
+    enum class QueueType : std::size_t { eGraphics, eTransfer, eCompute };
+    static constexpr std::size_t queueTypesCount = 3;
+
     struct QueueTypeConfig final {
         QueueFamilyIndex    queueFamilyIndex;
         QueuesPrioritiesVec priorities;
@@ -49,15 +77,30 @@ public:
     using QueueTypeConfigsVec = std::vector< QueueTypeConfig >;
 
     explicit VulkanBase( CreateInfo && );
-    explicit VulkanBase( const VulkanBase & ) = default;
-    explicit VulkanBase( VulkanBase && )      = default;
-    VulkanBase & operator=( const VulkanBase & ) = default;
-    VulkanBase & operator=( VulkanBase && ) = default;
+    // Owns the logical device.
+    VulkanBase( const VulkanBase & ) = delete;
+    VulkanBase & operator=( const VulkanBase & ) = delete;
+    // Destroys the logical device, after the members of the derived renderer
+    // that were created from it are gone. The instance stays the caller's.
     virtual ~VulkanBase();
 
+    [[nodiscard]] const vk::Queue & queue( QueueType type ) const;
+    [[nodiscard]] QueueFamilyIndex  queueFamily( QueueType type ) const;
+    // True when the type has a queue family of its own.
+    [[nodiscard]] bool dedicatedQueue( QueueType type ) const;
+    // Ownership transfer from the queue of one type to the queue of another.
+    [[nodiscard]] QueueOwnership queueOwnership( QueueType              from,
+                                                 QueueType              to,
+                                                 vk::PipelineStageFlags srcStage,
+                                                 vk::PipelineStageFlags dstStage ) const;
+
 protected:
     static constexpr std::uint8_t nBuffers = 3;
 
+    // Adds a config of one queue in the family for the type. Types that are
+    // never added use the first config, which must be the graphics one.
+    void addQueue( QueueType type, QueueFamilyIndex queueFamilyIndex );
+
     //ExtensionsVec instanseExtensions {
     //    VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_XCB_SURFACE_EXTENSION_NAME /*,
     //    VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME,
@@ -70,41 +113,393 @@ protected:
 
     vk::Instance       mInstance;
     vk::PhysicalDevice mGpu;
-    vk::CommandPool    mCommandPool;
+    // Created by the derived renderer once it chose the GPU.
+    vk::Device         mLogicDev;
 
-    Extensions        mExtansions;
-    CommandBuffersVec mCommandBuffers;
-    QueuesVec         mQueues;
+    Extensions mExtansions;
+    QueuesVec  mQueues;
 
+    // One queue per config, the graphics one first.
     QueueTypeConfigsVec mQueueConfigs;
+    // Per queue type, the index of its config and queue.
+    std::array< std::size_t, queueTypesCount > mQueueTypes {};
 };
 
 class VulkanGraphicRender : public VulkanBase {
 public:
+    // How the swapchain trades latency against power and throughput. Modes the
+    // surface does not support fall back to FIFO, image counts are clamped to
+    // the surface limits.
+    struct PresentPolicy final {
+        enum class Latency {
+            // Mailbox, else FIFO, with the fewest images that do not block. Never
+            // tears, immediate has to be asked for through presentMode.
+            eLowLatency,
+            // FIFO with the fewest images.
+            ePowerSaving,
+            // FIFO relaxed, else FIFO, with imageCount images.
+            eThroughput
+        };
+
+        Latency       latency { Latency::eLowLatency };
+        std::uint32_t imageCount { 3 };
+        // Takes precedence over latency when the surface supports it.
+        std::optional< vk::PresentModeKHR > presentMode {};
+    };
+
+    // A null xcbConnect renders headless, into a VK_EXT_headless_surface
+    // swapchain, and the window is ignored.
     struct CreateInfo final {
-        xcbwraper::XCBConnect xcbConnect;
+        xcb_connection_t * xcbConnect;
         xcb_window_t       xcbWindow;
+        std::uint8_t       framesInFlight = nBuffers;
+        PresentPolicy      presentPolicy {};
+        // Swapchain size when the surface leaves it to the application.
+        vk::Extent2D fallbackExtent { .width = 600, .height = 300 };
+        // False keeps transfer and compute work on the graphics queue even when
+        // the device has families for them.
+        bool dedicatedQueues { true };
+        // Host visible arena of every frame slot, zero for none.
+        vk::DeviceSize frameArenaSize { vk::DeviceSize { 1 } << 20 };
+        // Staging ring of the uploads of the frames in flight, a full 4K image
+        // takes 32 MiB. A multiple of 4.
+        vk::DeviceSize stagingSize { vk::DeviceSize { 64 } << 20 };
+        // Redirects the top level windows and captures the tracked ones, needs
+        // an X connection.
+        bool captureWindows { false };
+        // Presents into the Composite overlay window, above every other window,
+        // instead of xcbWindow. Captured windows are then redirected manually,
+        // the frames are the only thing the X server shows of them.
+        bool presentToOverlay { false };
+        // Where the pipeline cache persists between runs, empty keeps it in
+        // memory.
+        std::filesystem::path pipelineCacheDir { PipelineCache::defaultDirectory() };
+    };
+
+    // What a frame recorder works with, valid only during the call.
+    struct FrameContext final {
+        vk::CommandBuffer commandBuffer;
+        std::uint32_t     imageIndex;
+        // The acquired swapchain image, a transfer source where the surface
+        // allows it.
+        vk::Image image;
+        // Slot of the frame, for Compositor::record().
+        std::size_t  frameSlot;
+        vk::Extent2D extent;
+        // Pixels repainted this frame, drawing outside of them is not tracked.
+        const xcbwraper::Region & repaint;
+    };
+
+    // Records the caller's work for one frame. It runs inside the render pass on
+    // the acquired image, after the repainted pixels were cleared.
+    using FrameRecorder = std::function< void( const FrameContext & ) >;
+    // Records one layer into the secondary buffer of the context. Runs on the
+    // worker threads, concurrently for different layers.
+    using LayerRecorder =
+    std::function< void( const FrameContext &, std::size_t layer ) >;
+
+    using QueueRecorder = std::function< void( const vk::CommandBuffer & ) >;
+
+    // Transfer or compute work that the graphics work of a frame reads, such as
+    // uploads and compute passes.
+    struct QueueWork final {
+        // Records the work. On a dedicated queue it ends with the release halves
+        // of the ownership transfers, see queueOwnership().
+        QueueRecorder record;
+        // Records the acquire halves into the frame's buffer before the render
+        // pass, may be empty.
+        QueueRecorder acquire;
+        // Graphics stages that wait for the work.
+        vk::PipelineStageFlags waitStage { vk::PipelineStageFlagBits::eAllCommands };
+    };
+
+    // Pixels for a 2D color image with one mip level and layer.
+    struct ImageUpload final {
+        vk::Image    image;
+        vk::Extent2D extent;
+        // In the image's format, rows of rowPitch bytes.
+        const std::byte * pixels;
+        std::size_t       rowPitch;
+        // A power of two.
+        std::uint32_t bytesPerPixel { 4 };
+        // Null uploads the whole image.
+        const xcbwraper::Region * damage { nullptr };
+        // Undefined the first time, the upload leaves the image readable by
+        // fragment shaders. Ignored when the image was uploaded before in the
+        // same frame.
+        vk::ImageLayout layout { vk::ImageLayout::eShaderReadOnlyOptimal };
+    };
+
+    struct RecordStats final {
+        std::uint64_t            frames { 0 };
+        std::chrono::nanoseconds recordTime { 0 };
+        // Queue submit and present calls.
+        std::chrono::nanoseconds submitTime { 0 };
     };
 
     VulkanGraphicRender( VulkanBase::CreateInfo &&          baseInfo,
                          VulkanGraphicRender::CreateInfo && graphicRenderCreateInfo );
+    VulkanGraphicRender( const VulkanGraphicRender & ) = delete;
+    VulkanGraphicRender & operator=( const VulkanGraphicRender & ) = delete;
 
     virtual ~VulkanGraphicRender();
+    // Repaints the whole image.
     void draw();
+    // Repaints only the damaged pixels plus whatever changed while the acquired
+    // image was not on screen. Returns the area of the repainted region.
+    std::uint64_t draw( const xcbwraper::Region & damage );
+    // Replaces the swapchain without waiting for the device, the old one is
+    // destroyed once the frames submitted to it are done.
     void update();
-    void printSurfaceExtents() const;
+    void printSurfaceExtents();
+
+    // Returns true when the event resized the window or changed a captured
+    // one. A resize recreates the swapchain before the next acquire instead of
+    // after a failed present.
+    bool handleEvent( const xcb_generic_event_t & event );
+    // Resizes the window, whose ConfigureNotify then recreates the swapchain,
+    // or the headless swapchain on the next acquire.
+    void resize( vk::Extent2D extent );
+
+    // Takes effect on the next acquire, which recreates the swapchain.
+    void setPresentPolicy( const PresentPolicy & policy );
+    [[nodiscard]] const PresentPolicy & presentPolicy() const;
+    // Mode of the current swapchain.
+    [[nodiscard]] vk::PresentModeKHR presentMode() const;
+
+    // True when presents carry the damaged rectangles to the presentation engine.
+    bool incrementalPresent() const;
+
+    // The recorder is called for every drawn frame, an empty one records nothing.
+    void                setFrameRecorder( FrameRecorder recorder );
+    // Called for every drawn frame after the render pass, with the image in the
+    // present layout, e.g. to copy the frame out.
+    void                setAfterPassRecorder( FrameRecorder recorder );
+    const RecordStats & recordStats() const;
+
+    // Splits the layers of every frame over threadsCount recording threads. The
+    // layers are executed in index order after the frame recorder, an empty
+    // recorder goes back to recording on the calling thread only. Otherwise
+    // threadsCount must be non-zero.
+    void setLayerRecorder( std::size_t   layersCount,
+                           LayerRecorder recorder,
+                           std::size_t   threadsCount );
+
+    // Runs the work with the next drawn frame. On a dedicated queue it is
+    // submitted before the frame's graphics work, which waits for it through a
+    // semaphore, and overlaps the graphics work of the frames still queued.
+    // Otherwise it is recorded into the frame's buffer ahead of the render pass.
+    void scheduleQueueWork( QueueType type, QueueWork work );
+
+    // Memory of the device for images and buffers.
+    [[nodiscard]] MemoryAllocator & allocator();
+    // Host visible memory for data of the frame being recorded, only to be
+    // called from the frame, layer and queue work recorders. Allocations live
+    // until the frame is done on the GPU, the arena is reset when its slot is
+    // acquired again. Null outside of the recorders and when
+    // CreateInfo::frameArenaSize is zero.
+    [[nodiscard]] LinearArena * frameArena();
+    // Copies the damaged boxes of the pixels into the staging ring right away,
+    // and records their copies into the next drawn frame before its render
+    // pass. False when the frames in flight hold too much of the ring, the
+    // upload has to be repeated later.
+    [[nodiscard]] bool uploadImage( const ImageUpload & upload );
+    [[nodiscard]] const StagingRing & stagingRing() const;
+
+    // Null unless CreateInfo::captureWindows. Every drawn frame acquires the
+    // captures before its render pass and releases them after it.
+    [[nodiscard]] WindowCapture * windowCapture();
+    // Draws layers from the frame recorder, built for the current render pass.
+    // Created by the first call, renderers that draw no layers never build its
+    // pipeline.
+    [[nodiscard]] Compositor & compositor();
+    // For every pipeline of the device, saved when the renderer is destroyed
+    // and whenever the renderer built new pipelines.
+    [[nodiscard]] PipelineCache & pipelineCache();
+
+    // Per frame CPU phase times and, with timestamp support on the graphics
+    // queue, GPU times of the presented frames.
+    [[nodiscard]] FrameTimer &       frameTimer();
+    [[nodiscard]] const FrameTimer & frameTimer() const;
+    [[nodiscard]] bool               gpuTimestamps() const;
 
 protected:
+    // A frame slot's share of a dedicated transfer or compute queue.
+    struct QueueSlot final {
+        vk::CommandPool   commandPool;
+        vk::CommandBuffer commandBuffer;
+        // Signaled by the work, waited by the frame's graphics submit.
+        vk::Semaphore          done;
+        vk::PipelineStageFlags waitStage {};
+        bool                   pending { false };
+    };
+
+    // Synchronization objects of one frame slot. A slot is reused only after its
+    // fence is signaled, so up to mFrames.size() frames may be queued on the GPU.
+    // The command buffer is recorded anew for every frame from a pool of its
+    // own, which is reset as a whole once the fence says the GPU is done.
+    struct FrameSync final {
+        vk::Semaphore     imageAvailable;
+        vk::Semaphore     renderFinished;
+        vk::Fence         inFlight;
+        vk::CommandPool   commandPool;
+        vk::CommandBuffer commandBuffer;
+        // Secondary buffer for the clears and the frame recorder, used when
+        // the layers are recorded into secondary buffers too.
+        vk::CommandBuffer baseCommandBuffer;
+        // Serial of the last submission that signals inFlight.
+        std::uint64_t submittedSerial { 0 };
+        // Timings of the submitted frame, added to the timer with the GPU time
+        // once the fence is signaled.
+        FrameTimer::Sample timing {};
+        bool               timingPending { false };
+        // Per queue type, null for the types that run on the graphics queue. The
+        // graphics submit waits for the work, so the slot's fence covers it.
+        std::array< QueueSlot, queueTypesCount > queues {};
+        // Reset with the command pool.
+        std::unique_ptr< LinearArena > arena;
+    };
+
+    // A swapchain replaced by update(), with what was created for its images.
+    struct RetiredSwapchain final {
+        vk::SwapchainKHR swapchain;
+        ImageViewsVec    imageViews;
+        FramebuffersVec  framebuffers;
+        // Only set when the new swapchain needed another render pass, with the
+        // compositor pipeline built for the old one.
+        vk::RenderPass renderPass;
+        vk::Pipeline   compositorPipeline;
+        // What was created for the images is destroyed once the submission
+        // with this serial is done.
+        std::uint64_t lastSerial;
+        // Fences do not cover presents. The swapchain is destroyed once a frame
+        // submitted after the first present to its successor is done, this is
+        // that frame's serial. Empty until that present.
+        std::optional< std::uint64_t > presentSerial {};
+    };
+
+    // An image upload whose pixels are in the staging ring, with its range of
+    // mUploadCopies.
+    struct PendingUpload final {
+        vk::Image       image;
+        vk::ImageLayout layout;
+        std::size_t     firstCopy;
+        std::size_t     copiesCount;
+    };
+
+    using FrameSyncsVec        = std::vector< FrameSync >;
+    using RetiredSwapchainsVec = std::vector< RetiredSwapchain >;
+
+    [[nodiscard]] std::optional< std::uint32_t > acquireImage( FrameSync & frame );
+    // Repaints the pending damage of the image and presents it.
+    void renderFrame( FrameSync &   frame,
+                      std::uint32_t imageIndex,
+                      bool          discard,
+                      const void *  presentNext );
+    void recordFrame( FrameSync &               frame,
+                      std::uint32_t             imageIndex,
+                      const xcbwraper::Region & repaint,
+                      bool                      discard );
+    // Records the scheduled work, on the queues of their own or into the frame's
+    // buffer, and the acquire halves into the frame's buffer.
+    void recordQueueWork( FrameSync & frame );
+    // Records the copies of the pending image uploads.
+    void recordUploads( const vk::CommandBuffer & commandBuffer );
+    void recordRepaint( const vk::CommandBuffer & commandBuffer,
+                        std::uint32_t             imageIndex,
+                        const xcbwraper::Region & repaint );
+    void submitAndPresent( FrameSync &   frame,
+                           std::uint32_t imageIndex,
+                           const void *  presentNext );
+    void releaseRetiredSwapchains();
+    // Adds the pending timings of the slot, its fence must be signaled.
+    void collectTiming( FrameSync & frame, std::size_t slot );
+
+    void createImageTargets();
+    void destroyImageTargets();
+    // Marks every image as fully stale, as after (re)creating the swapchain.
+    void resetImagesDamage();
+    [[nodiscard]] xcbwraper::Region::Box imageBox() const;
+
     vk::SurfaceKHR   mSurface;
     vk::SwapchainKHR mSwapchain;
-    vk::Device       mLogicDev;
+    // The device mGpu, queried once at creation.
+    GpuInfo mGpuInfo;
+    // Outlives everything allocated from it but the device.
+    std::unique_ptr< MemoryAllocator > mAllocator;
+    std::unique_ptr< StagingRing >     mStaging;
+    std::unique_ptr< PipelineCache >   mPipelineCache;
+    // Created once the GPU is known, lives as long as the surface.
+    std::unique_ptr< SurfaceInfoCache > mSurfaceInfo;
 
 //    xcbwraper::XCBConnect mXcbConnect;
+    xcb_connection_t *    mXcbConnect;
     xcb_window_t          mXcbWindow;
+    vk::Extent2D          mFallbackExtent;
+
+    vk::Format         mSwapchainFormat { vk::Format::eUndefined };
+    vk::Extent2D       mSwapchainExtent {};
+    vk::RenderPass     mRenderPass;
+    bool               mIncrementalPresent { false };
+    PresentPolicy      mPresentPolicy {};
+    vk::PresentModeKHR mPresentMode { vk::PresentModeKHR::eFifo };
+    // Set by a resize or a suboptimal acquire/present, the next acquire recreates.
+    bool mSwapchainDirty { false };
+
+    // Graphics submissions are numbered in queue order, and the graphics queue
+    // completes them in that order, so one counter tells what the GPU is done
+    // with. Work on the other queues finishes before the frame that waits for it.
+    std::uint64_t        mSubmittedSerial { 0 };
+    std::uint64_t        mCompletedSerial { 0 };
+    RetiredSwapchainsVec mRetiredSwapchains;
 
     ImageVec             mSwapchainImages;
-    SemaphoresVec        mSemaphores;
-    composite::Composite mComposite;
+    ImageViewsVec        mImageViews;
+    FramebuffersVec      mFramebuffers;
+    FrameSyncsVec        mFrames;
+    FencesVec            mImagesInFlight;
+    std::size_t          mCurrentFrame { 0 };
+    // Only with an X connection, and windows to capture or the overlay to
+    // present to.
+    std::unique_ptr< composite::Composite > mComposite;
+    std::unique_ptr< WindowCapture >        mWindowCapture;
+    // Built by the first compositor().
+    std::unique_ptr< Compositor > mCompositor;
+    bool                          mNonUniformIndexing { false };
+
+    // Per swapchain image, the pixels that changed since it was last presented.
+    RegionsVec mImagesDamage;
+    // Scratch storage of draw( damage ), kept to avoid per frame allocations.
+    xcbwraper::Region               mFrameDamage;
+    std::vector< vk::ClearRect >    mClearRects;
+    std::vector< vk::RectLayerKHR > mPresentRects;
+
+    FrameRecorder mFrameRecorder;
+    FrameRecorder mAfterPassRecorder;
+    RecordStats   mRecordStats;
+    // Per queue type, the work scheduled for the next drawn frame.
+    std::array< std::vector< QueueWork >, queueTypesCount > mQueueWork;
+    // Image uploads for the next drawn frame.
+    std::vector< PendingUpload >          mUploads;
+    std::vector< vk::BufferImageCopy >    mUploadCopies;
+    std::vector< vk::ImageMemoryBarrier > mUploadBarriers;
+    xcbwraper::Region                     mUploadDamage;
+
+    FrameTimer mFrameTimer;
+    // Two timestamps per frame slot, null without timestamp support.
+    vk::QueryPool mTimestampPool;
+    double        mTimestampPeriod { 0.0 };
+    std::uint64_t mTimestampMask { 0 };
+
+    std::unique_ptr< RecordScheduler > mRecordScheduler;
+    RecordScheduler::RangeRecorder     mLayerRangeRecorder;
+    LayerRecorder                      mLayerRecorder;
+    std::size_t                        mLayersCount { 0 };
+    // Image whose layers the workers record right now.
+    std::uint32_t                      mRecordingImage { 0 };
+    // Set while recordFrame() runs the recorders.
+    bool                               mRecording { false };
+    std::vector< vk::CommandBuffer >   mExecutedBuffers;
 };
 
 class VulkanRenderInstance final {
@@ -112,16 +507,37 @@ class VulkanRenderInstance final {
 
 public:
     using Shared           = std::shared_ptr< VulkanRenderInstance >;
-    using XcbConnectShared = std::shared_ptr< xcbwraper::XCBConnect >;
+    using XcbConnectShared = xcbwraper::XCBConnectShared;
     ~VulkanRenderInstance();
 
-    static Shared init();
-    void          run() const;
+    // Gets the renderer of run() right after its creation or right before its
+    // destruction, to set a frame recorder or read the statistics.
+    using RendererHook = std::function< void( VulkanGraphicRender & ) >;
+
+    static Shared   init();
+    RenderLoopStats run( const RenderLoopConfig & loopConfig = {},
+                         const RendererHook &     onCreate   = {},
+                         const RendererHook &     onDestroy  = {} ) const;
+
+    // The process wide X connection, share it with the xcbwraper queries.
+    XcbConnectShared xcbConnect() const;
+
+    // With an extent run() renders headless at that size instead of into a
+    // window, so no X server is needed. An empty extent goes back to windows.
+    void               setHeadless( std::optional< vk::Extent2D > extent );
+    [[nodiscard]] bool headless() const;
 
 private:
+    RenderLoopStats runRenderer( VulkanGraphicRender::CreateInfo && renderCreateInfo,
+                                 ExtensionsVec &&                   instanceExtensions,
+                                 const RenderLoopConfig &           loopConfig,
+                                 const RendererHook &               onCreate,
+                                 const RendererHook &               onDestroy ) const;
+
     static Shared mInstance;
 
-    XcbConnectShared mXcbConnect;
+    XcbConnectShared              mXcbConnect;
+    std::optional< vk::Extent2D > mHeadlessExtent;
 };
 
 
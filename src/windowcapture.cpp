@@ -0,0 +1,756 @@
+#include "windowcapture.hpp"
+#include "xcb_wraper/xcbconnect.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <xcb/dri3.h>
+#include <xcb/shm.h>
+#include <xcb/xproto.h>
+
+namespace core::renderer {
+
+namespace {
+using xcbwraper::Region;
+using Box = Region::Box;
+
+// A window with more dirty boxes is fetched as their extents, a request per
+// box would cost more than the pixels it saves.
+constexpr std::size_t maxFetchBoxes = 16;
+constexpr std::size_t bytesPerPixel = 4;
+
+constexpr auto dmaBufHandle = vk::ExternalMemoryHandleTypeFlagBits::eDmaBufEXT;
+constexpr auto hostHandle   = vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT;
+
+constexpr vk::ImageSubresourceRange colorRange { .aspectMask =
+                                                 vk::ImageAspectFlagBits::eColor,
+                                                 .baseMipLevel   = 0,
+                                                 .levelCount     = 1,
+                                                 .baseArrayLayer = 0,
+                                                 .layerCount     = 1 };
+
+constexpr vk::ImageSubresourceLayers colorLayers { .aspectMask =
+                                                   vk::ImageAspectFlagBits::eColor,
+                                                   .mipLevel       = 0,
+                                                   .baseArrayLayer = 0,
+                                                   .layerCount     = 1 };
+
+// dma-buf import, and the explicit layout of the buffer the X server made.
+constexpr std::array< const char *, 3 > dri3Extensions {
+    VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+    VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME,
+    VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME
+};
+
+[[nodiscard]] bool hasExtensions( const GpuInfo & gpu, const auto & extensions ) {
+    return std::all_of( extensions.begin(), extensions.end(), [ & ]( const char * name ) {
+        return gpu.hasExtension( name );
+    } );
+}
+
+// The modifier extension needs Vulkan 1.2 or the extensions promoted to it.
+[[nodiscard]] bool supportsDri3( const GpuInfo & gpu ) {
+    return gpu.properties.apiVersion >= VK_API_VERSION_1_2 &&
+           hasExtensions( gpu, dri3Extensions );
+}
+
+// Depth 24 and 32 pixmaps are 32 bits per pixel, BGRA in memory.
+[[nodiscard]] bool supportedDepth( std::uint8_t depth ) {
+    return depth == 24 || depth == 32;
+}
+
+[[nodiscard]] vk::Extent3D extentOf( const vk::Extent2D & extent ) {
+    return vk::Extent3D { .width = extent.width, .height = extent.height, .depth = 1 };
+}
+
+[[nodiscard]] vk::Offset3D offsetOf( const Box & box ) {
+    return vk::Offset3D { .x = box.x1, .y = box.y1, .z = 0 };
+}
+
+[[nodiscard]] vk::Extent3D extentOf( const Box & box ) {
+    return vk::Extent3D { .width  = static_cast< std::uint32_t >( box.x2 - box.x1 ),
+                          .height = static_cast< std::uint32_t >( box.y2 - box.y1 ),
+                          .depth  = 1 };
+}
+
+[[nodiscard]] Box boxOf( const vk::Extent2D & extent ) {
+    return Box { 0,
+                 0,
+                 static_cast< Region::CoordType >( extent.width ),
+                 static_cast< Region::CoordType >( extent.height ) };
+}
+
+[[nodiscard]] vk::DeviceSize alignUp( vk::DeviceSize value, vk::DeviceSize alignment ) {
+    return ( value + alignment - 1 ) / alignment * alignment;
+}
+}   // namespace
+
+std::vector< const char * > WindowCapture::deviceExtensions( const GpuInfo & gpu ) {
+    std::vector< const char * > extensions;
+    if ( supportsDri3( gpu ) ) {
+        extensions.assign( dri3Extensions.begin(), dri3Extensions.end() );
+        if ( gpu.hasExtension( VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME ) )
+            extensions.push_back( VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME );
+    }
+    if ( gpu.hasExtension( VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME ) )
+        extensions.push_back( VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME );
+    return extensions;
+}
+
+WindowCapture::WindowCapture( const CreateInfo & createInfo ) :
+mXcbConnect( createInfo.xcbConnect ), mRoot( createInfo.composite->root() ),
+mRedirect( createInfo.redirect ), mLogicDev( createInfo.logicDev ),
+mGpu( *createInfo.gpu ), mAllocator( *createInfo.allocator ),
+mStaging( *createInfo.staging ), mDestroyingView( createInfo.destroyingView ),
+mDispatch( createInfo.instance, vkGetInstanceProcAddr, mLogicDev, vkGetDeviceProcAddr ) {
+    // Both requests go out before either reply is waited for.
+    const auto dri3Cookie = xcb_dri3_query_version( mXcbConnect, 1, 2 );
+    const auto shmCookie  = xcb_shm_query_version( mXcbConnect );
+
+    const xcbwraper::XCBReply< xcb_dri3_query_version_reply_t > dri3Version {
+        xcb_dri3_query_version_reply( mXcbConnect, dri3Cookie, nullptr )
+    };
+    const xcbwraper::XCBReply< xcb_shm_query_version_reply_t > shmVersion {
+        xcb_shm_query_version_reply( mXcbConnect, shmCookie, nullptr )
+    };
+
+    mDri3 = !createInfo.forceShm && dri3Version &&
+            ( dri3Version->major_version > 1 || dri3Version->minor_version >= 2 ) &&
+            supportsDri3( mGpu );
+    // 1.2 brought segments passed as file descriptors.
+    mShm = shmVersion &&
+           ( shmVersion->major_version > 1 || shmVersion->minor_version >= 2 );
+    if ( !mDri3 && !mShm )
+        throw std::runtime_error( "WindowCapture::WindowCapture(): Neither DRI3 1.2 "
+                                  "import nor MIT-SHM 1.2 is available." );
+
+    if ( mDri3 && mGpu.hasExtension( VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME ) ) {
+        mForeignFamily = VK_QUEUE_FAMILY_FOREIGN_EXT;
+        mOwnFamily     = createInfo.queueFamilyIndex;
+    }
+    mHostImport = mGpu.hasExtension( VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME );
+    if ( mHostImport ) {
+        const auto properties =
+        mGpu.device.getProperties2< vk::PhysicalDeviceProperties2,
+                                    vk::PhysicalDeviceExternalMemoryHostPropertiesEXT >();
+        mHostImportAlignment = std::max< vk::DeviceSize >(
+        properties.get< vk::PhysicalDeviceExternalMemoryHostPropertiesEXT >()
+        .minImportedHostPointerAlignment,
+        static_cast< vk::DeviceSize >( sysconf( _SC_PAGESIZE ) ) );
+    }
+
+    if ( createInfo.trackDamage )
+        mDamage = std::make_unique< composite::DamageTracker >( mXcbConnect );
+
+    xcb_composite_redirect_subwindows( mXcbConnect, mRoot, mRedirect );
+    xcb_flush( mXcbConnect );
+}
+
+WindowCapture::~WindowCapture() {
+    for ( auto && [ id, window ] : mWindows ) {
+        destroy( window.resources );
+        if ( window.pixmap != XCB_NONE )
+            xcb_free_pixmap( mXcbConnect, window.pixmap );
+    }
+    for ( auto && retired : mRetired )
+        destroy( retired.resources );
+
+    xcb_composite_unredirect_subwindows( mXcbConnect, mRoot, mRedirect );
+    xcb_flush( mXcbConnect );
+}
+
+bool WindowCapture::dri3() const { return mDri3; }
+
+void WindowCapture::track( xcb_window_t window ) {
+    const auto [ tracked, inserted ] = mWindows.try_emplace( window );
+    if ( !inserted )
+        return;
+    if ( mDamage )
+        mDamage->track( window );
+    rename( window, tracked->second );
+}
+
+void WindowCapture::untrack( xcb_window_t window ) {
+    const auto tracked = mWindows.find( window );
+    if ( tracked == mWindows.end() )
+        return;
+
+    retire( tracked->second );
+    mWindows.erase( tracked );
+    if ( mDamage )
+        mDamage->untrack( window );
+    xcb_flush( mXcbConnect );
+}
+
+void WindowCapture::invalidate( xcb_window_t window ) {
+    if ( const auto tracked = mWindows.find( window ); tracked != mWindows.end() )
+        tracked->second.dirty.reset(
+        boxOf( tracked->second.resources.capture.extent ) );
+}
+
+bool WindowCapture::handleEvent( const xcb_generic_event_t & event ) {
+    // First, a destroyed window's damage object is gone before untrack().
+    const bool damaged = mDamage && mDamage->handleEvent( event );
+    switch ( event.response_type & ~0x80 ) {
+    case XCB_MAP_NOTIFY: {
+        const auto & map =
+        reinterpret_cast< const xcb_map_notify_event_t & >( event );
+        const auto tracked = mWindows.find( map.window );
+        if ( tracked == mWindows.end() )
+            return false;
+        rename( map.window, tracked->second );
+        return true;
+    }
+    case XCB_CONFIGURE_NOTIFY: {
+        const auto & configure =
+        reinterpret_cast< const xcb_configure_notify_event_t & >( event );
+        const auto tracked = mWindows.find( configure.window );
+        // Unmapped windows are named by MapNotify.
+        if ( tracked == mWindows.end() || tracked->second.pixmap == XCB_NONE )
+            return false;
+
+        // A move keeps the pixmap, a resize gives the window a new one. The
+        // pixmap includes the border.
+        const auto & extent = tracked->second.resources.capture.extent;
+        if ( extent.width == configure.width + 2u * configure.border_width &&
+             extent.height == configure.height + 2u * configure.border_width )
+            return false;
+        rename( configure.window, tracked->second );
+        return true;
+    }
+    case XCB_DESTROY_NOTIFY: {
+        const auto & destroyed =
+        reinterpret_cast< const xcb_destroy_notify_event_t & >( event );
+        if ( !mWindows.contains( destroyed.window ) )
+            return false;
+        untrack( destroyed.window );
+        return true;
+    }
+    default: return damaged;
+    }
+}
+
+void WindowCapture::recordAcquire( const vk::CommandBuffer & commandBuffer,
+                                   std::uint64_t             serial,
+                                   std::uint64_t             completedSerial ) {
+    mLastSerial = serial;
+    std::erase_if( mRetired, [ & ]( Retired & retired ) {
+        if ( retired.lastSerial > completedSerial )
+            return false;
+        destroy( retired.resources );
+        return true;
+    } );
+
+    takeDamage();
+
+    // All requests go out before the first reply is waited for.
+    mFetches.clear();
+    for ( auto && [ id, window ] : mWindows ) {
+        auto & resources = window.resources;
+        resources.capture.damage.clear();
+        if ( window.dirty.isEmpty() || !resources.capture.image )
+            continue;
+        // Nothing to fetch, the image is the pixmap. Imported shared memory is
+        // not written again before the GPU copied out of it.
+        if ( resources.capture.path == Path::eDri3 ) {
+            std::swap( resources.capture.damage, window.dirty );
+            window.dirty.clear();
+        } else if ( !mHostImport || window.stagingSerial <= completedSerial )
+            queueFetches( id, window );
+    }
+
+    mBarriers.clear();
+    for ( auto && fetch : mFetches ) {
+        auto & window = mWindows.at( fetch.window );
+        const xcbwraper::XCBReply< xcb_shm_get_image_reply_t > reply {
+            xcb_shm_get_image_reply( mXcbConnect, fetch.cookie, nullptr )
+        };
+        // E.g. destroyed meanwhile, DestroyNotify untracks it.
+        if ( !reply )
+            continue;
+        fetch.fetched = true;
+
+        auto & resources = window.resources;
+        if ( fetch.staging )
+            std::memcpy( fetch.staging, resources.shmData + fetch.offset, reply->size );
+
+        // The fetches of a window are next to each other.
+        if ( window.stagingSerial == serial )
+            continue;
+        window.stagingSerial = serial;
+        mBarriers.push_back( vk::ImageMemoryBarrier {
+        .srcAccessMask       = {},
+        .dstAccessMask       = vk::AccessFlagBits::eTransferWrite,
+        .oldLayout           = resources.initialized
+                               ? vk::ImageLayout::eShaderReadOnlyOptimal
+                               : vk::ImageLayout::eUndefined,
+        .newLayout           = vk::ImageLayout::eTransferDstOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = resources.capture.image,
+        .subresourceRange    = colorRange } );
+        resources.initialized = true;
+    }
+
+    if ( !mBarriers.empty() ) {
+        // Earlier frames may still sample the images.
+        commandBuffer.pipelineBarrier( vk::PipelineStageFlagBits::eFragmentShader,
+                                       vk::PipelineStageFlagBits::eTransfer,
+                                       vk::DependencyFlags(),
+                                       {},
+                                       {},
+                                       mBarriers );
+
+        for ( std::size_t first = 0; first < mFetches.size(); ) {
+            const auto id   = mFetches[ first ].window;
+            auto       last = first;
+            mCopies.clear();
+            for ( ; last < mFetches.size() && mFetches[ last ].window == id; ++last ) {
+                const auto & fetch = mFetches[ last ];
+                if ( !fetch.fetched )
+                    continue;
+                mCopies.push_back( vk::BufferImageCopy {
+                .bufferOffset      = fetch.bufferOffset,
+                .bufferRowLength   = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource  = colorLayers,
+                .imageOffset       = offsetOf( fetch.box ),
+                .imageExtent       = extentOf( fetch.box ) } );
+            }
+            first = last;
+            if ( mCopies.empty() )
+                continue;
+
+            const auto & resources = mWindows.at( id ).resources;
+            commandBuffer.copyBufferToImage( mHostImport ? resources.shmBuffer
+                                                         : mStaging.buffer(),
+                                             resources.capture.image,
+                                             vk::ImageLayout::eTransferDstOptimal,
+                                             mCopies );
+        }
+
+        for ( auto && barrier : mBarriers ) {
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            barrier.oldLayout     = vk::ImageLayout::eTransferDstOptimal;
+            barrier.newLayout     = vk::ImageLayout::eShaderReadOnlyOptimal;
+        }
+        commandBuffer.pipelineBarrier( vk::PipelineStageFlagBits::eTransfer,
+                                       vk::PipelineStageFlagBits::eFragmentShader,
+                                       vk::DependencyFlags(),
+                                       {},
+                                       {},
+                                       mBarriers );
+    }
+
+    // The X server writes DRI3 pixmaps outside of Vulkan, every frame takes the
+    // images over from it. Their contents are always defined, also the first
+    // time, so they come from the general layout recordRelease() leaves them
+    // in and never from the undefined one.
+    mBarriers.clear();
+    for ( auto && [ id, window ] : mWindows ) {
+        if ( !isDri3( window ) )
+            continue;
+        mBarriers.push_back( vk::ImageMemoryBarrier {
+        .srcAccessMask       = {},
+        .dstAccessMask       = vk::AccessFlagBits::eShaderRead,
+        .oldLayout           = vk::ImageLayout::eGeneral,
+        .newLayout           = vk::ImageLayout::eShaderReadOnlyOptimal,
+        .srcQueueFamilyIndex = mForeignFamily,
+        .dstQueueFamilyIndex = mOwnFamily,
+        .image               = window.resources.capture.image,
+        .subresourceRange    = colorRange } );
+    }
+    if ( !mBarriers.empty() )
+        commandBuffer.pipelineBarrier( vk::PipelineStageFlagBits::eTopOfPipe,
+                                       vk::PipelineStageFlagBits::eFragmentShader,
+                                       vk::DependencyFlags(),
+                                       {},
+                                       {},
+                                       mBarriers );
+}
+
+void WindowCapture::recordRelease( const vk::CommandBuffer & commandBuffer ) {
+    mBarriers.clear();
+    for ( auto && [ id, window ] : mWindows )
+        if ( isDri3( window ) )
+            mBarriers.push_back( vk::ImageMemoryBarrier {
+            .srcAccessMask       = {},
+            .dstAccessMask       = {},
+            .oldLayout           = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .newLayout           = vk::ImageLayout::eGeneral,
+            .srcQueueFamilyIndex = mOwnFamily,
+            .dstQueueFamilyIndex = mForeignFamily,
+            .image               = window.resources.capture.image,
+            .subresourceRange    = colorRange } );
+    if ( !mBarriers.empty() )
+        commandBuffer.pipelineBarrier( vk::PipelineStageFlagBits::eFragmentShader,
+                                       vk::PipelineStageFlagBits::eBottomOfPipe,
+                                       vk::DependencyFlags(),
+                                       {},
+                                       {},
+                                       mBarriers );
+}
+
+bool WindowCapture::isDri3( const Window & window ) {
+    return window.resources.capture.path == Path::eDri3 &&
+           window.resources.capture.image;
+}
+
+const WindowCapture::Capture * WindowCapture::capture( xcb_window_t window ) const {
+    const auto tracked = mWindows.find( window );
+    if ( tracked == mWindows.end() || !tracked->second.resources.capture.image )
+        return nullptr;
+    return &tracked->second.resources.capture;
+}
+
+std::size_t WindowCapture::size() const { return mWindows.size(); }
+
+const composite::DamageTracker * WindowCapture::damageTracker() const {
+    return mDamage.get();
+}
+
+void WindowCapture::rename( xcb_window_t id, Window & window ) {
+    retire( window );
+
+    // Fails while the window is unmapped, MapNotify names it then.
+    const auto pixmap = xcb_generate_id( mXcbConnect );
+    const auto nameCookie =
+    xcb_composite_name_window_pixmap_checked( mXcbConnect, id, pixmap );
+    const auto windowCookie = xcb_get_geometry( mXcbConnect, id );
+    const xcbwraper::XCBReply< xcb_generic_error_t > error { xcb_request_check(
+    mXcbConnect, nameCookie ) };
+    if ( error ) {
+        xcb_discard_reply( mXcbConnect, windowCookie.sequence );
+        return;
+    }
+    window.pixmap = pixmap;
+
+    const xcbwraper::XCBReply< xcb_get_geometry_reply_t > windowGeometry {
+        xcb_get_geometry_reply( mXcbConnect, windowCookie, nullptr )
+    };
+    if ( windowGeometry )
+        window.borderWidth = windowGeometry->border_width;
+
+    const xcbwraper::XCBReply< xcb_get_geometry_reply_t > geometry {
+        xcb_get_geometry_reply(
+        mXcbConnect, xcb_get_geometry( mXcbConnect, pixmap ), nullptr )
+    };
+    if ( !geometry || !supportedDepth( geometry->depth ) || geometry->width == 0 ||
+         geometry->height == 0 )
+        return;
+
+    auto & resources          = window.resources;
+    resources.capture.extent  = vk::Extent2D { .width  = geometry->width,
+                                               .height = geometry->height };
+    resources.capture.format  = vk::Format::eB8G8R8A8Unorm;
+    try {
+        if ( mDri3 && importDri3( resources, pixmap ) )
+            resources.capture.path = Path::eDri3;
+        else if ( mShm ) {
+            resources.capture.path = Path::eShm;
+            importShm( resources );
+        } else {
+            resources = Resources {};
+            return;
+        }
+        createView( resources, geometry->depth );
+    } catch ( const std::exception & ) {
+        // Out of shared or device memory, the window stays uncaptured until
+        // its next pixmap and the other windows go on.
+        destroy( resources );
+        return;
+    }
+    window.dirty.reset( boxOf( resources.capture.extent ) );
+    window.stagingSerial = 0;
+}
+
+void WindowCapture::takeDamage() {
+    if ( !mDamage )
+        return;
+
+    for ( auto id : mDamage->damaged() ) {
+        const auto tracked = mWindows.find( id );
+        if ( tracked == mWindows.end() || !tracked->second.resources.capture.image )
+            continue;
+        auto &     window = tracked->second;
+        const auto border = static_cast< Region::CoordType >( window.borderWidth );
+        for ( auto && box : mDamage->damage( id )->boxes() )
+            window.dirty.unite( Box {
+            static_cast< Region::CoordType >( box.x1 + border ),
+            static_cast< Region::CoordType >( box.y1 + border ),
+            static_cast< Region::CoordType >( box.x2 + border ),
+            static_cast< Region::CoordType >( box.y2 + border ) } );
+        window.dirty.intersect( boxOf( window.resources.capture.extent ) );
+    }
+    mDamage->clear();
+}
+
+// The boxes land one after another in the segment, their pixels never add up to
+// more than the whole pixmap.
+void WindowCapture::queueFetches( xcb_window_t id, Window & window ) {
+    auto & resources = window.resources;
+    if ( window.dirty.boxes().size() > maxFetchBoxes )
+        window.dirty.reset( window.dirty.extents() );
+
+    // Without host import the pixels are copied on into the ring. When it is
+    // full the window stays dirty for a later frame.
+    std::optional< StagingRing::Span > span;
+    if ( !mHostImport ) {
+        span = mStaging.allocate( bytesPerPixel * window.dirty.area(), bytesPerPixel );
+        if ( !span )
+            return;
+    }
+
+    std::uint32_t offset = 0;
+    for ( auto && box : window.dirty.boxes() ) {
+        const auto width  = static_cast< std::uint16_t >( box.x2 - box.x1 );
+        const auto height = static_cast< std::uint16_t >( box.y2 - box.y1 );
+        mFetches.push_back( Fetch {
+        .window       = id,
+        .box          = box,
+        .offset       = offset,
+        .bufferOffset = span ? span->offset + offset : offset,
+        .cookie       = xcb_shm_get_image_unchecked( mXcbConnect,
+                                                     window.pixmap,
+                                                     box.x1,
+                                                     box.y1,
+                                                     width,
+                                                     height,
+                                                     ~std::uint32_t { 0 },
+                                                     XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                     resources.shmSegment,
+                                                     offset ),
+        .staging      = span ? span->data + offset : nullptr } );
+        offset += static_cast< std::uint32_t >( bytesPerPixel * width * height );
+    }
+    std::swap( resources.capture.damage, window.dirty );
+    window.dirty.clear();
+}
+
+// Frames up to the last recorded one may still read the resources.
+void WindowCapture::retire( Window & window ) {
+    if ( window.resources.capture.image || window.resources.shmBuffer )
+        mRetired.push_back( Retired { .resources  = std::move( window.resources ),
+                                      .lastSerial = mLastSerial } );
+    window.resources = Resources {};
+
+    if ( window.pixmap != XCB_NONE ) {
+        xcb_free_pixmap( mXcbConnect, window.pixmap );
+        window.pixmap = XCB_NONE;
+    }
+}
+
+bool WindowCapture::importDri3( Resources & resources, xcb_pixmap_t pixmap ) const {
+    const xcbwraper::XCBReply< xcb_dri3_buffers_from_pixmap_reply_t > buffers {
+        xcb_dri3_buffers_from_pixmap_reply(
+        mXcbConnect, xcb_dri3_buffers_from_pixmap( mXcbConnect, pixmap ), nullptr )
+    };
+    if ( !buffers )
+        return false;
+
+    // The reply owns the descriptors, whatever Vulkan does not take is closed.
+    int * const fds =
+    xcb_dri3_buffers_from_pixmap_reply_fds( mXcbConnect, buffers.get() );
+    auto closeFds = [ & ] {
+        for ( int i = 0; i < buffers->nfd; ++i )
+            close( fds[ i ] );
+    };
+    // Multi-planar buffers are not RGB windows.
+    if ( buffers->nfd != 1 ) {
+        closeFds();
+        return false;
+    }
+
+    const auto & extent   = resources.capture.extent;
+    const auto   modifier = buffers->modifier;
+    try {
+        const vk::PhysicalDeviceImageDrmFormatModifierInfoEXT modifierInfo {
+            .drmFormatModifier = modifier,
+            .sharingMode       = vk::SharingMode::eExclusive
+        };
+        const vk::PhysicalDeviceExternalImageFormatInfo externalInfo {
+            .pNext = &modifierInfo, .handleType = dmaBufHandle
+        };
+        const auto properties =
+        mGpu.device.getImageFormatProperties2< vk::ImageFormatProperties2,
+                                               vk::ExternalImageFormatProperties >(
+        vk::PhysicalDeviceImageFormatInfo2 {
+        .pNext  = &externalInfo,
+        .format = resources.capture.format,
+        .type   = vk::ImageType::e2D,
+        .tiling = vk::ImageTiling::eDrmFormatModifierEXT,
+        .usage  = vk::ImageUsageFlagBits::eSampled } );
+        if ( !( properties.get< vk::ExternalImageFormatProperties >()
+                .externalMemoryProperties.externalMemoryFeatures &
+                vk::ExternalMemoryFeatureFlagBits::eImportable ) ) {
+            closeFds();
+            return false;
+        }
+    } catch ( const vk::SystemError & ) {
+        // The driver cannot sample buffers with this modifier.
+        closeFds();
+        return false;
+    }
+
+    const vk::SubresourceLayout planeLayout {
+        .offset = xcb_dri3_buffers_from_pixmap_offsets( buffers.get() )[ 0 ],
+        .size   = 0,
+        .rowPitch   = xcb_dri3_buffers_from_pixmap_strides( buffers.get() )[ 0 ],
+        .arrayPitch = 0,
+        .depthPitch = 0
+    };
+    const vk::ImageDrmFormatModifierExplicitCreateInfoEXT explicitLayout {
+        .drmFormatModifier           = modifier,
+        .drmFormatModifierPlaneCount = 1,
+        .pPlaneLayouts               = &planeLayout
+    };
+    const vk::ExternalMemoryImageCreateInfo externalImage {
+        .pNext = &explicitLayout, .handleTypes = dmaBufHandle
+    };
+    const auto image = mLogicDev.createImage( vk::ImageCreateInfo {
+    .pNext       = &externalImage,
+    .imageType   = vk::ImageType::e2D,
+    .format      = resources.capture.format,
+    .extent      = extentOf( extent ),
+    .mipLevels   = 1,
+    .arrayLayers = 1,
+    .samples     = vk::SampleCountFlagBits::e1,
+    .tiling      = vk::ImageTiling::eDrmFormatModifierEXT,
+    .usage       = vk::ImageUsageFlagBits::eSampled,
+    .sharingMode = vk::SharingMode::eExclusive,
+    .initialLayout = vk::ImageLayout::eUndefined } );
+
+    try {
+        const auto requirements = mLogicDev.getImageMemoryRequirements( image );
+        const auto fdProperties =
+        mLogicDev.getMemoryFdPropertiesKHR( dmaBufHandle, fds[ 0 ], mDispatch );
+        const vk::MemoryDedicatedAllocateInfo dedicated { .image = image };
+        const vk::ImportMemoryFdInfoKHR       importInfo { .pNext      = &dedicated,
+                                                           .handleType = dmaBufHandle,
+                                                           .fd         = fds[ 0 ] };
+        resources.importedMemory = mLogicDev.allocateMemory( vk::MemoryAllocateInfo {
+        .pNext          = &importInfo,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex =
+        mAllocator.memoryType(
+        requirements.memoryTypeBits & fdProperties.memoryTypeBits, {} ) } );
+        // The memory owns the descriptor from here on.
+    } catch ( ... ) {
+        mLogicDev.destroyImage( image );
+        closeFds();
+        return false;
+    }
+
+    // Set first, a failed bind leaves the image to destroy().
+    resources.capture.image = image;
+    mLogicDev.bindImageMemory( image, resources.importedMemory, 0 );
+    return true;
+}
+
+void WindowCapture::importShm( Resources & resources ) const {
+    const auto & extent = resources.capture.extent;
+    // Z pixmaps of 32 bits per pixel have no row padding.
+    const auto imageSize = vk::DeviceSize { 4 } * extent.width * extent.height;
+    resources.shmSize =
+    mHostImport ? alignUp( imageSize, mHostImportAlignment ) : imageSize;
+
+    const int fd = memfd_create( "window-capture", MFD_CLOEXEC );
+    if ( fd < 0 || ftruncate( fd, static_cast< off_t >( resources.shmSize ) ) != 0 ) {
+        if ( fd >= 0 )
+            close( fd );
+        throw std::runtime_error( "WindowCapture::importShm(): memfd is failed." );
+    }
+    void * data =
+    mmap( nullptr, resources.shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if ( data == MAP_FAILED ) {
+        close( fd );
+        throw std::runtime_error( "WindowCapture::importShm(): mmap is failed." );
+    }
+    resources.shmData = static_cast< std::byte * >( data );
+
+    // xcb closes the descriptor once it is sent, the mapping stays.
+    resources.shmSegment = xcb_generate_id( mXcbConnect );
+    xcb_shm_attach_fd( mXcbConnect, resources.shmSegment, fd, 0 );
+
+    if ( mHostImport ) {
+        const vk::ExternalMemoryBufferCreateInfo externalBuffer { .handleTypes =
+                                                                  hostHandle };
+        resources.shmBuffer = mLogicDev.createBuffer(
+        vk::BufferCreateInfo { .pNext       = &externalBuffer,
+                               .size        = resources.shmSize,
+                               .usage       = vk::BufferUsageFlagBits::eTransferSrc,
+                               .sharingMode = vk::SharingMode::eExclusive } );
+        const auto requirements =
+        mLogicDev.getBufferMemoryRequirements( resources.shmBuffer );
+        const auto hostProperties =
+        mLogicDev.getMemoryHostPointerPropertiesEXT( hostHandle, data, mDispatch );
+        const vk::ImportMemoryHostPointerInfoEXT importInfo { .handleType   = hostHandle,
+                                                              .pHostPointer = data };
+        resources.shmImported = mLogicDev.allocateMemory( vk::MemoryAllocateInfo {
+        .pNext          = &importInfo,
+        .allocationSize = resources.shmSize,
+        .memoryTypeIndex =
+        mAllocator.memoryType(
+        requirements.memoryTypeBits & hostProperties.memoryTypeBits, {} ) } );
+        mLogicDev.bindBufferMemory( resources.shmBuffer, resources.shmImported, 0 );
+    }
+
+    resources.capture.image = mLogicDev.createImage( vk::ImageCreateInfo {
+    .imageType   = vk::ImageType::e2D,
+    .format      = resources.capture.format,
+    .extent      = extentOf( extent ),
+    .mipLevels   = 1,
+    .arrayLayers = 1,
+    .samples     = vk::SampleCountFlagBits::e1,
+    .tiling      = vk::ImageTiling::eOptimal,
+    .usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+    .sharingMode   = vk::SharingMode::eExclusive,
+    .initialLayout = vk::ImageLayout::eUndefined } );
+    resources.imageMemory = mAllocator.allocate(
+    resources.capture.image, vk::MemoryPropertyFlagBits::eDeviceLocal );
+}
+
+void WindowCapture::createView( Resources & resources, std::uint8_t depth ) const {
+    // Depth 24 leaves the alpha byte undefined.
+    resources.capture.view = mLogicDev.createImageView( vk::ImageViewCreateInfo {
+    .image      = resources.capture.image,
+    .viewType   = vk::ImageViewType::e2D,
+    .format     = resources.capture.format,
+    .components = vk::ComponentMapping { .a = depth == 24
+                                              ? vk::ComponentSwizzle::eOne
+                                              : vk::ComponentSwizzle::eIdentity },
+    .subresourceRange = colorRange } );
+}
+
+void WindowCapture::destroy( Resources & resources ) const {
+    if ( resources.capture.view ) {
+        if ( mDestroyingView )
+            mDestroyingView( resources.capture.view );
+        mLogicDev.destroyImageView( resources.capture.view );
+    }
+    if ( resources.capture.image )
+        mLogicDev.destroyImage( resources.capture.image );
+    if ( resources.importedMemory )
+        mLogicDev.freeMemory( resources.importedMemory );
+    if ( resources.imageMemory.memory )
+        mAllocator.free( resources.imageMemory );
+
+    if ( resources.shmBuffer )
+        mLogicDev.destroyBuffer( resources.shmBuffer );
+    if ( resources.shmImported )
+        mLogicDev.freeMemory( resources.shmImported );
+    if ( resources.shmData ) {
+        xcb_shm_detach( mXcbConnect, resources.shmSegment );
+        munmap( resources.shmData, resources.shmSize );
+    }
+    resources = Resources {};
+}
+
+}   // namespace core::renderer
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <xcb/composite.h>
+#include <xcb/shm.h>
+#include <xcb/xcb.h>
+
+#define VK_USE_PLATFORM_XCB_KHR
+#define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+#include "composite.hpp"
+#include "damagetracker.hpp"
+#include "gpuselector.hpp"
+#include "memoryallocator.hpp"
+#include "stagingring.hpp"
+#include "xcb_wraper/region.hpp"
+
+namespace core::renderer {
+
+// Gets the contents of top level windows into images without the CPU touching
+// the pixels. The children of the root are redirected with Composite and every
+// tracked window's pixmap is named. With DRI3 1.2 and dma-buf import the
+// pixmap's buffer becomes the window's image, no copy at all. Otherwise the
+// pixmap goes through MIT-SHM: the server writes it into shared memory that is
+// imported as a Vulkan buffer, or copied into the staging ring when the device
+// cannot import host memory, and the GPU copies it into the image.
+// xcb_get_image() is never used. XDamage tells which pixels changed, MIT-SHM
+// fetches only those.
+class WindowCapture final {
+public:
+    enum class Path { eDri3, eShm };
+
+    struct CreateInfo final {
+        xcb_connection_t * xcbConnect;
+        // Negotiated the extension version, and gives the root.
+        const composite::Composite * composite;
+        vk::Instance                 instance;
+        // Must have deviceExtensions( *gpu ) enabled.
+        vk::Device        logicDev;
+        const GpuInfo *   gpu;
+        MemoryAllocator * allocator;
+        // Carries the MIT-SHM pixels when the device cannot import host memory.
+        StagingRing * staging;
+        // Of the queue the command buffers of recordAcquire() and
+        // recordRelease() run on.
+        std::uint32_t queueFamilyIndex;
+        // Automatic keeps the X server drawing the windows on screen, manual
+        // leaves that to the compositor.
+        std::uint8_t redirect { XCB_COMPOSITE_REDIRECT_AUTOMATIC };
+        // Uses MIT-SHM even when DRI3 import would work.
+        bool forceShm { false };
+        // Without XDamage only invalidate() makes MIT-SHM windows fetched again.
+        bool trackDamage { true };
+        // Called right before a capture's view is destroyed, so whoever cached
+        // the handle forgets it before the driver hands it out again.
+        std::function< void( vk::ImageView ) > destroyingView;
+    };
+
+    // What a window shows, valid until the window is resized, mapped again or
+    // untracked. Fragment shaders can read the image between recordAcquire()
+    // and recordRelease().
+    struct Capture final {
+        vk::Image     image;
+        vk::ImageView view;
+        vk::Extent2D  extent;
+        vk::Format    format { vk::Format::eB8G8R8A8Unorm };
+        Path          path { Path::eShm };
+        // The pixels that changed for the frame recorded last, all of them
+        // when the image is new.
+        xcbwraper::Region damage;
+    };
+
+    // The import extensions the GPU supports, to enable on the device.
+    [[nodiscard]] static std::vector< const char * >
+    deviceExtensions( const GpuInfo & gpu );
+
+    // Throws when neither DRI3 1.2 with dma-buf import nor MIT-SHM 1.2 works.
+    explicit WindowCapture( const CreateInfo & createInfo );
+    WindowCapture( const WindowCapture & ) = delete;
+    WindowCapture & operator=( const WindowCapture & ) = delete;
+    // The device must be done with the frames that used the captures.
+    ~WindowCapture();
+
+    // True when pixmaps are imported with DRI3 where their buffers allow it.
+    [[nodiscard]] bool dri3() const;
+
+    // Starts capturing a top level window, it is captured once mapped.
+    void track( xcb_window_t window );
+    void untrack( xcb_window_t window );
+    // All of the window's contents changed, an MIT-SHM window is fetched
+    // again by the next recordAcquire(). Tracked damage does this per pixel.
+    void invalidate( xcb_window_t window );
+
+    // Follows maps, resizes and destruction of the tracked windows through the
+    // SubstructureNotify events of the root, which the owner of the event loop
+    // selects, e.g. with a WindowTreeCache, and their damage. Returns true when
+    // a capture changed.
+    bool handleEvent( const xcb_generic_event_t & event );
+
+    // Before the render pass of the frame with the serial: fetches the damage
+    // of the MIT-SHM windows whose staging memory the GPU no longer reads,
+    // records its copies and makes every image readable by fragment shaders.
+    // Sets Capture::damage. Frees what frames up to completedSerial were the
+    // last to use.
+    void recordAcquire( const vk::CommandBuffer & commandBuffer,
+                        std::uint64_t             serial,
+                        std::uint64_t             completedSerial );
+    // After the render pass, hands the DRI3 images back to the X server.
+    void recordRelease( const vk::CommandBuffer & commandBuffer );
+
+    // Null while the window is not captured.
+    [[nodiscard]] const Capture * capture( xcb_window_t window ) const;
+    [[nodiscard]] std::size_t     size() const;
+    // Null without damage tracking.
+    [[nodiscard]] const composite::DamageTracker * damageTracker() const;
+
+private:
+    // Everything created for one pixmap of a window.
+    struct Resources final {
+        Capture capture {};
+        // DRI3, imported from the pixmap's dma-buf.
+        vk::DeviceMemory importedMemory;
+        // MIT-SHM, the image memory and the shared memory the server writes.
+        MemoryAllocator::Allocation imageMemory {};
+        std::uint32_t               shmSegment { 0 };
+        std::byte *                 shmData { nullptr };
+        std::size_t                 shmSize { 0 };
+        // The shared memory imported as host memory, if the device can.
+        vk::Buffer       shmBuffer;
+        vk::DeviceMemory shmImported;
+        // The MIT-SHM image left the undefined layout.
+        bool initialized { false };
+    };
+
+    struct Window final {
+        xcb_pixmap_t pixmap { XCB_NONE };
+        Resources    resources;
+        // The pixmap includes the border, damage does not.
+        std::uint16_t borderWidth { 0 };
+        // Changed pixels not in the image yet, in pixmap coordinates.
+        xcbwraper::Region dirty;
+        // Frame that last copied from the pixmap's pixels.
+        std::uint64_t stagingSerial { 0 };
+    };
+
+    // One shm_get_image request of recordAcquire().
+    struct Fetch final {
+        xcb_window_t               window;
+        xcbwraper::Region::Box     box;
+        // In the shared memory, and of the copy source.
+        std::uint32_t              offset;
+        vk::DeviceSize             bufferOffset;
+        xcb_shm_get_image_cookie_t cookie;
+        // Where the pixels go when they are copied into the staging ring.
+        std::byte * staging { nullptr };
+        bool        fetched { false };
+    };
+
+    struct Retired final {
+        Resources     resources;
+        std::uint64_t lastSerial;
+    };
+
+    using WindowsMap = std::unordered_map< xcb_window_t, Window >;
+
+    // Names the window's current pixmap and imports it, retiring the old one.
+    // A failed import leaves the window uncaptured instead of throwing.
+    void rename( xcb_window_t id, Window & window );
+    // Moves the tracked damage into the dirty regions.
+    void takeDamage();
+    // Requests the dirty pixels of an MIT-SHM window.
+    void queueFetches( xcb_window_t id, Window & window );
+    void retire( Window & window );
+    [[nodiscard]] bool importDri3( Resources & resources, xcb_pixmap_t pixmap ) const;
+    void               importShm( Resources & resources ) const;
+    void               createView( Resources & resources, std::uint8_t depth ) const;
+    void               destroy( Resources & resources ) const;
+    [[nodiscard]] static bool isDri3( const Window & window );
+
+    xcb_connection_t * mXcbConnect;
+    xcb_window_t       mRoot;
+    std::uint8_t       mRedirect;
+    vk::Device         mLogicDev;
+    const GpuInfo &    mGpu;
+    MemoryAllocator &  mAllocator;
+    StagingRing &      mStaging;
+
+    std::function< void( vk::ImageView ) > mDestroyingView;
+
+    vk::DispatchLoaderDynamic mDispatch;
+    bool                      mDri3 { false };
+    bool                      mShm { false };
+    bool                      mHostImport { false };
+    // Ownership of the DRI3 images moves between these families, both are
+    // ignored without VK_EXT_queue_family_foreign.
+    std::uint32_t             mForeignFamily { VK_QUEUE_FAMILY_IGNORED };
+    std::uint32_t             mOwnFamily { VK_QUEUE_FAMILY_IGNORED };
+    vk::DeviceSize            mHostImportAlignment { 1 };
+
+    std::unique_ptr< composite::DamageTracker > mDamage;
+
+    WindowsMap             mWindows;
+    std::vector< Retired > mRetired;
+    // Serial of the last frame recorded, every capture is read by it.
+    std::uint64_t mLastSerial { 0 };
+
+    // Scratch storage of recordAcquire().
+    std::vector< Fetch >                  mFetches;
+    std::vector< vk::BufferImageCopy >    mCopies;
+    std::vector< vk::ImageMemoryBarrier > mBarriers;
+};
+
+}   // namespace core::renderer
@@ -0,0 +1,389 @@
+#include "windowtreecache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#include <xcb/xproto.h>
+
+namespace core::composite {
+
+namespace {
+using xcbwraper::Point;
+using xcbwraper::WindowGeometry;
+
+// Events report the outer position relative to the root, the cache keeps the
+// inner origin like XCBWindowProp::Geometry() does.
+WindowGeometry::Info geometryFromEvent( std::int16_t  x,
+                                        std::int16_t  y,
+                                        std::uint16_t width,
+                                        std::uint16_t height,
+                                        std::uint16_t borderWidth ) {
+    return WindowGeometry {
+        WindowGeometry::CreateInfo {
+        .leftTopPoint = Point { .x = static_cast< Point::CoordType >( x + borderWidth ),
+                                .y = static_cast< Point::CoordType >( y + borderWidth ) },
+        .width        = width,
+        .height       = height,
+        .borderWidth  = borderWidth } }
+    .getInfo();
+}
+
+constexpr std::uint32_t rootEventMask =
+XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE;
+constexpr std::uint32_t windowEventMask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+}   // namespace
+
+WindowTreeCache::WindowTreeCache( xcbwraper::XCBConnectShared connect ) :
+mConnect( std::move( connect ) ) {
+    assert( mConnect && "XCB connect is not created" );
+    xcb_connection_t * xcbConnect = *mConnect;
+
+    auto screen = xcb_setup_roots_iterator( xcb_get_setup( xcbConnect ) ).data;
+    assert( screen != nullptr && "xcb_setup_roots_iterator return nullptr" );
+    mRoot = screen->root;
+
+    // The connection is shared, the events are added to what the client
+    // already selected on the root.
+    xcbwraper::XCBReply< xcb_get_window_attributes_reply_t > root {
+        xcb_get_window_attributes_reply(
+        xcbConnect, xcb_get_window_attributes( xcbConnect, mRoot ), nullptr )
+    };
+    const std::uint32_t rootMask = root ? root->your_event_mask : 0;
+    mRootAddedMask               = rootEventMask & ~rootMask;
+
+    // Select first, then scan: a change racing the scan is seen as an event.
+    const std::uint32_t mask = rootMask | rootEventMask;
+    xcb_change_window_attributes( xcbConnect, mRoot, XCB_CW_EVENT_MASK, &mask );
+    rescan();
+}
+
+WindowTreeCache::~WindowTreeCache() {
+    xcb_connection_t * connect = *mConnect;
+    waitReplies();
+
+    // Other parts of the client may have changed the masks meanwhile, only
+    // the events added here are taken out again.
+    xcbwraper::WindowIDsVec windows( mWatched.begin(), mWatched.end() );
+    windows.push_back( mRoot );
+    std::vector< xcb_get_window_attributes_cookie_t > cookies;
+    cookies.reserve( windows.size() );
+    for ( auto id : windows )
+        cookies.push_back( xcb_get_window_attributes( connect, id ) );
+
+    for ( std::size_t i = 0; i < windows.size(); ++i ) {
+        xcb_generic_error_t *                                    error = nullptr;
+        xcbwraper::XCBReply< xcb_get_window_attributes_reply_t > attributes {
+            xcb_get_window_attributes_reply( connect, cookies[ i ], &error )
+        };
+        std::free( error );
+        if ( !attributes )
+            continue;
+
+        const std::uint32_t added =
+        windows[ i ] == mRoot ? mRootAddedMask : windowEventMask;
+        const std::uint32_t mask = attributes->your_event_mask & ~added;
+        xcb_change_window_attributes( connect, windows[ i ], XCB_CW_EVENT_MASK, &mask );
+    }
+    xcb_flush( connect );
+}
+
+void WindowTreeCache::rescan() {
+    xcb_connection_t * connect = *mConnect;
+
+    waitReplies();
+    mWindows.clear();
+    mStacking.clear();
+
+    xcbwraper::XCBReply< xcb_query_tree_reply_t > tree { xcb_query_tree_reply(
+    connect, xcb_query_tree( connect, mRoot ), nullptr ) };
+    if ( !tree )
+        return;
+
+    const auto children = xcb_query_tree_children( tree.get() );
+    const xcbwraper::WindowIDsVec ids(
+    children, children + xcb_query_tree_children_length( tree.get() ) );
+
+    std::vector< xcb_get_window_attributes_cookie_t > attributeCookies;
+    attributeCookies.reserve( ids.size() );
+    for ( auto id : ids )
+        attributeCookies.push_back( xcb_get_window_attributes( connect, id ) );
+
+    // The masks are extended before the snapshot is requested, a WM_CLASS
+    // change racing the scan is seen as an event.
+    std::vector< xcbwraper::XCBReply< xcb_get_window_attributes_reply_t > > attributes;
+    attributes.reserve( ids.size() );
+    for ( std::size_t i = 0; i < ids.size(); ++i ) {
+        xcb_generic_error_t * error = nullptr;
+        attributes.emplace_back(
+        xcb_get_window_attributes_reply( connect, attributeCookies[ i ], &error ) );
+        std::free( error );
+        if ( attributes.back() )
+            select( ids[ i ], attributes.back()->your_event_mask );
+    }
+    // Windows that left the root without their events being seen.
+    std::erase_if( mWatched, [ & ]( auto id ) {
+        return std::find( ids.begin(), ids.end(), id ) == ids.end();
+    } );
+
+    const auto snapshots = xcbwraper::snapshotWindows( mConnect, ids );
+
+    // query_tree lists the children from the bottom to the top of the stack.
+    for ( std::size_t i = 0; i < ids.size(); ++i ) {
+        if ( !attributes[ i ] || !snapshots[ i ].isValid )
+            continue;
+
+        mWindows.emplace( ids[ i ],
+                          Window { .id          = ids[ i ],
+                                   .geometry    = snapshots[ i ].geometry,
+                                   .windowClass = snapshots[ i ].windowClass,
+                                   .isMapped    = attributes[ i ]->map_state ==
+                                               XCB_MAP_STATE_VIEWABLE } );
+        mStacking.push_back( ids[ i ] );
+    }
+}
+
+bool WindowTreeCache::handleEvent( const xcb_generic_event_t & event ) {
+    // The replies sent before the event describe the windows before it.
+    const bool changed = takeReplies( event.full_sequence );
+
+    switch ( event.response_type & ~0x80 ) {
+    case XCB_CREATE_NOTIFY: {
+        const auto & create =
+        reinterpret_cast< const xcb_create_notify_event_t & >( event );
+        if ( create.parent != mRoot )
+            return changed;
+        add( Window { .id       = create.window,
+                      .geometry = geometryFromEvent( create.x,
+                                                     create.y,
+                                                     create.width,
+                                                     create.height,
+                                                     create.border_width ) },
+             mStacking.empty() ? XCB_NONE : mStacking.back() );
+        send( Request::Kind::eAttributes, create.window );
+        return true;
+    }
+    case XCB_CONFIGURE_NOTIFY: {
+        const auto & configure =
+        reinterpret_cast< const xcb_configure_notify_event_t & >( event );
+        auto window = mWindows.find( configure.window );
+        if ( configure.event != mRoot || window == mWindows.end() )
+            return changed;
+        window->second.geometry = geometryFromEvent( configure.x,
+                                                     configure.y,
+                                                     configure.width,
+                                                     configure.height,
+                                                     configure.border_width );
+        restack( configure.window, configure.above_sibling );
+        return true;
+    }
+    case XCB_MAP_NOTIFY:
+    case XCB_UNMAP_NOTIFY: {
+        // Both events start with the same fields.
+        const auto & map = reinterpret_cast< const xcb_map_notify_event_t & >( event );
+        auto         window = mWindows.find( map.window );
+        if ( map.event != mRoot || window == mWindows.end() )
+            return changed;
+        window->second.isMapped = ( event.response_type & ~0x80 ) == XCB_MAP_NOTIFY;
+        return true;
+    }
+    case XCB_DESTROY_NOTIFY: {
+        const auto & destroy =
+        reinterpret_cast< const xcb_destroy_notify_event_t & >( event );
+        if ( !mWindows.contains( destroy.window ) )
+            return changed;
+        mWatched.erase( destroy.window );
+        remove( destroy.window );
+        return true;
+    }
+    case XCB_REPARENT_NOTIFY: {
+        const auto & reparent =
+        reinterpret_cast< const xcb_reparent_notify_event_t & >( event );
+        if ( reparent.parent != mRoot ) {
+            // A window manager took a top level window into its frame.
+            if ( !mWindows.contains( reparent.window ) )
+                return changed;
+            if ( mWatched.erase( reparent.window ) )
+                send( Request::Kind::eUnwatch, reparent.window );
+            remove( reparent.window );
+            return true;
+        }
+        // The size comes with the geometry reply.
+        add( Window { .id       = reparent.window,
+                      .geometry = geometryFromEvent( reparent.x, reparent.y, 0, 0, 0 ) },
+             mStacking.empty() ? XCB_NONE : mStacking.back() );
+        send( Request::Kind::eGeometry, reparent.window );
+        send( Request::Kind::eAttributes, reparent.window );
+        return true;
+    }
+    case XCB_CIRCULATE_NOTIFY: {
+        const auto & circulate =
+        reinterpret_cast< const xcb_circulate_notify_event_t & >( event );
+        if ( !mWindows.contains( circulate.window ) )
+            return changed;
+        restack( circulate.window,
+                 circulate.place == XCB_PLACE_ON_TOP ? mStacking.back() : XCB_NONE );
+        return true;
+    }
+    case XCB_PROPERTY_NOTIFY: {
+        const auto & property =
+        reinterpret_cast< const xcb_property_notify_event_t & >( event );
+        if ( property.atom == XCB_ATOM_WM_CLASS && mWindows.contains( property.window ) )
+            send( Request::Kind::eClass, property.window );
+        return changed;
+    }
+    default: return changed;
+    }
+}
+
+bool WindowTreeCache::handleReplies() {
+    return !mRequests.empty() && takeReplies( mRequests.back().sequence );
+}
+
+const WindowTreeCache::Window *
+WindowTreeCache::find( xcbwraper::WindowIDType id ) const {
+    const auto window = mWindows.find( id );
+    return window == mWindows.end() ? nullptr : &window->second;
+}
+
+const WindowTreeCache::WindowsMap & WindowTreeCache::windows() const {
+    return mWindows;
+}
+
+const xcbwraper::WindowIDsVec & WindowTreeCache::stacking() const { return mStacking; }
+
+std::size_t WindowTreeCache::size() const { return mWindows.size(); }
+
+void WindowTreeCache::add( const Window & window, xcb_window_t aboveSibling ) {
+    mWindows.insert_or_assign( window.id, window );
+    restack( window.id, aboveSibling );
+}
+
+void WindowTreeCache::remove( xcbwraper::WindowIDType id ) {
+    mWindows.erase( id );
+    std::erase( mStacking, id );
+}
+
+void WindowTreeCache::restack( xcbwraper::WindowIDType id, xcb_window_t aboveSibling ) {
+    std::erase( mStacking, id );
+    if ( aboveSibling == XCB_NONE ) {
+        mStacking.insert( mStacking.begin(), id );
+        return;
+    }
+
+    auto sibling = std::find( mStacking.begin(), mStacking.end(), aboveSibling );
+    mStacking.insert( sibling == mStacking.end() ? sibling : std::next( sibling ), id );
+}
+
+void WindowTreeCache::select( xcbwraper::WindowIDType id, std::uint32_t eventMask ) {
+    if ( ( eventMask & windowEventMask ) == windowEventMask )
+        return;
+    const std::uint32_t mask = eventMask | windowEventMask;
+    xcb_change_window_attributes( *mConnect, id, XCB_CW_EVENT_MASK, &mask );
+    mWatched.insert( id );
+}
+
+void WindowTreeCache::send( Request::Kind kind, xcbwraper::WindowIDType id ) {
+    xcb_connection_t * connect  = *mConnect;
+    unsigned int       sequence = 0;
+    switch ( kind ) {
+    case Request::Kind::eAttributes:
+    case Request::Kind::eUnwatch:
+        sequence = xcb_get_window_attributes( connect, id ).sequence;
+        break;
+    case Request::Kind::eClass:
+        sequence =
+        xcb_get_property( connect, false, id, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 3 )
+        .sequence;
+        break;
+    case Request::Kind::eGeometry:
+        sequence = xcb_get_geometry( connect, id ).sequence;
+        break;
+    }
+    mRequests.push_back( Request { .kind = kind, .id = id, .sequence = sequence } );
+}
+
+bool WindowTreeCache::takeReplies( unsigned int lastSequence ) {
+    bool changed = false;
+    // Sequence numbers wrap around, their difference tells the order.
+    while ( !mRequests.empty() ) {
+        const auto request = mRequests.front();
+        if ( static_cast< std::int32_t >( request.sequence - lastSequence ) > 0 )
+            break;
+
+        void *                reply = nullptr;
+        xcb_generic_error_t * error = nullptr;
+        if ( !xcb_poll_for_reply( *mConnect, request.sequence, &reply, &error ) )
+            break;
+        std::free( error );
+
+        const xcbwraper::XCBReply< void > owner { reply };
+        mRequests.pop_front();
+        // An error means the window is gone, its DestroyNotify follows.
+        if ( reply )
+            changed |= applyReply( request, reply );
+    }
+    return changed;
+}
+
+void WindowTreeCache::waitReplies() {
+    while ( !mRequests.empty() ) {
+        const auto request = mRequests.front();
+        mRequests.pop_front();
+
+        xcb_generic_error_t *             error = nullptr;
+        const xcbwraper::XCBReply< void > reply {
+            xcb_wait_for_reply( *mConnect, request.sequence, &error )
+        };
+        std::free( error );
+        if ( reply )
+            applyReply( request, reply.get() );
+    }
+}
+
+bool WindowTreeCache::applyReply( const Request & request, const void * reply ) {
+    if ( request.kind == Request::Kind::eUnwatch ) {
+        const auto & attributes =
+        *static_cast< const xcb_get_window_attributes_reply_t * >( reply );
+        const std::uint32_t mask = attributes.your_event_mask & ~windowEventMask;
+        xcb_change_window_attributes( *mConnect, request.id, XCB_CW_EVENT_MASK, &mask );
+        return false;
+    }
+
+    auto window = mWindows.find( request.id );
+    if ( window == mWindows.end() )
+        return false;
+
+    switch ( request.kind ) {
+    case Request::Kind::eAttributes: {
+        const auto & attributes =
+        *static_cast< const xcb_get_window_attributes_reply_t * >( reply );
+        window->second.isMapped = attributes.map_state == XCB_MAP_STATE_VIEWABLE;
+        select( request.id, attributes.your_event_mask );
+        // Asked after the mask is extended, later changes come as events.
+        send( Request::Kind::eClass, request.id );
+        return true;
+    }
+    case Request::Kind::eClass:
+        window->second.windowClass = xcbwraper::wmClassFromReply(
+        static_cast< const xcb_get_property_reply_t * >( reply ) );
+        return true;
+    case Request::Kind::eGeometry: {
+        const auto & geometry = *static_cast< const xcb_get_geometry_reply_t * >( reply );
+        window->second.geometry = geometryFromEvent( geometry.x,
+                                                     geometry.y,
+                                                     geometry.width,
+                                                     geometry.height,
+                                                     geometry.border_width );
+        return true;
+    }
+    default: return false;
+    }
+}
+
+}   // namespace core::composite
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+#include "xcb_wraper/windowgeometry.hpp"
+#include "xcb_wraper/windowsnapshot.hpp"
+#include "xcb_wraper/xcbconnect.hpp"
+#include "xcb_wraper/xcbwindowprop.hpp"
+
+namespace core::composite {
+
+// In-memory table of the top level windows (children of the root). It is filled
+// once by a pipelined scan and then kept current from SubstructureNotify and
+// PropertyNotify events, so lookups never touch the server. What an event
+// does not carry, like WM_CLASS, is requested while handling it and filled in
+// once the reply arrived, handling never waits for the server. The events are
+// added to the masks other parts of the client selected on the same windows,
+// and taken out of them again by the destructor.
+class WindowTreeCache final {
+public:
+    struct Window final {
+        xcbwraper::WindowIDType         id;
+        xcbwraper::WindowGeometry::Info geometry {};
+        xcbwraper::XCBWindowClass       windowClass {};
+        bool                            isMapped { false };
+    };
+
+    using WindowsMap = std::unordered_map< xcbwraper::WindowIDType, Window >;
+
+    // Selects the events on the root window of the shared connection, the
+    // owner of the event loop has to feed them to handleEvent() and call
+    // handleReplies() once the queue is drained.
+    explicit WindowTreeCache( xcbwraper::XCBConnectShared connect );
+    WindowTreeCache( const WindowTreeCache & ) = delete;
+    WindowTreeCache & operator=( const WindowTreeCache & ) = delete;
+    ~WindowTreeCache();
+
+    // Returns true when the event, or a reply the server sent before it,
+    // changed the table.
+    bool handleEvent( const xcb_generic_event_t & event );
+    // Applies the replies that arrived so far, returns true when the table
+    // changed.
+    bool handleReplies();
+
+    // Drops the table and reads the window tree from the server again.
+    void rescan();
+
+    [[nodiscard]] const Window * find( xcbwraper::WindowIDType id ) const;
+    [[nodiscard]] const WindowsMap &              windows() const;
+    // Window IDs from the bottom to the top of the stack.
+    [[nodiscard]] const xcbwraper::WindowIDsVec & stacking() const;
+    [[nodiscard]] std::size_t                     size() const;
+
+private:
+    // A request sent while handling an event, its reply is still to come.
+    struct Request final {
+        enum class Kind {
+            // Map state and event mask, the reply adds PropertyNotify to the
+            // mask and fetches WM_CLASS.
+            eAttributes,
+            // The reply takes PropertyNotify out of the mask again.
+            eUnwatch,
+            eClass,
+            eGeometry
+        };
+
+        Kind                    kind;
+        xcbwraper::WindowIDType id;
+        unsigned int            sequence;
+    };
+
+    void add( const Window & window, xcb_window_t aboveSibling );
+    void remove( xcbwraper::WindowIDType id );
+    void restack( xcbwraper::WindowIDType id, xcb_window_t aboveSibling );
+    // Adds PropertyNotify to the window's current event mask.
+    void select( xcbwraper::WindowIDType id, std::uint32_t eventMask );
+    void send( Request::Kind kind, xcbwraper::WindowIDType id );
+    // Applies the replies to the requests up to the sequence number, stops at
+    // the first one that did not arrive yet.
+    bool takeReplies( unsigned int lastSequence );
+    // Waits for every reply still to come and applies it.
+    void waitReplies();
+    bool applyReply( const Request & request, const void * reply );
+
+    xcbwraper::XCBConnectShared mConnect;
+    xcb_window_t                mRoot;
+    // The events this cache added to the root's mask.
+    std::uint32_t mRootAddedMask { 0 };
+
+    WindowsMap              mWindows;
+    xcbwraper::WindowIDsVec mStacking;
+    // The windows whose mask got PropertyNotify from select().
+    std::unordered_set< xcbwraper::WindowIDType > mWatched;
+    std::deque< Request >                         mRequests;
+};
+
+}   // namespace core::composite
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#    include <immintrin.h>
+#    define XCBWRAPER_X86_KERNELS 1
+#endif
+
+#include "point.hpp"
+#include "windowgeometry.hpp"
+#include "winintersection.hpp"
+
+namespace xcbwraper {
+
+// Structure-of-Arrays copy of WindowGeometry::Info rectangles, only the edges
+// intersect() needs are kept so many of them fit in one vector register.
+struct RectArray final {
+    std::vector< Point::CoordType > left;
+    std::vector< Point::CoordType > top;
+    std::vector< Point::CoordType > right;
+    std::vector< Point::CoordType > bottom;
+
+    [[nodiscard]] std::size_t size() const { return left.size(); }
+
+    void reserve( std::size_t count ) {
+        left.reserve( count );
+        top.reserve( count );
+        right.reserve( count );
+        bottom.reserve( count );
+    }
+
+    void resize( std::size_t count ) {
+        left.resize( count );
+        top.resize( count );
+        right.resize( count );
+        bottom.resize( count );
+    }
+
+    void clear() { resize( 0 ); }
+
+    void push_back( const WindowGeometry::Info & geometry ) {
+        left.push_back( geometry.leftTopPoint.x );
+        top.push_back( geometry.leftTopPoint.y );
+        right.push_back( geometry.rightBotPoint.x );
+        bottom.push_back( geometry.rightBotPoint.y );
+    }
+};
+
+// Result of one rectangle tested against a RectArray: the overlap edges of
+// every pair plus a bit per pair telling whether the overlap exists.
+struct IntersectionBatch final {
+    RectArray                    rects;
+    std::vector< std::uint64_t > existMask;
+
+    [[nodiscard]] bool exists( std::size_t index ) const {
+        return existMask[ index / 64 ] >> ( index % 64 ) & 1;
+    }
+
+    // Same value intersect() returns for the pair.
+    [[nodiscard]] Intersection at( std::size_t index ) const {
+        if ( !exists( index ) )
+            return Intersection {};
+        return Intersection {
+            { rects.left[ index ], rects.top[ index ] },
+            static_cast< uint16_t >(
+            static_cast< int16_t >( rects.right[ index ] - rects.left[ index ] ) ),
+            static_cast< uint16_t >(
+            static_cast< int16_t >( rects.bottom[ index ] - rects.top[ index ] ) ),
+            true
+        };
+    }
+};
+
+enum class IntersectKernel { eScalar, eSse2, eAvx2 };
+
+namespace detail {
+// All kernels use wrapping 16 bit arithmetic, which is what intersect() gets
+// from narrowing its int results to int16_t.
+inline void intersectScalar( const WindowGeometry::Info & rect,
+                             const RectArray &            rects,
+                             IntersectionBatch &          out,
+                             std::size_t                  first ) {
+    for ( std::size_t i = first; i < rects.size(); ++i ) {
+        const int16_t top    = std::max( rect.leftTopPoint.y, rects.top[ i ] );
+        const int16_t bottom = std::min( rect.rightBotPoint.y, rects.bottom[ i ] );
+        const int16_t left   = std::max( rect.leftTopPoint.x, rects.left[ i ] );
+        const int16_t right  = std::min( rect.rightBotPoint.x, rects.right[ i ] );
+
+        out.rects.left[ i ]   = left;
+        out.rects.top[ i ]    = top;
+        out.rects.right[ i ]  = right;
+        out.rects.bottom[ i ] = bottom;
+
+        const auto width  = static_cast< int16_t >( right - left );
+        const auto height = static_cast< int16_t >( bottom - top );
+        if ( width >= 0 && height >= 0 )
+            out.existMask[ i / 64 ] |= std::uint64_t { 1 } << ( i % 64 );
+    }
+}
+
+#ifdef XCBWRAPER_X86_KERNELS
+// Returns the index of the first rectangle left for the scalar tail.
+__attribute__( ( target( "sse2" ) ) ) inline std::size_t
+intersectSse2( const WindowGeometry::Info & rect,
+               const RectArray &            rects,
+               IntersectionBatch &          out ) {
+    constexpr std::size_t lanes = 8;
+    using Vec                   = __m128i;
+
+    const Vec rectLeft   = _mm_set1_epi16( rect.leftTopPoint.x );
+    const Vec rectTop    = _mm_set1_epi16( rect.leftTopPoint.y );
+    const Vec rectRight  = _mm_set1_epi16( rect.rightBotPoint.x );
+    const Vec rectBottom = _mm_set1_epi16( rect.rightBotPoint.y );
+    const Vec minusOne   = _mm_set1_epi16( -1 );
+
+    const auto inLeft   = reinterpret_cast< const Vec * >( rects.left.data() );
+    const auto inTop    = reinterpret_cast< const Vec * >( rects.top.data() );
+    const auto inRight  = reinterpret_cast< const Vec * >( rects.right.data() );
+    const auto inBottom = reinterpret_cast< const Vec * >( rects.bottom.data() );
+    const auto outLeft   = reinterpret_cast< Vec * >( out.rects.left.data() );
+    const auto outTop    = reinterpret_cast< Vec * >( out.rects.top.data() );
+    const auto outRight  = reinterpret_cast< Vec * >( out.rects.right.data() );
+    const auto outBottom = reinterpret_cast< Vec * >( out.rects.bottom.data() );
+
+    std::size_t i = 0;
+    for ( ; i + lanes <= rects.size(); i += lanes ) {
+        const std::size_t block = i / lanes;
+
+        const Vec left   = _mm_max_epi16( rectLeft, _mm_loadu_si128( inLeft + block ) );
+        const Vec top    = _mm_max_epi16( rectTop, _mm_loadu_si128( inTop + block ) );
+        const Vec right  = _mm_min_epi16( rectRight, _mm_loadu_si128( inRight + block ) );
+        const Vec bottom =
+        _mm_min_epi16( rectBottom, _mm_loadu_si128( inBottom + block ) );
+
+        _mm_storeu_si128( outLeft + block, left );
+        _mm_storeu_si128( outTop + block, top );
+        _mm_storeu_si128( outRight + block, right );
+        _mm_storeu_si128( outBottom + block, bottom );
+
+        const Vec exist =
+        _mm_and_si128( _mm_cmpgt_epi16( _mm_sub_epi16( right, left ), minusOne ),
+                       _mm_cmpgt_epi16( _mm_sub_epi16( bottom, top ), minusOne ) );
+        const auto bits = static_cast< std::uint64_t >(
+        _mm_movemask_epi8( _mm_packs_epi16( exist, _mm_setzero_si128() ) ) );
+        out.existMask[ i / 64 ] |= bits << ( i % 64 );
+    }
+    return i;
+}
+
+__attribute__( ( target( "avx2" ) ) ) inline std::size_t
+intersectAvx2( const WindowGeometry::Info & rect,
+               const RectArray &            rects,
+               IntersectionBatch &          out ) {
+    constexpr std::size_t lanes = 16;
+    using Vec                   = __m256i;
+
+    const Vec rectLeft   = _mm256_set1_epi16( rect.leftTopPoint.x );
+    const Vec rectTop    = _mm256_set1_epi16( rect.leftTopPoint.y );
+    const Vec rectRight  = _mm256_set1_epi16( rect.rightBotPoint.x );
+    const Vec rectBottom = _mm256_set1_epi16( rect.rightBotPoint.y );
+    const Vec minusOne   = _mm256_set1_epi16( -1 );
+
+    const auto inLeft   = reinterpret_cast< const Vec * >( rects.left.data() );
+    const auto inTop    = reinterpret_cast< const Vec * >( rects.top.data() );
+    const auto inRight  = reinterpret_cast< const Vec * >( rects.right.data() );
+    const auto inBottom = reinterpret_cast< const Vec * >( rects.bottom.data() );
+    const auto outLeft   = reinterpret_cast< Vec * >( out.rects.left.data() );
+    const auto outTop    = reinterpret_cast< Vec * >( out.rects.top.data() );
+    const auto outRight  = reinterpret_cast< Vec * >( out.rects.right.data() );
+    const auto outBottom = reinterpret_cast< Vec * >( out.rects.bottom.data() );
+
+    std::size_t i = 0;
+    for ( ; i + lanes <= rects.size(); i += lanes ) {
+        const std::size_t block = i / lanes;
+
+        const Vec left =
+        _mm256_max_epi16( rectLeft, _mm256_loadu_si256( inLeft + block ) );
+        const Vec top = _mm256_max_epi16( rectTop, _mm256_loadu_si256( inTop + block ) );
+        const Vec right =
+        _mm256_min_epi16( rectRight, _mm256_loadu_si256( inRight + block ) );
+        const Vec bottom =
+        _mm256_min_epi16( rectBottom, _mm256_loadu_si256( inBottom + block ) );
+
+        _mm256_storeu_si256( outLeft + block, left );
+        _mm256_storeu_si256( outTop + block, top );
+        _mm256_storeu_si256( outRight + block, right );
+        _mm256_storeu_si256( outBottom + block, bottom );
+
+        const Vec exist = _mm256_and_si256(
+        _mm256_cmpgt_epi16( _mm256_sub_epi16( right, left ), minusOne ),
+        _mm256_cmpgt_epi16( _mm256_sub_epi16( bottom, top ), minusOne ) );
+
+        // packs works per 128 bit half: lanes 0-7 land in mask bits 0-7 and
+        // lanes 8-15 in bits 16-23.
+        const auto packed = static_cast< std::uint32_t >(
+        _mm256_movemask_epi8( _mm256_packs_epi16( exist, _mm256_setzero_si256() ) ) );
+        const std::uint64_t bits = ( packed & 0xFF ) | ( packed >> 8 & 0xFF00 );
+        out.existMask[ i / 64 ] |= bits << ( i % 64 );
+    }
+    return i;
+}
+#endif
+}   // namespace detail
+
+// The widest kernel the CPU runs, checked once.
+[[nodiscard]] inline IntersectKernel bestIntersectKernel() {
+#ifdef XCBWRAPER_X86_KERNELS
+    static const IntersectKernel best = [] {
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports( "avx2" ) )
+            return IntersectKernel::eAvx2;
+        if ( __builtin_cpu_supports( "sse2" ) )
+            return IntersectKernel::eSse2;
+        return IntersectKernel::eScalar;
+    }();
+    return best;
+#else
+    return IntersectKernel::eScalar;
+#endif
+}
+
+// Intersects rect with every rectangle of rects at once. out is reused
+// between calls, so steady state calls do not allocate. An explicit kernel
+// must be supported by the CPU, see bestIntersectKernel().
+inline void intersectBatch( const WindowGeometry::Info & rect,
+                            const RectArray &            rects,
+                            IntersectionBatch &          out,
+                            IntersectKernel kernel = bestIntersectKernel() ) {
+    out.rects.resize( rects.size() );
+    out.existMask.assign( ( rects.size() + 63 ) / 64, 0 );
+
+    std::size_t first = 0;
+#ifdef XCBWRAPER_X86_KERNELS
+    switch ( kernel ) {
+    case IntersectKernel::eAvx2: first = detail::intersectAvx2( rect, rects, out ); break;
+    case IntersectKernel::eSse2: first = detail::intersectSse2( rect, rects, out ); break;
+    case IntersectKernel::eScalar: break;
+    }
+#else
+    static_cast< void >( kernel );
+#endif
+    detail::intersectScalar( rect, rects, out, first );
+}
+
+}   // namespace xcbwraper
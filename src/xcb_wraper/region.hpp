@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "point.hpp"
+#include "windowgeometry.hpp"
+#include "winintersection.hpp"
+
+namespace xcbwraper {
+
+// Set of pixels stored as y-x banded rectangles like pixman regions: boxes are
+// sorted by band and then by x, every box of a band has the same y1/y2, the
+// boxes of a band never touch, and vertically adjacent bands never repeat the
+// same spans. The in-place operations reuse the storage of the region and one
+// scratch buffer, so once those have grown they do not allocate.
+class Region final {
+public:
+    using CoordType = Point::CoordType;
+
+    // Half open rectangle [x1, x2) x [y1, y2).
+    struct Box final {
+        CoordType x1, y1, x2, y2;
+
+        [[nodiscard]] bool isEmpty() const { return x1 >= x2 || y1 >= y2; }
+        bool               operator==( const Box & ) const = default;
+    };
+
+    using BoxesVec  = std::vector< Box >;
+    using BoxesView = std::span< const Box >;
+
+    Region() = default;
+    explicit Region( const Box & box ) { reset( box ); }
+    explicit Region( const WindowGeometry::Info & geometry ) {
+        reset( boxOf( geometry ) );
+    }
+    explicit Region( const Intersection & intersection ) {
+        if ( intersection )
+            reset( boxOf( intersection ) );
+    }
+
+    [[nodiscard]] static Box boxOf( const WindowGeometry::Info & geometry ) {
+        return Box { geometry.leftTopPoint.x,
+                     geometry.leftTopPoint.y,
+                     geometry.rightBotPoint.x,
+                     geometry.rightBotPoint.y };
+    }
+
+    [[nodiscard]] static Box boxOf( const Intersection & intersection ) {
+        return Box {
+            intersection.leftTopPoint.x,
+            intersection.leftTopPoint.y,
+            static_cast< CoordType >( intersection.leftTopPoint.x + intersection.width ),
+            static_cast< CoordType >( intersection.leftTopPoint.y + intersection.height )
+        };
+    }
+
+    void clear() { mBoxes.clear(); }
+
+    void reset( const Box & box ) {
+        mBoxes.clear();
+        if ( !box.isEmpty() )
+            mBoxes.push_back( box );
+    }
+
+    void reserve( std::size_t boxesCount ) {
+        mBoxes.reserve( boxesCount );
+        mScratch.reserve( boxesCount );
+    }
+
+    [[nodiscard]] bool            isEmpty() const { return mBoxes.empty(); }
+    [[nodiscard]] const BoxesVec & boxes() const { return mBoxes; }
+
+    [[nodiscard]] Box extents() const {
+        if ( mBoxes.empty() )
+            return Box { 0, 0, 0, 0 };
+        Box extents {
+            mBoxes.front().x1, mBoxes.front().y1, mBoxes.back().x2, mBoxes.back().y2
+        };
+        for ( auto && box : mBoxes ) {
+            extents.x1 = std::min( extents.x1, box.x1 );
+            extents.x2 = std::max( extents.x2, box.x2 );
+        }
+        return extents;
+    }
+
+    [[nodiscard]] std::uint64_t area() const {
+        std::uint64_t area = 0;
+        for ( auto && box : mBoxes )
+            area += static_cast< std::uint64_t >( box.x2 - box.x1 ) *
+                    static_cast< std::uint64_t >( box.y2 - box.y1 );
+        return area;
+    }
+
+    [[nodiscard]] bool contains( Point point ) const {
+        return std::any_of( mBoxes.begin(), mBoxes.end(), [ point ]( const Box & box ) {
+            return box.x1 <= point.x && point.x < box.x2 && box.y1 <= point.y &&
+                   point.y < box.y2;
+        } );
+    }
+
+    bool operator==( const Region & other ) const { return mBoxes == other.mBoxes; }
+
+    Region & unite( const Region & other ) { return apply( Op::eUnion, other.mBoxes ); }
+    Region & intersect( const Region & other ) {
+        return apply( Op::eIntersect, other.mBoxes );
+    }
+    Region & subtract( const Region & other ) {
+        return apply( Op::eSubtract, other.mBoxes );
+    }
+
+    // Single rectangle operands, no temporary region needed.
+    Region & unite( const Box & box ) { return apply( Op::eUnion, single( box ) ); }
+    Region & intersect( const Box & box ) {
+        return apply( Op::eIntersect, single( box ) );
+    }
+    Region & subtract( const Box & box ) { return apply( Op::eSubtract, single( box ) ); }
+
+private:
+    enum class Op { eUnion, eIntersect, eSubtract };
+
+    // Edges live in int32 during the sweep so the end marker is out of range.
+    using Edge                   = std::int32_t;
+    static constexpr Edge noEdge = std::numeric_limits< Edge >::max();
+
+    static BoxesView single( const Box & box ) {
+        return box.isEmpty() ? BoxesView {} : BoxesView { &box, 1 };
+    }
+
+    static bool keeps( Op op, bool inOne, bool inTwo ) {
+        switch ( op ) {
+        case Op::eUnion: return inOne || inTwo;
+        case Op::eIntersect: return inOne && inTwo;
+        case Op::eSubtract: return inOne && !inTwo;
+        }
+        return false;
+    }
+
+    // Boxes of the band starting at first.
+    static BoxesView bandAt( BoxesView boxes, std::size_t first ) {
+        std::size_t last = first;
+        while ( last < boxes.size() && boxes[ last ].y1 == boxes[ first ].y1 )
+            ++last;
+        return boxes.subspan( first, last - first );
+    }
+
+    Region & apply( Op op, BoxesView other ) {
+        combine( op, mBoxes, other, mScratch );
+        mBoxes.swap( mScratch );
+        return *this;
+    }
+
+    // Sweeps both regions from top to bottom. Between two consecutive band
+    // edges the set of covering bands is fixed, so the output band there is a
+    // 1D merge of at most two span lists.
+    static void combine( Op op, BoxesView one, BoxesView two, BoxesVec & out ) {
+        out.clear();
+
+        std::size_t oneFirst = 0, twoFirst = 0;
+        std::size_t lastBandFirst = 0;
+        bool        hasLastBand   = false;
+
+        Edge y = std::min< Edge >( one.empty() ? noEdge : one.front().y1,
+                                   two.empty() ? noEdge : two.front().y1 );
+
+        while ( oneFirst < one.size() || twoFirst < two.size() ) {
+            const auto oneBand = bandAt( one, oneFirst );
+            const auto twoBand = bandAt( two, twoFirst );
+
+            const bool inOne = !oneBand.empty() && oneBand.front().y1 <= y;
+            const bool inTwo = !twoBand.empty() && twoBand.front().y1 <= y;
+
+            // The next row where a band starts or ends.
+            Edge bottom = noEdge;
+            if ( !oneBand.empty() )
+                bottom = std::min< Edge >(
+                bottom, inOne ? oneBand.front().y2 : oneBand.front().y1 );
+            if ( !twoBand.empty() )
+                bottom = std::min< Edge >(
+                bottom, inTwo ? twoBand.front().y2 : twoBand.front().y1 );
+
+            if ( inOne || inTwo ) {
+                const std::size_t bandFirst = out.size();
+                mergeSpans( op,
+                            inOne ? oneBand : BoxesView {},
+                            inTwo ? twoBand : BoxesView {},
+                            static_cast< CoordType >( y ),
+                            static_cast< CoordType >( bottom ),
+                            out );
+
+                if ( out.size() != bandFirst ) {
+                    if ( hasLastBand && coalesce( out, lastBandFirst, bandFirst ) )
+                        out.resize( bandFirst );
+                    else {
+                        lastBandFirst = bandFirst;
+                        hasLastBand   = true;
+                    }
+                }
+            }
+
+            if ( inOne && oneBand.front().y2 == bottom )
+                oneFirst += oneBand.size();
+            if ( inTwo && twoBand.front().y2 == bottom )
+                twoFirst += twoBand.size();
+            y = bottom;
+        }
+    }
+
+    // Appends the spans of one op two for the rows [y1, y2).
+    static void mergeSpans( Op         op,
+                            BoxesView  one,
+                            BoxesView  two,
+                            CoordType  y1,
+                            CoordType  y2,
+                            BoxesVec & out ) {
+        const std::size_t bandFirst = out.size();
+
+        std::size_t oneIndex = 0, twoIndex = 0;
+        bool        inOne = false, inTwo = false;
+        Edge        previous = 0;
+
+        while ( true ) {
+            const Edge oneEdge = oneIndex < one.size()
+                                 ? ( inOne ? one[ oneIndex ].x2 : one[ oneIndex ].x1 )
+                                 : noEdge;
+            const Edge twoEdge = twoIndex < two.size()
+                                 ? ( inTwo ? two[ twoIndex ].x2 : two[ twoIndex ].x1 )
+                                 : noEdge;
+            const Edge x = std::min( oneEdge, twoEdge );
+            if ( x == noEdge )
+                break;
+
+            if ( keeps( op, inOne, inTwo ) && previous < x ) {
+                if ( out.size() > bandFirst && out.back().x2 == previous )
+                    out.back().x2 = static_cast< CoordType >( x );
+                else
+                    out.push_back( Box { static_cast< CoordType >( previous ),
+                                         y1,
+                                         static_cast< CoordType >( x ),
+                                         y2 } );
+            }
+
+            if ( oneEdge == x ) {
+                oneIndex += inOne;
+                inOne = !inOne;
+            }
+            if ( twoEdge == x ) {
+                twoIndex += inTwo;
+                inTwo = !inTwo;
+            }
+            previous = x;
+        }
+    }
+
+    // Extends the previous band over the new one when they touch and have the
+    // same spans, returns true when the new band can be dropped.
+    static bool
+    coalesce( BoxesVec & out, std::size_t previousFirst, std::size_t bandFirst ) {
+        const std::size_t previousCount = bandFirst - previousFirst;
+        if ( previousCount != out.size() - bandFirst ||
+             out[ previousFirst ].y2 != out[ bandFirst ].y1 )
+            return false;
+
+        for ( std::size_t i = 0; i < previousCount; ++i )
+            if ( out[ previousFirst + i ].x1 != out[ bandFirst + i ].x1 ||
+                 out[ previousFirst + i ].x2 != out[ bandFirst + i ].x2 )
+                return false;
+
+        const auto y2 = out[ bandFirst ].y2;
+        for ( std::size_t i = 0; i < previousCount; ++i )
+            out[ previousFirst + i ].y2 = y2;
+        return true;
+    }
+
+    BoxesVec mBoxes;
+    BoxesVec mScratch;
+};
+
+}   // namespace xcbwraper
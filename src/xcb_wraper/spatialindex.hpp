@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "point.hpp"
+#include "windowgeometry.hpp"
+#include "xcbwindowprop.hpp"
+
+namespace xcbwraper {
+
+// Uniform grid over window rectangles. Every window is listed in each cell it
+// touches, so a query only looks at the windows sharing its cells instead of
+// testing all pairs with intersect(). Rectangles overlap only when they share
+// a positive area, touching edges do not count.
+class SpatialIndex final {
+public:
+    // Stacking level, a higher value is closer to the viewer.
+    using ZOrder = std::uint32_t;
+
+    explicit SpatialIndex( std::uint16_t cellSize = 128 ) : mCellSize( cellSize ) {
+        assert( cellSize > 0 && "SpatialIndex cell size must be non-zero" );
+    }
+
+    // Adds the window or moves it when it is already indexed.
+    void insert( WindowIDType id, const WindowGeometry::Info & geometry, ZOrder z ) {
+        const Box box = Box::from( geometry );
+        auto      entry = mEntries.find( id );
+        if ( entry != mEntries.end() ) {
+            const bool sameCells = cellSpan( entry->second.box ) == cellSpan( box );
+            if ( !sameCells )
+                unlink( id, entry->second.box );
+            entry->second.box = box;
+            entry->second.z   = z;
+            if ( sameCells )
+                return;
+        } else
+            mEntries.emplace( id, Entry { .box = box, .z = z } );
+
+        forEachCell( box, [ & ]( CellKey key ) { mCells[ key ].push_back( id ); } );
+    }
+
+    void update( WindowIDType id, const WindowGeometry::Info & geometry, ZOrder z ) {
+        insert( id, geometry, z );
+    }
+
+    void remove( WindowIDType id ) {
+        auto entry = mEntries.find( id );
+        if ( entry == mEntries.end() )
+            return;
+        unlink( id, entry->second.box );
+        mEntries.erase( entry );
+    }
+
+    void clear() {
+        mEntries.clear();
+        mCells.clear();
+    }
+
+    [[nodiscard]] std::size_t size() const { return mEntries.size(); }
+
+    // Windows overlapping the rectangle, in no particular order.
+    [[nodiscard]] WindowIDsVec query( const WindowGeometry::Info & rect ) const {
+        WindowIDsVec result;
+        visitOverlapping( Box::from( rect ), [ & ]( WindowIDType id, const Entry & ) {
+            result.push_back( id );
+        } );
+        return result;
+    }
+
+    [[nodiscard]] std::optional< WindowIDType > topmostAt( Point point ) const {
+        const Box probe { point.x, point.y, point.x + 1, point.y + 1 };
+        std::optional< WindowIDType > topmost;
+        ZOrder                        topmostZ = 0;
+        visitOverlapping( probe, [ & ]( WindowIDType id, const Entry & entry ) {
+            if ( !topmost || entry.z > topmostZ ) {
+                topmost  = id;
+                topmostZ = entry.z;
+            }
+        } );
+        return topmost;
+    }
+
+    // Windows completely hidden by the union of the windows above them. Empty
+    // windows have nothing to show and are reported too.
+    [[nodiscard]] WindowIDsVec occluded() const {
+        WindowIDsVec       result;
+        std::vector< Box > visible, clipped;
+        for ( auto && [ id, entry ] : mEntries ) {
+            visible.clear();
+            if ( !entry.box.isEmpty() )
+                visible.push_back( entry.box );
+            visitOverlapping( entry.box, [ & ]( WindowIDType, const Entry & above ) {
+                if ( above.z <= entry.z || visible.empty() )
+                    return;
+                clipped.clear();
+                for ( auto && part : visible )
+                    part.subtract( above.box, clipped );
+                visible.swap( clipped );
+            } );
+            if ( visible.empty() )
+                result.push_back( id );
+        }
+        return result;
+    }
+
+private:
+    // Half open rectangle [left, right) x [top, bottom) in root coordinates.
+    struct Box final {
+        std::int32_t left, top, right, bottom;
+
+        static Box from( const WindowGeometry::Info & geometry ) {
+            return Box { geometry.leftTopPoint.x,
+                         geometry.leftTopPoint.y,
+                         geometry.leftTopPoint.x + geometry.width,
+                         geometry.leftTopPoint.y + geometry.height };
+        }
+
+        bool isEmpty() const { return left >= right || top >= bottom; }
+
+        bool overlaps( const Box & other ) const {
+            return left < other.right && other.left < right && top < other.bottom &&
+                   other.top < bottom;
+        }
+
+        // Appends the parts of this box outside of other, at most four bands.
+        void subtract( const Box & other, std::vector< Box > & out ) const {
+            if ( !overlaps( other ) ) {
+                out.push_back( *this );
+                return;
+            }
+            const std::int32_t midTop    = std::max( top, other.top );
+            const std::int32_t midBottom = std::min( bottom, other.bottom );
+            if ( top < other.top )
+                out.push_back( Box { left, top, right, other.top } );
+            if ( other.bottom < bottom )
+                out.push_back( Box { left, other.bottom, right, bottom } );
+            if ( left < other.left )
+                out.push_back( Box { left, midTop, other.left, midBottom } );
+            if ( other.right < right )
+                out.push_back( Box { other.right, midTop, right, midBottom } );
+        }
+    };
+
+    struct Entry final {
+        Box    box;
+        ZOrder z;
+        // Last query that reported the entry, filters windows found in several cells.
+        mutable std::uint64_t visitStamp { 0 };
+    };
+
+    using CellKey = std::uint64_t;
+
+    struct CellSpan final {
+        std::int32_t firstX, firstY, lastX, lastY;
+        bool         operator==( const CellSpan & ) const = default;
+    };
+
+    std::int32_t cellOf( std::int32_t coord ) const {
+        // Rounds towards minus infinity, windows may sit at negative coordinates.
+        return coord >= 0 ? coord / mCellSize : ( coord - mCellSize + 1 ) / mCellSize;
+    }
+
+    CellSpan cellSpan( const Box & box ) const {
+        if ( box.isEmpty() )
+            return CellSpan { 0, 0, -1, -1 };
+        return CellSpan { cellOf( box.left ),
+                          cellOf( box.top ),
+                          cellOf( box.right - 1 ),
+                          cellOf( box.bottom - 1 ) };
+    }
+
+    static CellKey key( std::int32_t x, std::int32_t y ) {
+        return static_cast< CellKey >( static_cast< std::uint32_t >( x ) ) << 32 |
+               static_cast< std::uint32_t >( y );
+    }
+
+    template < class Visitor >
+    void forEachCell( const Box & box, Visitor && visitor ) const {
+        const auto span = cellSpan( box );
+        for ( auto y = span.firstY; y <= span.lastY; ++y )
+            for ( auto x = span.firstX; x <= span.lastX; ++x )
+                visitor( key( x, y ) );
+    }
+
+    void unlink( WindowIDType id, const Box & box ) {
+        forEachCell( box, [ & ]( CellKey cellKey ) {
+            auto cell = mCells.find( cellKey );
+            if ( cell == mCells.end() )
+                return;
+            std::erase( cell->second, id );
+            if ( cell->second.empty() )
+                mCells.erase( cell );
+        } );
+    }
+
+    template < class Visitor >
+    void visitOverlapping( const Box & box, Visitor && visitor ) const {
+        const auto stamp = ++mVisitStamp;
+        forEachCell( box, [ & ]( CellKey cellKey ) {
+            const auto cell = mCells.find( cellKey );
+            if ( cell == mCells.end() )
+                return;
+            for ( auto id : cell->second ) {
+                const auto & entry = mEntries.find( id )->second;
+                if ( entry.visitStamp == stamp || !entry.box.overlaps( box ) )
+                    continue;
+                entry.visitStamp = stamp;
+                visitor( id, entry );
+            }
+        } );
+    }
+
+    std::int32_t mCellSize;
+
+    std::unordered_map< WindowIDType, Entry >   mEntries;
+    std::unordered_map< CellKey, WindowIDsVec > mCells;
+    mutable std::uint64_t                       mVisitStamp { 0 };
+};
+
+}   // namespace xcbwraper
@@ -17,9 +17,9 @@ public:
 
     struct Info final {
         Point    leftTopPoint;
-        Point    rightTopPoint;
-        Point    leftBotPoint;
-        Point    rightBotPoint;
+        Point    rightTopPoint {};
+        Point    leftBotPoint {};
+        Point    rightBotPoint {};
         uint16_t width;
         uint16_t height;
         uint16_t borderWidth;
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+#include "windowgeometry.hpp"
+#include "xcbconnect.hpp"
+#include "xcbwindowprop.hpp"
+
+namespace xcbwraper {
+struct WindowSnapshot final {
+    WindowIDType         id;
+    // False when the window was destroyed before the server answered.
+    bool                 isValid { false };
+    WindowGeometry::Info geometry {};
+    XCBWindowClass       windowClass {};
+};
+
+using WindowSnapshotsVec = std::vector< WindowSnapshot >;
+
+// Geometry and WM_CLASS of every window. All requests are sent before the
+// first reply is awaited, so the whole scan costs about one round trip no
+// matter how many windows are listed.
+[[nodiscard]] inline WindowSnapshotsVec
+snapshotWindows( const XCBConnectShared & connectShared, const WindowIDsVec & windows ) {
+    xcb_connection_t * connect = *connectShared;
+
+    auto screen = xcb_setup_roots_iterator( xcb_get_setup( connect ) ).data;
+
+    struct Cookies final {
+        xcb_get_geometry_cookie_t          geometry;
+        xcb_translate_coordinates_cookie_t rootOrigin;
+        xcb_get_property_cookie_t          wmClass;
+    };
+
+    std::vector< Cookies > cookies;
+    cookies.reserve( windows.size() );
+    for ( auto window : windows )
+        cookies.push_back( Cookies {
+        .geometry   = xcb_get_geometry( connect, window ),
+        .rootOrigin = xcb_translate_coordinates( connect, window, screen->root, 0, 0 ),
+        .wmClass    = xcb_get_property(
+        connect, false, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 3 ) } );
+
+    // Errors of vanished windows are taken here so they never reach the event
+    // queue.
+    auto takeError = []( xcb_generic_error_t * error ) { std::free( error ); };
+
+    WindowSnapshotsVec snapshots;
+    snapshots.reserve( windows.size() );
+    for ( std::size_t i = 0; i < windows.size(); ++i ) {
+        xcb_generic_error_t * error = nullptr;
+
+        XCBReply< xcb_get_geometry_reply_t > geometryRep {
+            xcb_get_geometry_reply( connect, cookies[ i ].geometry, &error )
+        };
+        takeError( error );
+        error = nullptr;
+
+        XCBReply< xcb_translate_coordinates_reply_t > rootOrigin {
+            xcb_translate_coordinates_reply( connect, cookies[ i ].rootOrigin, &error )
+        };
+        takeError( error );
+        error = nullptr;
+
+        XCBReply< xcb_get_property_reply_t > wmClassRep {
+            xcb_get_property_reply( connect, cookies[ i ].wmClass, &error )
+        };
+        takeError( error );
+
+        WindowSnapshot snapshot { .id = windows[ i ] };
+        if ( geometryRep && rootOrigin ) {
+            snapshot.isValid = true;
+            snapshot.geometry =
+            WindowGeometry { makeGeometryCreateInfo( *geometryRep, *rootOrigin ) }
+            .getInfo();
+            snapshot.windowClass = wmClassFromReply( wmClassRep.get() );
+        }
+        snapshots.push_back( std::move( snapshot ) );
+    }
+
+    return snapshots;
+}
+}   // namespace xcbwraper
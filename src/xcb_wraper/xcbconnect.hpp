@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdlib>
+#include <memory>
 #include <xcb/xcb.h>
 
 
@@ -8,7 +10,20 @@ struct XCBConnect final {
     xcb_connection_t * mConnect;
 
     XCBConnect() : mConnect( xcb_connect( nullptr, nullptr ) ) {}
+    XCBConnect( const XCBConnect & ) = delete;
+    XCBConnect & operator=( const XCBConnect & ) = delete;
     ~XCBConnect() { xcb_disconnect( mConnect ); }
-    operator xcb_connection_t *() { return mConnect; }
+    operator xcb_connection_t *() const { return mConnect; }
 };
+
+// One connection is opened per process and handed to every wrapper, so a
+// query costs only its own request/reply instead of a full X handshake.
+using XCBConnectShared = std::shared_ptr< XCBConnect >;
+
+// xcb replies are malloc'ed and must be released with free().
+struct XCBReplyDeleter final {
+    void operator()( void * reply ) const { std::free( reply ); }
+};
+
+template < class Reply > using XCBReply = std::unique_ptr< Reply, XCBReplyDeleter >;
 }
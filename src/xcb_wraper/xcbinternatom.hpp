@@ -2,12 +2,15 @@
 
 #include <cstdint>
 #include <iostream>
+#include <stdexcept>
 #include <string_view>
+#include <utility>
 #include <vector>
 #include <memory>
 #include <cassert>
 #include <xcb/xcb.h>
 
+#include "windowsnapshot.hpp"
 #include "xcbconnect.hpp"
 #include "xcbwindowprop.hpp"
 
@@ -18,20 +21,25 @@ public:
     using Type                             = T;
     [[nodiscard]] virtual Type get() const = 0;
 
+    explicit XCBInternAtom( XCBConnectShared connect ) :
+    mConnect( std::move( connect ) ) {}
     virtual ~XCBInternAtom() = default;
 
-    [[nodiscard]] static std::vector< uint32_t >
-    getInternAtomValueArray( std::string_view atom );
+    [[nodiscard]] std::vector< uint32_t >
+    getInternAtomValueArray( std::string_view atom ) const;
 
-    [[nodiscard]] static uint32_t getInternAtomValue( std::string_view atom );
+    [[nodiscard]] uint32_t getInternAtomValue( std::string_view atom ) const;
+
+protected:
+    XCBConnectShared mConnect;
 };
 
 template < class T >
 [[nodiscard]] std::vector< uint32_t >
-XCBInternAtom< T >::getInternAtomValueArray( std::string_view atom ) {
-    XCBConnect connect {};
-    auto       atomCookie = xcb_intern_atom( connect, false, atom.size(), atom.data() );
-    std::unique_ptr< xcb_intern_atom_reply_t > atomRep { xcb_intern_atom_reply(
+XCBInternAtom< T >::getInternAtomValueArray( std::string_view atom ) const {
+    xcb_connection_t * connect = *mConnect;
+    auto atomCookie = xcb_intern_atom( connect, false, atom.size(), atom.data() );
+    XCBReply< xcb_intern_atom_reply_t > atomRep { xcb_intern_atom_reply(
     connect, atomCookie, nullptr ) };
 
     assert( atomRep != nullptr );
@@ -43,7 +51,7 @@ XCBInternAtom< T >::getInternAtomValueArray( std::string_view atom ) {
     auto screen = xcb_setup_roots_iterator( xcb_get_setup( connect ) ).data;
 
     do {
-        using UniquePropRep = std::unique_ptr< xcb_get_property_reply_t >;
+        using UniquePropRep = XCBReply< xcb_get_property_reply_t >;
 
         auto          propCookie = xcb_get_property( connect,
                                             false,
@@ -54,6 +62,10 @@ XCBInternAtom< T >::getInternAtomValueArray( std::string_view atom ) {
                                             maxQueueLength );
         UniquePropRep propRep { xcb_get_property_reply( connect, propCookie, nullptr ) };
 
+        // The property is not set on the root window.
+        if ( !propRep || propRep->format == 0 )
+            break;
+
         auto propValue =
         static_cast< uint32_t * >( xcb_get_property_value( propRep.get() ) );
 
@@ -75,10 +87,11 @@ XCBInternAtom< T >::getInternAtomValueArray( std::string_view atom ) {
 }
 
 template < class T >
-[[nodiscard]] uint32_t XCBInternAtom< T >::getInternAtomValue( std::string_view atom ) {
-    XCBConnect connect {};
-    auto       atomCookie = xcb_intern_atom( connect, false, atom.size(), atom.data() );
-    std::unique_ptr< xcb_intern_atom_reply_t > atomRep { xcb_intern_atom_reply(
+[[nodiscard]] uint32_t
+XCBInternAtom< T >::getInternAtomValue( std::string_view atom ) const {
+    xcb_connection_t * connect = *mConnect;
+    auto atomCookie = xcb_intern_atom( connect, false, atom.size(), atom.data() );
+    XCBReply< xcb_intern_atom_reply_t > atomRep { xcb_intern_atom_reply(
     connect, atomCookie, nullptr ) };
 
     assert( atomRep != nullptr );
@@ -87,7 +100,7 @@ template < class T >
 
     auto screen = xcb_setup_roots_iterator( xcb_get_setup( connect ) ).data;
 
-    using UniquePropRep = std::unique_ptr< xcb_get_property_reply_t >;
+    using UniquePropRep = XCBReply< xcb_get_property_reply_t >;
 
     auto          propCookie = xcb_get_property( connect,
                                         false,
@@ -106,14 +119,21 @@ template < class T >
 
 class AtomNetClientList final : public XCBInternAtom< std::vector< XCBWindowProp > > {
 public:
+    using XCBInternAtom::XCBInternAtom;
     ~AtomNetClientList() override = default;
     [[nodiscard]] Type get() const override;
+    // Geometry and class of every client fetched in one pipelined batch.
+    [[nodiscard]] WindowSnapshotsVec snapshot() const;
 };
 
 [[nodiscard]] inline AtomNetClientList::Type AtomNetClientList::get() const {
     Type winPropVec {};
     for ( auto && el : getInternAtomValueArray( "_NET_CLIENT_LIST" ) )
-        winPropVec.emplace_back( el );
+        winPropVec.emplace_back( mConnect, el );
     return winPropVec;
 }
+
+[[nodiscard]] inline WindowSnapshotsVec AtomNetClientList::snapshot() const {
+    return snapshotWindows( mConnect, getInternAtomValueArray( "_NET_CLIENT_LIST" ) );
+}
 }
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 #include <xcb/xproto.h>
 
 #include "point.hpp"
@@ -12,12 +16,38 @@
 namespace xcbwraper {
 using XCBWindowClass = std::string;
 using WindowIDType   = u_int32_t;
+using WindowIDsVec   = std::vector< WindowIDType >;
+
+// Window origin in root coordinates with the size from get_geometry.
+inline WindowGeometry::CreateInfo
+makeGeometryCreateInfo( const xcb_get_geometry_reply_t &          geometryRep,
+                        const xcb_translate_coordinates_reply_t & rootOrigin ) {
+    return WindowGeometry::CreateInfo {
+        .leftTopPoint = Point { .x = rootOrigin.dst_x, .y = rootOrigin.dst_y },
+        .width        = geometryRep.width,
+        .height       = geometryRep.height,
+        .borderWidth  = geometryRep.border_width
+    };
+}
+
+// WM_CLASS is "instance\0class\0", the value is not terminated otherwise.
+inline XCBWindowClass wmClassFromReply( const xcb_get_property_reply_t * nameRep ) {
+    if ( !nameRep )
+        return {};
+
+    const auto name =
+    static_cast< const char * >( xcb_get_property_value( nameRep ) );
+    const auto length =
+    static_cast< std::size_t >( xcb_get_property_value_length( nameRep ) );
+    return XCBWindowClass { name, strnlen( name, length ) };
+}
 
 class XCBWindowProp final {
-    WindowIDType mWindowID;
+    XCBConnectShared mConnect;
+    WindowIDType     mWindowID;
 
 public:
-    explicit XCBWindowProp( WindowIDType windowID );
+    XCBWindowProp( XCBConnectShared connect, WindowIDType windowID );
     ~XCBWindowProp();
     WindowGeometry Geometry() const;
     XCBWindowClass Class() const;
@@ -25,57 +55,54 @@ public:
 };
 
 class XCBWindowID final {
-    WindowIDType windowID;
+    XCBConnectShared connect;
+    WindowIDType     windowID;
 
 public:
-    XCBWindowID( WindowIDType windowID ) : windowID { windowID } {};
-    XCBWindowProp params() const { return XCBWindowProp { windowID }; }
+    XCBWindowID( XCBConnectShared connect, WindowIDType windowID ) :
+    connect { std::move( connect ) }, windowID { windowID } {};
+    XCBWindowProp params() const { return XCBWindowProp { connect, windowID }; }
 };
 
-XCBWindowProp::XCBWindowProp( WindowIDType windowID ) : mWindowID( windowID ) {}
+inline XCBWindowProp::XCBWindowProp( XCBConnectShared connect, WindowIDType windowID ) :
+mConnect( std::move( connect ) ), mWindowID( windowID ) {}
 
-XCBWindowProp::~XCBWindowProp() = default;
+inline XCBWindowProp::~XCBWindowProp() = default;
 
-WindowGeometry XCBWindowProp::Geometry() const {
-    XCBConnect connect {};
+inline WindowGeometry XCBWindowProp::Geometry() const {
+    xcb_connection_t * connect = *mConnect;
 
-    std::unique_ptr< xcb_get_geometry_reply_t > geometryRep { xcb_get_geometry_reply(
-    connect, xcb_get_geometry( connect, mWindowID ), nullptr ) };
+    auto screen = xcb_setup_roots_iterator( xcb_get_setup( connect ) ).data;
 
-    std::unique_ptr< xcb_query_tree_reply_t > tree { xcb_query_tree_reply(
-    connect, xcb_query_tree( connect, mWindowID ), nullptr ) };
+    // Both requests go out before waiting, so the query costs one round trip.
+    auto geometryCookie = xcb_get_geometry( connect, mWindowID );
+    auto transCookie =
+    xcb_translate_coordinates( connect, mWindowID, screen->root, 0, 0 );
 
-    auto screen = xcb_setup_roots_iterator( xcb_get_setup( connect ) ).data;
+    XCBReply< xcb_get_geometry_reply_t > geometryRep { xcb_get_geometry_reply(
+    connect, geometryCookie, nullptr ) };
 
-    std::unique_ptr< xcb_translate_coordinates_reply_t > trans {
-        xcb_translate_coordinates_reply(
-        connect,
-        xcb_translate_coordinates(
-        connect, mWindowID, screen->root, geometryRep->x, geometryRep->y ),
-        nullptr )
+    XCBReply< xcb_translate_coordinates_reply_t > trans {
+        xcb_translate_coordinates_reply( connect, transCookie, nullptr )
     };
 
-    WindowGeometry::CreateInfo wgci { .leftTopPoint =
-                                      Point { .x = trans->dst_x, .y = trans->dst_y },
-                                      .width       = geometryRep->width,
-                                      .height      = geometryRep->height,
-                                      .borderWidth = geometryRep->border_width };
-    WindowGeometry             windowGeometry( wgci );
-    return windowGeometry;
+    if ( !geometryRep || !trans )
+        throw std::runtime_error( "XCBWindowProp::Geometry(): window is not available" );
+
+    return WindowGeometry { makeGeometryCreateInfo( *geometryRep, *trans ) };
 }
 
-std::string XCBWindowProp::Class() const {
-    XCBConnect connect {};
+inline std::string XCBWindowProp::Class() const {
+    xcb_connection_t * connect = *mConnect;
 
-    std::unique_ptr< xcb_get_property_reply_t > nameRep { xcb_get_property_reply(
+    XCBReply< xcb_get_property_reply_t > nameRep { xcb_get_property_reply(
     connect,
     xcb_get_property(
     connect, false, mWindowID, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 3 ),
     nullptr ) };
 
-    return std::string { static_cast< char * >(
-    xcb_get_property_value( nameRep.get() ) ) };
+    return wmClassFromReply( nameRep.get() );
 }
 
-WindowIDType XCBWindowProp::ID() const { return mWindowID; }
+inline WindowIDType XCBWindowProp::ID() const { return mWindowID; }
 }   // namespace xcbwraper
@@ -0,0 +1,146 @@
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+#include "damagetracker.hpp"
+#include "xcb_wraper/xcbconnect.hpp"
+
+namespace {
+using core::composite::DamageTracker;
+using Box = xcbwraper::Region::Box;
+
+class DamageTrackerTest : public testing::Test {
+protected:
+    void SetUp() override {
+        mConnect = std::make_shared< xcbwraper::XCBConnect >();
+        if ( xcb_connection_has_error( *mConnect ) )
+            GTEST_SKIP() << "No X server to connect to.";
+        try {
+            mTracker.emplace( *mConnect );
+        } catch ( const std::runtime_error & error ) {
+            GTEST_SKIP() << error.what();
+        }
+        mScreen = xcb_setup_roots_iterator( xcb_get_setup( *mConnect ) ).data;
+    }
+
+    // A mapped 64x32 window without a border, so its drawings are damage.
+    xcb_window_t createWindow() {
+        xcb_connection_t *  connect    = *mConnect;
+        const auto          window     = xcb_generate_id( connect );
+        const std::uint32_t background = mScreen->black_pixel;
+        xcb_create_window( connect,
+                           XCB_COPY_FROM_PARENT,
+                           window,
+                           mScreen->root,
+                           0,
+                           0,
+                           64,
+                           32,
+                           0,
+                           XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                           XCB_COPY_FROM_PARENT,
+                           XCB_CW_BACK_PIXEL,
+                           &background );
+        xcb_map_window( connect, window );
+        return window;
+    }
+
+    void fill( xcb_window_t window, const Box & box ) {
+        xcb_connection_t *    connect    = *mConnect;
+        const auto            gc         = xcb_generate_id( connect );
+        const std::uint32_t   foreground = mScreen->white_pixel;
+        const xcb_rectangle_t rectangle {
+            box.x1,
+            box.y1,
+            static_cast< std::uint16_t >( box.x2 - box.x1 ),
+            static_cast< std::uint16_t >( box.y2 - box.y1 )
+        };
+        xcb_create_gc( connect, gc, window, XCB_GC_FOREGROUND, &foreground );
+        xcb_poly_fill_rectangle( connect, window, gc, 1, &rectangle );
+        xcb_free_gc( connect, gc );
+    }
+
+    // Feeds the tracker the events of every earlier request.
+    void settle() {
+        xcb_connection_t * connect = *mConnect;
+        std::free(
+        xcb_get_input_focus_reply( connect, xcb_get_input_focus( connect ), nullptr ) );
+        while ( auto event = xcb_poll_for_event( connect ) ) {
+            mTracker->handleEvent( *event );
+            std::free( event );
+        }
+    }
+
+    xcbwraper::XCBConnectShared    mConnect;
+    std::optional< DamageTracker > mTracker;
+    xcb_screen_t *                 mScreen { nullptr };
+};
+
+TEST_F( DamageTrackerTest, ReportsDrawnPixels ) {
+    const auto window = createWindow();
+    mTracker->track( window );
+    settle();
+    // Mapping paints the background.
+    mTracker->clear();
+    settle();
+    ASSERT_TRUE( mTracker->damaged().empty() );
+
+    fill( window, Box { 10, 5, 30, 13 } );
+    settle();
+    ASSERT_EQ( mTracker->damaged(), DamageTracker::WindowsVec { window } );
+    const auto * damage = mTracker->damage( window );
+    ASSERT_NE( damage, nullptr );
+    EXPECT_EQ( *damage, xcbwraper::Region( Box { 10, 5, 30, 13 } ) );
+
+    xcb_destroy_window( *mConnect, window );
+}
+
+TEST_F( DamageTrackerTest, ReportsRedrawsAfterClear ) {
+    const auto window = createWindow();
+    mTracker->track( window );
+    settle();
+    mTracker->clear();
+    settle();
+
+    fill( window, Box { 0, 0, 8, 8 } );
+    settle();
+    ASSERT_EQ( mTracker->damaged().size(), 1u );
+
+    mTracker->clear();
+    EXPECT_TRUE( mTracker->damaged().empty() );
+    EXPECT_TRUE( mTracker->damage( window )->isEmpty() );
+
+    // The same pixels again, the server forgot them with clear().
+    fill( window, Box { 0, 0, 8, 8 } );
+    settle();
+    ASSERT_EQ( mTracker->damaged(), DamageTracker::WindowsVec { window } );
+    EXPECT_EQ( *mTracker->damage( window ), xcbwraper::Region( Box { 0, 0, 8, 8 } ) );
+
+    xcb_destroy_window( *mConnect, window );
+}
+
+TEST_F( DamageTrackerTest, ForgetsDestroyedWindows ) {
+    const auto window = createWindow();
+    mTracker->track( window );
+    // DestroyNotify of a top level window arrives through the root.
+    const std::uint32_t eventMask = XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY;
+    xcb_change_window_attributes(
+    *mConnect, mScreen->root, XCB_CW_EVENT_MASK, &eventMask );
+    fill( window, Box { 0, 0, 8, 8 } );
+    settle();
+    ASSERT_EQ( mTracker->size(), 1u );
+
+    xcb_destroy_window( *mConnect, window );
+    settle();
+    EXPECT_EQ( mTracker->size(), 0u );
+    EXPECT_TRUE( mTracker->damaged().empty() );
+    EXPECT_EQ( mTracker->damage( window ), nullptr );
+}
+
+}   // namespace
@@ -0,0 +1,211 @@
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "vulkanrender.hpp"
+
+namespace {
+using core::renderer::VulkanBase;
+using core::renderer::VulkanGraphicRender;
+using FrameContext = VulkanGraphicRender::FrameContext;
+using Box          = xcbwraper::Region::Box;
+
+constexpr vk::Extent2D extent { .width = 64, .height = 48 };
+
+constexpr vk::ImageSubresourceRange colorRange { .aspectMask =
+                                                 vk::ImageAspectFlagBits::eColor,
+                                                 .baseMipLevel   = 0,
+                                                 .levelCount     = 1,
+                                                 .baseArrayLayer = 0,
+                                                 .layerCount     = 1 };
+
+vk::Rect2D rectOf( const Box & box ) {
+    return vk::Rect2D { .offset = vk::Offset2D { .x = box.x1, .y = box.y1 },
+                        .extent = vk::Extent2D {
+                        .width  = static_cast< std::uint32_t >( box.x2 - box.x1 ),
+                        .height = static_cast< std::uint32_t >( box.y2 - box.y1 ) } };
+}
+
+// Renders headless, on lavapipe without a GPU:
+//     VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+class PartialDrawTest : public testing::Test {
+protected:
+    void SetUp() override {
+        core::renderer::ExtensionsVec instanceExtensions {
+            VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME
+        };
+        try {
+            const vk::ApplicationInfo appInfo { .pApplicationName = "vulkan_xcb_tests",
+                                                .apiVersion = VK_API_VERSION_1_2 };
+            mInstance = vk::createInstance( vk::InstanceCreateInfo {
+            .pApplicationInfo = &appInfo,
+            .enabledExtensionCount =
+            static_cast< std::uint32_t >( instanceExtensions.size() ),
+            .ppEnabledExtensionNames = instanceExtensions.data() } );
+            mRenderer = std::make_unique< VulkanGraphicRender >(
+            VulkanBase::CreateInfo {
+            .instance   = mInstance,
+            .extansions = { .instance = instanceExtensions,
+                            .device   = { VK_KHR_SWAPCHAIN_EXTENSION_NAME } } },
+            VulkanGraphicRender::CreateInfo { .xcbConnect       = nullptr,
+                                              .xcbWindow        = XCB_NONE,
+                                              .fallbackExtent   = extent,
+                                              .pipelineCacheDir = {} } );
+        } catch ( const std::exception & error ) {
+            GTEST_SKIP() << "No headless Vulkan renderer: " << error.what();
+        }
+    }
+
+    void TearDown() override {
+        mRenderer.reset();
+        if ( mInstance )
+            mInstance.destroy();
+    }
+
+    vk::Instance                           mInstance;
+    std::unique_ptr< VulkanGraphicRender > mRenderer;
+};
+
+TEST_F( PartialDrawTest, ChangesExactlyTheDamagedPixels ) {
+    auto &     renderer  = *mRenderer;
+    auto &     allocator = renderer.allocator();
+    const auto device    = allocator.device();
+
+    // Every image repaints the pixels it missed, at first all of them, with the
+    // renderer's clear colour, until no image has anything pending.
+    int cleanFrames = 0;
+    for ( int frame = 0; frame < 64 && cleanFrames < 8; ++frame )
+        cleanFrames = renderer.draw( xcbwraper::Region {} ) == 0 ? cleanFrames + 1 : 0;
+    ASSERT_EQ( cleanFrames, 8 );
+
+    xcbwraper::Region damage( Box { 4, 4, 20, 12 } );
+    damage.unite( Box { 30, 20, 50, 40 } );
+    damage.unite( Box { 10, 36, 34, 44 } );
+
+    const auto bufferSize = vk::DeviceSize { 4 } * extent.width * extent.height;
+    const auto buffer     = device.createBuffer(
+    vk::BufferCreateInfo { .size        = bufferSize,
+                           .usage       = vk::BufferUsageFlagBits::eTransferDst,
+                           .sharingMode = vk::SharingMode::eExclusive } );
+    const auto memory = allocator.allocate( buffer,
+                                            vk::MemoryPropertyFlagBits::eHostVisible |
+                                            vk::MemoryPropertyFlagBits::eHostCoherent );
+
+    // The partial frame paints its repaint region in another colour and copies
+    // the whole image out after the render pass.
+    const vk::ClearColorValue partialColor( std::array< float, 4 > {
+    0.1f, 0.9f, 0.3f, 1.0f } );
+    renderer.setFrameRecorder( [ & ]( const FrameContext & frame ) {
+        std::vector< vk::ClearRect > rects;
+        for ( auto && box : frame.repaint.boxes() )
+            rects.push_back( vk::ClearRect {
+            .rect = rectOf( box ), .baseArrayLayer = 0, .layerCount = 1 } );
+        if ( !rects.empty() )
+            frame.commandBuffer.clearAttachments(
+            vk::ClearAttachment { .aspectMask      = vk::ImageAspectFlagBits::eColor,
+                                  .colorAttachment = 0,
+                                  .clearValue      = vk::ClearValue( partialColor ) },
+            rects );
+    } );
+    renderer.setAfterPassRecorder( [ & ]( const FrameContext & frame ) {
+        const auto toTransfer = vk::ImageMemoryBarrier {
+            .srcAccessMask       = vk::AccessFlagBits::eColorAttachmentWrite,
+            .dstAccessMask       = vk::AccessFlagBits::eTransferRead,
+            .oldLayout           = vk::ImageLayout::ePresentSrcKHR,
+            .newLayout           = vk::ImageLayout::eTransferSrcOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = frame.image,
+            .subresourceRange    = colorRange
+        };
+        frame.commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(),
+        {},
+        {},
+        toTransfer );
+        frame.commandBuffer.copyImageToBuffer(
+        frame.image,
+        vk::ImageLayout::eTransferSrcOptimal,
+        buffer,
+        vk::BufferImageCopy {
+        .bufferOffset      = 0,
+        .bufferRowLength   = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource  = vk::ImageSubresourceLayers {
+        .aspectMask     = vk::ImageAspectFlagBits::eColor,
+        .mipLevel       = 0,
+        .baseArrayLayer = 0,
+        .layerCount     = 1 },
+        .imageOffset = vk::Offset3D { .x = 0, .y = 0, .z = 0 },
+        .imageExtent = vk::Extent3D { .width  = frame.extent.width,
+                                      .height = frame.extent.height,
+                                      .depth  = 1 } } );
+
+        const auto toPresent = vk::ImageMemoryBarrier {
+            .srcAccessMask       = vk::AccessFlagBits::eTransferRead,
+            .dstAccessMask       = {},
+            .oldLayout           = vk::ImageLayout::eTransferSrcOptimal,
+            .newLayout           = vk::ImageLayout::ePresentSrcKHR,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = frame.image,
+            .subresourceRange    = colorRange
+        };
+        const vk::BufferMemoryBarrier toHost {
+            .srcAccessMask       = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask       = vk::AccessFlagBits::eHostRead,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer              = buffer,
+            .offset              = 0,
+            .size                = VK_WHOLE_SIZE
+        };
+        frame.commandBuffer.pipelineBarrier( vk::PipelineStageFlagBits::eTransfer,
+                                             vk::PipelineStageFlagBits::eBottomOfPipe |
+                                             vk::PipelineStageFlagBits::eHost,
+                                             vk::DependencyFlags(),
+                                             {},
+                                             toHost,
+                                             toPresent );
+    } );
+
+    EXPECT_EQ( renderer.draw( damage ), damage.area() );
+    device.waitIdle();
+    renderer.setFrameRecorder( {} );
+    renderer.setAfterPassRecorder( {} );
+
+    // 32 bit pixels, whatever their channel order.
+    std::vector< std::uint32_t > pixels( extent.width * extent.height );
+    std::memcpy( pixels.data(), memory.mapped, bufferSize );
+    const auto outside = pixels[ 0 ];
+    const auto inside  = pixels[ 4 * extent.width + 4 ];
+    EXPECT_NE( inside, outside );
+
+    // Pixels that differ from the colour of their side of the damage.
+    std::size_t wrongInside  = 0;
+    std::size_t wrongOutside = 0;
+    for ( std::uint32_t y = 0; y < extent.height; ++y )
+        for ( std::uint32_t x = 0; x < extent.width; ++x ) {
+            const auto pixel = pixels[ y * extent.width + x ];
+            if ( damage.contains( xcbwraper::Point {
+                 static_cast< xcbwraper::Point::CoordType >( x ),
+                 static_cast< xcbwraper::Point::CoordType >( y ) } ) )
+                wrongInside += pixel != inside;
+            else
+                wrongOutside += pixel != outside;
+        }
+    EXPECT_EQ( wrongInside, 0u );
+    EXPECT_EQ( wrongOutside, 0u );
+
+    device.destroyBuffer( buffer );
+    allocator.free( memory );
+}
+
+}   // namespace
@@ -0,0 +1,132 @@
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "xcb_wraper/rectarray.hpp"
+#include "xcb_wraper/winintersection.hpp"
+
+namespace {
+using xcbwraper::IntersectKernel;
+using xcbwraper::Point;
+using xcbwraper::WindowGeometry;
+
+using GeometriesVec = std::vector< WindowGeometry::Info >;
+
+WindowGeometry::Info rect( Point::CoordType x,
+                          Point::CoordType y,
+                          std::uint16_t    width,
+                          std::uint16_t    height ) {
+    return WindowGeometry { WindowGeometry::CreateInfo {
+                            .leftTopPoint = Point { x, y },
+                            .width        = width,
+                            .height       = height,
+                            .borderWidth  = 0 } }
+    .getInfo();
+}
+
+GeometriesVec randomRects( std::size_t count, std::uint32_t seed ) {
+    std::mt19937                                   random( seed );
+    std::uniform_int_distribution< std::int16_t >  position( -512, 4096 );
+    std::uniform_int_distribution< std::uint16_t > size( 0, 768 );
+
+    GeometriesVec rects;
+    rects.reserve( count );
+    for ( std::size_t i = 0; i < count; ++i )
+        rects.push_back( rect( position( random ),
+                               position( random ),
+                               size( random ),
+                               size( random ) ) );
+    return rects;
+}
+
+// Around a 100x100 probe at (0, 0): empty, touching, contained, containing,
+// overlapping and disjoint rectangles, several with negative origins.
+GeometriesVec edgeRects() {
+    return { rect( 0, 0, 0, 0 ),
+             rect( 50, 50, 0, 0 ),
+             rect( 100, 100, 0, 0 ),
+             rect( 101, 101, 0, 0 ),
+             rect( 0, 0, 100, 100 ),
+             rect( 10, 10, 20, 20 ),
+             rect( -10, -10, 200, 200 ),
+             rect( 100, 0, 50, 100 ),
+             rect( 0, 100, 100, 50 ),
+             rect( -50, 0, 50, 100 ),
+             rect( 0, -50, 100, 50 ),
+             rect( 101, 0, 50, 50 ),
+             rect( -51, -51, 50, 50 ),
+             rect( -100, -100, 150, 150 ),
+             rect( 50, -20, 10, 300 ),
+             rect( 99, 99, 1, 1 ),
+             rect( -1, -1, 1, 1 ),
+             rect( -32768, -32768, 100, 100 ),
+             rect( 32000, 32000, 700, 700 ) };
+}
+
+std::vector< IntersectKernel > supportedKernels() {
+    std::vector< IntersectKernel > kernels;
+    for ( auto kernel :
+          { IntersectKernel::eScalar, IntersectKernel::eSse2, IntersectKernel::eAvx2 } )
+        if ( kernel <= xcbwraper::bestIntersectKernel() )
+            kernels.push_back( kernel );
+    return kernels;
+}
+
+// Every kernel agrees with intersect() on every pair of probe and rectangle.
+void expectSameAsIntersect( const GeometriesVec & probes, const GeometriesVec & rects ) {
+    xcbwraper::RectArray array;
+    for ( auto && geometry : rects )
+        array.push_back( geometry );
+
+    xcbwraper::IntersectionBatch batch;
+    for ( auto kernel : supportedKernels() ) {
+        for ( std::size_t p = 0; p < probes.size(); ++p ) {
+            xcbwraper::intersectBatch( probes[ p ], array, batch, kernel );
+            for ( std::size_t i = 0; i < rects.size(); ++i ) {
+                SCOPED_TRACE( testing::Message()
+                              << "kernel " << static_cast< int >( kernel ) << ", probe "
+                              << p << ", rect " << i );
+                const auto expected = xcbwraper::intersect( probes[ p ], rects[ i ] );
+                const auto actual   = batch.at( i );
+                ASSERT_EQ( actual.isExist, expected.isExist );
+                ASSERT_EQ( batch.exists( i ), expected.isExist );
+                ASSERT_EQ( actual.leftTopPoint.x, expected.leftTopPoint.x );
+                ASSERT_EQ( actual.leftTopPoint.y, expected.leftTopPoint.y );
+                ASSERT_EQ( actual.width, expected.width );
+                ASSERT_EQ( actual.height, expected.height );
+            }
+        }
+    }
+}
+
+TEST( RectArrayTest, MatchesIntersectOnEdgeCases ) {
+    expectSameAsIntersect( { rect( 0, 0, 100, 100 ) }, edgeRects() );
+    // Probes that are empty or have negative origins themselves.
+    expectSameAsIntersect( { rect( 0, 0, 0, 0 ), rect( -40, -40, 60, 60 ) },
+                           edgeRects() );
+}
+
+TEST( RectArrayTest, MatchesIntersectOnRandomRects ) {
+    // Sizes that leave every kernel a scalar tail.
+    for ( std::size_t count : { 0, 1, 7, 8, 15, 16, 17, 63, 64, 65, 1000 } )
+        expectSameAsIntersect( randomRects( 20, 1 ), randomRects( count, 2 ) );
+}
+
+TEST( RectArrayTest, ReusedBatchForgetsEarlierResults ) {
+    xcbwraper::RectArray array;
+    for ( auto && geometry : randomRects( 100, 3 ) )
+        array.push_back( geometry );
+
+    xcbwraper::IntersectionBatch batch;
+    xcbwraper::intersectBatch( rect( -1000, -1000, 30000, 30000 ), array, batch );
+    array.resize( 10 );
+    xcbwraper::intersectBatch( rect( -2000, -2000, 1, 1 ), array, batch );
+    ASSERT_EQ( batch.rects.size(), 10u );
+    for ( std::size_t i = 0; i < array.size(); ++i )
+        EXPECT_FALSE( batch.exists( i ) );
+}
+
+}   // namespace
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "xcb_wraper/region.hpp"
+
+namespace {
+using xcbwraper::Region;
+using Box      = Region::Box;
+using BoxesVec = std::vector< Box >;
+using Coord    = Region::CoordType;
+
+// The pixels of [origin, origin + side)^2, every box of the tests fits inside.
+constexpr int origin = -16;
+constexpr int side   = 96;
+
+// Brute force reference, one flag per pixel.
+class Mask final {
+public:
+    Mask() : mPixels( side * side, false ) {}
+    explicit Mask( const Box & box ) : Mask() { paint( box, true ); }
+    explicit Mask( const Region & region ) : Mask() {
+        for ( auto && box : region.boxes() )
+            paint( box, true );
+    }
+
+    Mask & unite( const Mask & other ) {
+        for ( std::size_t i = 0; i < mPixels.size(); ++i )
+            mPixels[ i ] = mPixels[ i ] || other.mPixels[ i ];
+        return *this;
+    }
+    Mask & intersect( const Mask & other ) {
+        for ( std::size_t i = 0; i < mPixels.size(); ++i )
+            mPixels[ i ] = mPixels[ i ] && other.mPixels[ i ];
+        return *this;
+    }
+    Mask & subtract( const Mask & other ) {
+        for ( std::size_t i = 0; i < mPixels.size(); ++i )
+            mPixels[ i ] = mPixels[ i ] && !other.mPixels[ i ];
+        return *this;
+    }
+
+    [[nodiscard]] std::uint64_t area() const {
+        std::uint64_t area = 0;
+        for ( bool pixel : mPixels )
+            area += pixel;
+        return area;
+    }
+
+    // The bounding box of the set pixels, Box { 0, 0, 0, 0 } when there are none.
+    [[nodiscard]] Box extents() const {
+        Box  extents { 0, 0, 0, 0 };
+        bool found = false;
+        for ( int y = 0; y < side; ++y )
+            for ( int x = 0; x < side; ++x ) {
+                if ( !mPixels[ y * side + x ] )
+                    continue;
+                const auto px = static_cast< Coord >( x + origin );
+                const auto py = static_cast< Coord >( y + origin );
+                if ( !found )
+                    extents = Box { px, py, px, py };
+                found      = true;
+                extents.x1 = std::min( extents.x1, px );
+                extents.y1 = std::min( extents.y1, py );
+                extents.x2 = std::max( extents.x2, static_cast< Coord >( px + 1 ) );
+                extents.y2 = std::max( extents.y2, static_cast< Coord >( py + 1 ) );
+            }
+        return extents;
+    }
+
+    bool operator==( const Mask & ) const = default;
+
+private:
+    void paint( const Box & box, bool value ) {
+        for ( int y = box.y1; y < box.y2; ++y )
+            for ( int x = box.x1; x < box.x2; ++x )
+                mPixels[ ( y - origin ) * side + x - origin ] = value;
+    }
+
+    std::vector< bool > mPixels;
+};
+
+// Around a 32x32 probe at (0, 0): empty, touching, contained, containing,
+// overlapping and disjoint boxes, several with negative origins.
+BoxesVec edgeBoxes() {
+    return { Box { 0, 0, 0, 0 },      Box { 10, 10, 10, 20 },  Box { 10, 10, 20, 10 },
+             Box { 5, 5, 3, 3 },      Box { 0, 0, 32, 32 },    Box { 8, 8, 16, 16 },
+             Box { -8, -8, 40, 40 },  Box { 32, 0, 48, 32 },   Box { 0, 32, 32, 48 },
+             Box { -16, 0, 0, 32 },   Box { 0, -16, 32, 0 },   Box { 32, 32, 40, 40 },
+             Box { 33, 0, 40, 8 },    Box { -16, -16, 8, 8 },  Box { 16, -8, 24, 64 },
+             Box { -8, 16, 64, 24 },  Box { 31, 31, 32, 32 },  Box { -1, -1, 0, 0 },
+             Box { 0, 8, 32, 16 },    Box { 8, 0, 16, 32 } };
+}
+
+BoxesVec randomBoxes( std::size_t count, std::uint32_t seed ) {
+    std::mt19937                         random( seed );
+    std::uniform_int_distribution< int > position( origin, origin + side - 1 );
+    std::uniform_int_distribution< int > size( 0, 32 );
+
+    BoxesVec boxes;
+    boxes.reserve( count );
+    for ( std::size_t i = 0; i < count; ++i ) {
+        const int x = position( random );
+        const int y = position( random );
+        boxes.push_back( Box {
+        static_cast< Coord >( x ),
+        static_cast< Coord >( y ),
+        static_cast< Coord >( std::min( x + size( random ), origin + side ) ),
+        static_cast< Coord >( std::min( y + size( random ), origin + side ) ) } );
+    }
+    return boxes;
+}
+
+// The y-x banded form documented in region.hpp, which makes it unique.
+void expectBanded( const Region & region ) {
+    const auto & boxes = region.boxes();
+    for ( std::size_t i = 0; i < boxes.size(); ++i ) {
+        SCOPED_TRACE( testing::Message() << "box " << i );
+        ASSERT_FALSE( boxes[ i ].isEmpty() );
+        if ( i == 0 )
+            continue;
+        const auto & previous = boxes[ i - 1 ];
+        if ( previous.y1 == boxes[ i ].y1 ) {
+            ASSERT_EQ( previous.y2, boxes[ i ].y2 );
+            ASSERT_LT( previous.x2, boxes[ i ].x1 );
+        } else
+            ASSERT_LE( previous.y2, boxes[ i ].y1 );
+    }
+}
+
+void expectMatches( const Region & region, const Mask & expected ) {
+    expectBanded( region );
+    EXPECT_TRUE( Mask( region ) == expected );
+    EXPECT_EQ( region.area(), expected.area() );
+    EXPECT_EQ( region.extents(), expected.extents() );
+    EXPECT_EQ( region.isEmpty(), expected.area() == 0 );
+}
+
+// Every operation of every pair, with region and with box operands.
+void expectSameAsMask( const BoxesVec & ones, const BoxesVec & twos ) {
+    for ( std::size_t i = 0; i < ones.size(); ++i )
+        for ( std::size_t j = 0; j < twos.size(); ++j ) {
+            SCOPED_TRACE( testing::Message() << "one " << i << ", two " << j );
+            const Mask one( ones[ i ] );
+            const Mask two( twos[ j ] );
+
+            expectMatches( Region( ones[ i ] ).unite( twos[ j ] ),
+                           Mask( one ).unite( two ) );
+            expectMatches( Region( ones[ i ] ).intersect( twos[ j ] ),
+                           Mask( one ).intersect( two ) );
+            expectMatches( Region( ones[ i ] ).subtract( twos[ j ] ),
+                           Mask( one ).subtract( two ) );
+
+            const Region other( twos[ j ] );
+            expectMatches( Region( ones[ i ] ).unite( other ), Mask( one ).unite( two ) );
+            expectMatches( Region( ones[ i ] ).intersect( other ),
+                           Mask( one ).intersect( two ) );
+            expectMatches( Region( ones[ i ] ).subtract( other ),
+                           Mask( one ).subtract( two ) );
+        }
+}
+
+TEST( RegionTest, MatchesMaskOnEdgeCases ) {
+    expectSameAsMask( { Box { 0, 0, 32, 32 } }, edgeBoxes() );
+    expectSameAsMask( edgeBoxes(), edgeBoxes() );
+}
+
+TEST( RegionTest, HandlesEmptyRegions ) {
+    const Region empty;
+    EXPECT_TRUE( empty.isEmpty() );
+    EXPECT_EQ( empty.area(), 0u );
+    EXPECT_EQ( empty.extents(), ( Box { 0, 0, 0, 0 } ) );
+    EXPECT_TRUE( Region( Box { 4, 4, 4, 8 } ).isEmpty() );
+
+    const Region box( Box { 1, 2, 3, 4 } );
+    EXPECT_EQ( Region( box ).unite( empty ), box );
+    EXPECT_EQ( Region( empty ).unite( box ), box );
+    EXPECT_TRUE( Region( box ).intersect( empty ).isEmpty() );
+    EXPECT_EQ( Region( box ).subtract( empty ), box );
+    EXPECT_TRUE( Region( empty ).subtract( box ).isEmpty() );
+}
+
+TEST( RegionTest, TouchingBoxesMerge ) {
+    // Side by side, then on top of each other: one box either way.
+    Region region( Box { 0, 0, 8, 8 } );
+    region.unite( Box { 8, 0, 16, 8 } );
+    EXPECT_EQ( region.boxes(), ( BoxesVec { Box { 0, 0, 16, 8 } } ) );
+    region.unite( Box { 0, 8, 16, 12 } );
+    EXPECT_EQ( region.boxes(), ( BoxesVec { Box { 0, 0, 16, 12 } } ) );
+
+    // Touching corners share no pixel.
+    Region corner( Box { 0, 0, 8, 8 } );
+    EXPECT_TRUE( corner.intersect( Box { 8, 8, 16, 16 } ).isEmpty() );
+}
+
+TEST( RegionTest, MatchesMaskOnRandomSequences ) {
+    std::mt19937                         random( 4 );
+    std::uniform_int_distribution< int > operation( 0, 2 );
+    for ( std::uint32_t seed = 0; seed < 50; ++seed ) {
+        Region region;
+        Mask   mask;
+        for ( auto && box : randomBoxes( 40, seed ) ) {
+            SCOPED_TRACE( testing::Message() << "seed " << seed );
+            switch ( operation( random ) ) {
+            case 0:
+                region.unite( box );
+                mask.unite( Mask( box ) );
+                break;
+            case 1:
+                region.subtract( box );
+                mask.subtract( Mask( box ) );
+                break;
+            default:
+                // Intersect with a union of two boxes, so the operand has bands.
+                Region operand( box );
+                operand.unite( Box { 0, 0, 48, 48 } );
+                region.intersect( operand );
+                mask.intersect( Mask( operand ) );
+                break;
+            }
+            expectMatches( region, mask );
+        }
+    }
+}
+
+TEST( RegionTest, SamePixelsCompareEqual ) {
+    const auto boxes = randomBoxes( 30, 7 );
+    Region     forward, backward;
+    for ( auto box = boxes.begin(); box != boxes.end(); ++box )
+        forward.unite( *box );
+    for ( auto box = boxes.rbegin(); box != boxes.rend(); ++box )
+        backward.unite( *box );
+    EXPECT_EQ( forward, backward );
+}
+
+}   // namespace
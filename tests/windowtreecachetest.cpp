@@ -0,0 +1,172 @@
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+
+#include <gtest/gtest.h>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+#include "windowtreecache.hpp"
+
+namespace {
+using core::composite::WindowTreeCache;
+
+class WindowTreeCacheTest : public testing::Test {
+protected:
+    void SetUp() override {
+        mConnect = std::make_shared< xcbwraper::XCBConnect >();
+        if ( xcb_connection_has_error( *mConnect ) )
+            GTEST_SKIP() << "No X server to connect to.";
+        mRoot = xcb_setup_roots_iterator( xcb_get_setup( *mConnect ) ).data->root;
+    }
+
+    // A 64x32 window, WM_CLASS is "instance\0class\0".
+    xcb_window_t createWindow( xcb_window_t parent, std::string_view wmClass ) {
+        xcb_connection_t * connect = *mConnect;
+        const auto         window  = xcb_generate_id( connect );
+        xcb_create_window( connect,
+                           XCB_COPY_FROM_PARENT,
+                           window,
+                           parent,
+                           0,
+                           0,
+                           64,
+                           32,
+                           0,
+                           XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                           XCB_COPY_FROM_PARENT,
+                           0,
+                           nullptr );
+        setClass( window, wmClass );
+        return window;
+    }
+
+    void setClass( xcb_window_t window, std::string_view wmClass ) {
+        xcb_change_property( *mConnect,
+                             XCB_PROP_MODE_REPLACE,
+                             window,
+                             XCB_ATOM_WM_CLASS,
+                             XCB_ATOM_STRING,
+                             8,
+                             static_cast< std::uint32_t >( wmClass.size() ),
+                             wmClass.data() );
+    }
+
+    void setEventMask( xcb_window_t window, std::uint32_t mask ) {
+        xcb_change_window_attributes( *mConnect, window, XCB_CW_EVENT_MASK, &mask );
+    }
+
+    [[nodiscard]] std::uint32_t eventMask( xcb_window_t window ) {
+        xcb_connection_t * connect = *mConnect;
+        xcbwraper::XCBReply< xcb_get_window_attributes_reply_t > attributes {
+            xcb_get_window_attributes_reply(
+            connect, xcb_get_window_attributes( connect, window ), nullptr )
+        };
+        return attributes ? attributes->your_event_mask : 0;
+    }
+
+    // Feeds the cache until the events of the earlier requests and the
+    // replies to what the cache asked for while handling them are applied.
+    void settle( WindowTreeCache & cache ) {
+        xcb_connection_t * connect = *mConnect;
+        // Events, then attributes, then WM_CLASS.
+        for ( int round = 0; round < 3; ++round ) {
+            std::free( xcb_get_input_focus_reply(
+            connect, xcb_get_input_focus( connect ), nullptr ) );
+            while ( auto event = xcb_poll_for_event( connect ) ) {
+                cache.handleEvent( *event );
+                std::free( event );
+            }
+            cache.handleReplies();
+        }
+    }
+
+    xcbwraper::XCBConnectShared mConnect;
+    xcb_window_t                mRoot { XCB_NONE };
+};
+
+TEST_F( WindowTreeCacheTest, AddsCreatedWindows ) {
+    WindowTreeCache cache( mConnect );
+    const auto      window = createWindow( mRoot, { "first\0First\0", 12 } );
+    settle( cache );
+
+    const auto * cached = cache.find( window );
+    ASSERT_NE( cached, nullptr );
+    EXPECT_EQ( cached->windowClass, "first" );
+    EXPECT_EQ( cached->geometry.width, 64 );
+    EXPECT_EQ( cached->geometry.height, 32 );
+    EXPECT_FALSE( cached->isMapped );
+    EXPECT_EQ( cache.stacking().back(), window );
+
+    xcb_map_window( *mConnect, window );
+    settle( cache );
+    EXPECT_TRUE( cache.find( window )->isMapped );
+}
+
+TEST_F( WindowTreeCacheTest, RemovesDestroyedWindows ) {
+    const auto      window = createWindow( mRoot, { "first\0First\0", 12 } );
+    WindowTreeCache cache( mConnect );
+    ASSERT_NE( cache.find( window ), nullptr );
+    const auto size = cache.size();
+
+    xcb_destroy_window( *mConnect, window );
+    settle( cache );
+    EXPECT_EQ( cache.find( window ), nullptr );
+    EXPECT_EQ( cache.size(), size - 1 );
+    for ( auto id : cache.stacking() )
+        EXPECT_NE( id, window );
+}
+
+TEST_F( WindowTreeCacheTest, FollowsClassRenames ) {
+    const auto      window = createWindow( mRoot, { "first\0First\0", 12 } );
+    WindowTreeCache cache( mConnect );
+    ASSERT_EQ( cache.find( window )->windowClass, "first" );
+
+    setClass( window, { "second\0Second\0", 14 } );
+    settle( cache );
+    EXPECT_EQ( cache.find( window )->windowClass, "second" );
+}
+
+TEST_F( WindowTreeCacheTest, FollowsReparenting ) {
+    const auto      frame  = createWindow( mRoot, { "frame\0Frame\0", 12 } );
+    const auto      window = createWindow( mRoot, { "child\0Child\0", 12 } );
+    WindowTreeCache cache( mConnect );
+    ASSERT_NE( cache.find( window ), nullptr );
+
+    xcb_reparent_window( *mConnect, window, frame, 0, 0 );
+    settle( cache );
+    EXPECT_EQ( cache.find( window ), nullptr );
+    EXPECT_NE( cache.find( frame ), nullptr );
+    EXPECT_EQ( eventMask( window ) & XCB_EVENT_MASK_PROPERTY_CHANGE, 0u );
+
+    xcb_reparent_window( *mConnect, window, mRoot, 10, 20 );
+    settle( cache );
+    const auto * cached = cache.find( window );
+    ASSERT_NE( cached, nullptr );
+    EXPECT_EQ( cached->windowClass, "child" );
+    EXPECT_EQ( cached->geometry.leftTopPoint.x, 10 );
+    EXPECT_EQ( cached->geometry.leftTopPoint.y, 20 );
+    EXPECT_EQ( cached->geometry.width, 64 );
+    EXPECT_EQ( cache.stacking().back(), window );
+}
+
+TEST_F( WindowTreeCacheTest, KeepsEventMasksOfTheClient ) {
+    const auto window = createWindow( mRoot, { "first\0First\0", 12 } );
+    setEventMask( window, XCB_EVENT_MASK_STRUCTURE_NOTIFY );
+    const auto rootMask = eventMask( mRoot );
+
+    {
+        WindowTreeCache cache( mConnect );
+        settle( cache );
+        EXPECT_EQ( eventMask( window ),
+                   XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE );
+        EXPECT_EQ( eventMask( mRoot ) & rootMask, rootMask );
+        EXPECT_NE( eventMask( mRoot ) & XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY, 0u );
+    }
+
+    EXPECT_EQ( eventMask( window ), XCB_EVENT_MASK_STRUCTURE_NOTIFY );
+    EXPECT_EQ( eventMask( mRoot ), rootMask );
+}
+
+}   // namespace